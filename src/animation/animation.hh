@@ -6,10 +6,8 @@
 #include "psyqo/vector.hh"
 #include <cstdint>
 
-static constexpr uint8_t MAX_ANIMATIONS = 5;
-static constexpr uint8_t MAX_TRACKS = 50;
-static constexpr uint8_t MAX_MARKERS = 5;
-static constexpr uint8_t MAX_KEYS = 30;
+// tracks/keys/markers are sized to the file when loaded, this only caps the animation count (uint8 in the file)
+static constexpr uint8_t MAX_ANIMATIONS = 255;
 static constexpr uint8_t MAX_ANIMATION_NAME_LENGTH = 32;
 static constexpr uint8_t MAX_MARKER_NAME_LENGTH = 32;
 
@@ -31,7 +29,7 @@ struct Track {
   uint8_t type;
   uint8_t jointId;
   uint16_t numKeys;
-  Key keys[MAX_KEYS];
+  Key *keys; // points into the AnimationBin's single allocation
 };
 
 // useful for marking a certain frame, can be used for say "play sound at this marker"
@@ -46,14 +44,29 @@ struct Animation {
   uint32_t flags;              // bitfields. looped = 1
   uint16_t length;             // how many frames?
   uint16_t numTracks;          // how many tracks it contains
-  Track tracks[MAX_TRACKS];    // the data in the tracks
+  Track *tracks;               // the data in the tracks
   uint16_t numMarkers;         // number of markers
-  Marker markers[MAX_MARKERS]; // the markers
+  Marker *markers;             // the markers
+  int16_t rootMotionTrack = -1; // first translation track. root motion comes from the first one from here that's on a root bone
 };
 
+// refers to a clip inside a bank. stays valid until that bank is unloaded, after which it resolves to nullptr
+// even if another file is loaded into the same bank slot. all zeroes is no clip, so zeroed skeletons start empty
+struct AnimationHandle {
+  uint8_t bank = 0; // bank slot + 1, 0 if it doesn't point at anything
+  uint8_t clip = 0;
+  uint16_t generation = 0;
+
+  bool IsValid() const { return bank != 0; }
+  bool operator==(const AnimationHandle &other) const {
+    return bank == other.bank && clip == other.clip && generation == other.generation;
+  }
+};
+
+// animations, tracks, keys and markers all live in one tightly sized block. freeing `animations` frees the lot
 struct AnimationBin {
   uint8_t numAnimations;
-  Animation animations[MAX_ANIMATIONS];
+  Animation *animations;
 };
 
 #endif
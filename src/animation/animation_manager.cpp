@@ -1,150 +1,587 @@
 #include "animation_manager.hh"
 #include "../helpers/archive.hh"
+#include "../helpers/hash.hh"
+#include "../helpers/scene_arena.hh"
 #include "EASTL/fixed_string.h"
 #include "animation.hh"
+#include "pose_cache.hh"
+#include "psyqo/alloc.h"
+#include "psyqo/soft-math.hh"
 #include "psyqo/xprintf.h"
+#include <new>
 
-AnimationBin AnimationManager::m_loadedAnimBin = {0, {}};
+AnimationBank AnimationManager::m_banks[MAX_ANIMATION_BANKS] = {};
+AnimationClipIndexEntry AnimationManager::m_clipIndex[ANIMATION_CLIP_INDEX_SIZE] = {};
+
+// how much of each thing an animbin holds, so it can be decoded into one exactly sized block
+struct AnimationBinCounts {
+  uint32_t tracks = 0;
+  uint32_t keys = 0;
+  uint32_t markers = 0;
+};
+
+// v2 quaternions only store x, y and z. w is always positive so we can get it back from the unit length
+static psyqo::GTE::Short ReconstructQuaternionW(const Quaternion &q) {
+  auto s = psyqo::GTE::Short(1) - (q.x * q.x + q.y * q.y + q.z * q.z);
+  if (s <= 0)
+    return 0;
+
+  return psyqo::GTE::Short(psyqo::SoftMath::squareRoot(psyqo::FixedPoint<>(s)));
+}
+
+// whether there are at least size bytes left before end
+static inline bool Fits(const uint8_t *ptr, const uint8_t *end, uint32_t size) {
+  return ptr <= end && uint32_t(end - ptr) >= size;
+}
+
+// walks the file without decoding anything to find out how much space it needs.
+// checks every read against the end of the file so a cut short or broken file can't walk off it
+static bool CountAnimationBin(const uint8_t *ptr, const uint8_t *end, uint8_t version, uint8_t numAnimations,
+                              AnimationBinCounts *counts) {
+  for (int32_t i = 0; i < numAnimations; i++) {
+    uint16_t numTracks = 0;
+    uint16_t numMarkers = 0;
+
+    if (version == 1) {
+      // name(32) + flags(4) + length(2) + numTracks(2) + numMarkers(2)
+      if (!Fits(ptr, end, MAX_ANIMATION_NAME_LENGTH + sizeof(uint32_t) + sizeof(uint16_t) * 3))
+        return false;
+
+      ptr += MAX_ANIMATION_NAME_LENGTH + sizeof(uint32_t) + sizeof(uint16_t);
+      __builtin_memcpy(&numTracks, ptr, sizeof(uint16_t));
+      ptr += sizeof(uint16_t);
+      __builtin_memcpy(&numMarkers, ptr, sizeof(uint16_t));
+      ptr += sizeof(uint16_t);
+    } else {
+      // nameLength(1) + name + flags(1) + length(2) + numTracks(1) + numMarkers(1)
+      if (!Fits(ptr, end, 1) || !Fits(ptr, end, 1 + *ptr + sizeof(uint8_t) + sizeof(uint16_t) + 2))
+        return false;
+
+      ptr += 1 + *ptr + sizeof(uint8_t) + sizeof(uint16_t);
+      numTracks = *ptr++;
+      numMarkers = *ptr++;
+    }
+
+    counts->tracks += numTracks;
+    counts->markers += numMarkers;
+
+    for (int32_t j = 0; j < numTracks; j++) {
+      // type(1) + joint(1) + numKeys(2)
+      if (!Fits(ptr, end, 2 + sizeof(uint16_t)))
+        return false;
+
+      uint8_t type = *ptr;
+      uint16_t numKeys = 0;
+      __builtin_memcpy(&numKeys, ptr + 2, sizeof(uint16_t));
+      ptr += 2 + sizeof(uint16_t);
+      counts->keys += numKeys;
+
+      if (version == 1) {
+        // every key says what it is. frame(2) + keyType(1) + quat(8) or vec3(12)
+        for (int32_t k = 0; k < numKeys; k++) {
+          if (!Fits(ptr, end, 3))
+            return false;
+
+          uint32_t keySize = 3 + (ptr[2] == KeyType::ROTATION ? 8 : 12);
+          if (!Fits(ptr, end, keySize))
+            return false;
+
+          ptr += keySize;
+        }
+      } else {
+        // every key is the track's type. frameDelta(1) + xyz(6) or vec3(12)
+        uint32_t keysSize = numKeys * (1 + (type == KeyType::ROTATION ? 6 : 12));
+        if (!Fits(ptr, end, keysSize))
+          return false;
+
+        ptr += keysSize;
+      }
+    }
+
+    for (int32_t j = 0; j < numMarkers; j++) {
+      uint32_t markerSize = 0;
+      if (version == 1) {
+        markerSize = MAX_MARKER_NAME_LENGTH + sizeof(uint16_t);
+      } else {
+        if (!Fits(ptr, end, 1))
+          return false;
+
+        markerSize = 1 + *ptr + sizeof(uint16_t);
+      }
+
+      if (!Fits(ptr, end, markerSize))
+        return false;
+
+      ptr += markerSize;
+    }
+  }
+
+  return true;
+}
+
+static const uint8_t *ReadAnimationV1(const uint8_t *ptr, Animation *anim, Track **tracks, Key **keys,
+                                      Marker **markers) {
+  // load the name
+  anim->name.assign(reinterpret_cast<const char *>(ptr));
+  ptr += MAX_ANIMATION_NAME_LENGTH;
+
+  // load any flags it has
+  __builtin_memcpy(&anim->flags, ptr, sizeof(uint32_t));
+  ptr += sizeof(uint32_t);
+
+  // length of animation
+  __builtin_memcpy(&anim->length, ptr, sizeof(uint16_t));
+  ptr += sizeof(uint16_t);
+
+  // number of tracks
+  __builtin_memcpy(&anim->numTracks, ptr, sizeof(uint16_t));
+  ptr += sizeof(uint16_t);
+
+  // numer of frame markers
+  __builtin_memcpy(&anim->numMarkers, ptr, sizeof(uint16_t));
+  ptr += sizeof(uint16_t);
+
+  anim->tracks = *tracks;
+  *tracks += anim->numTracks;
+
+  // load the tracks (should be one per bone)
+  for (int32_t j = 0; j < anim->numTracks; j++) {
+    auto *track = &anim->tracks[j];
+
+    // track type (rotation or translation)
+    __builtin_memcpy(&track->type, ptr++, sizeof(uint8_t));
+
+    // which bone
+    __builtin_memcpy(&track->jointId, ptr++, sizeof(uint8_t));
+
+    // keyframes
+    __builtin_memcpy(&track->numKeys, ptr, sizeof(uint16_t));
+    ptr += sizeof(uint16_t);
+
+    track->keys = *keys;
+    *keys += track->numKeys;
+
+    // for each frame (key)
+    for (int32_t k = 0; k < track->numKeys; k++) {
+      auto *key = &track->keys[k];
+
+      // frame number
+      __builtin_memcpy(&key->frame, ptr, sizeof(uint16_t));
+      ptr += sizeof(uint16_t);
+
+      // key type
+      __builtin_memcpy(&key->keyType, ptr++, sizeof(uint8_t));
+
+      // keytype data
+      if (key->keyType == KeyType::ROTATION) {
+        // rotation data
+        __builtin_memcpy(&key->rotation.w.value, ptr, sizeof(int16_t)); // 2 bytes
+        ptr += sizeof(int16_t);
+
+        __builtin_memcpy(&key->rotation.x.value, ptr, sizeof(int16_t)); // 2 bytes
+        ptr += sizeof(int16_t);
+
+        __builtin_memcpy(&key->rotation.y.value, ptr, sizeof(int16_t)); // 2 bytes
+        ptr += sizeof(int16_t);
+
+        __builtin_memcpy(&key->rotation.z.value, ptr, sizeof(int16_t)); // 2 bytes
+        ptr += sizeof(int16_t);
+      } else if (key->keyType == KeyType::TRANSLATION) {
+        // translation data
+        __builtin_memcpy(&key->translation.x.value, ptr, sizeof(int32_t)); // 4 bytes
+        ptr += sizeof(int32_t);
+
+        __builtin_memcpy(&key->translation.y.value, ptr, sizeof(int32_t)); // 4 bytes
+        ptr += sizeof(int32_t);
+
+        __builtin_memcpy(&key->translation.z.value, ptr, sizeof(int32_t)); // 4 bytes
+        ptr += sizeof(int32_t);
+      }
+    }
+  }
+
+  // if they have markers
+  anim->markers = *markers;
+  *markers += anim->numMarkers;
+  for (int32_t i = 0; i < anim->numMarkers; i++) {
+    auto *marker = new (&anim->markers[i]) Marker();
+
+    // load the marker name
+    marker->name.assign(reinterpret_cast<const char *>(ptr), MAX_ANIMATION_NAME_LENGTH);
+    ptr += MAX_ANIMATION_NAME_LENGTH;
+
+    // load the frame
+    __builtin_memcpy(&marker->frame, ptr, sizeof(uint16_t));
+    ptr += sizeof(uint16_t);
+  }
+
+  return ptr;
+}
+
+static const uint8_t *ReadAnimationV2(const uint8_t *ptr, Animation *anim, Track **tracks, Key **keys,
+                                      Marker **markers) {
+  // length prefixed name
+  uint8_t nameLength = *ptr++;
+  anim->name.assign(reinterpret_cast<const char *>(ptr), nameLength);
+  ptr += nameLength;
+
+  anim->flags = *ptr++;
+
+  __builtin_memcpy(&anim->length, ptr, sizeof(uint16_t));
+  ptr += sizeof(uint16_t);
+
+  anim->numTracks = *ptr++;
+  anim->numMarkers = *ptr++;
+
+  anim->tracks = *tracks;
+  *tracks += anim->numTracks;
+
+  for (int32_t j = 0; j < anim->numTracks; j++) {
+    auto *track = &anim->tracks[j];
+    track->type = *ptr++;
+    track->jointId = *ptr++;
+
+    __builtin_memcpy(&track->numKeys, ptr, sizeof(uint16_t));
+    ptr += sizeof(uint16_t);
+
+    track->keys = *keys;
+    *keys += track->numKeys;
+
+    // frames are stored as the gap from the previous key
+    uint16_t frame = 0;
+    for (int32_t k = 0; k < track->numKeys; k++) {
+      auto *key = &track->keys[k];
+      frame += *ptr++;
+      key->frame = frame;
+      key->keyType = static_cast<KeyType>(track->type);
+
+      if (key->keyType == KeyType::ROTATION) {
+        // x, y, z only. w is rebuilt
+        __builtin_memcpy(&key->rotation.x.value, ptr, sizeof(int16_t));
+        ptr += sizeof(int16_t);
+
+        __builtin_memcpy(&key->rotation.y.value, ptr, sizeof(int16_t));
+        ptr += sizeof(int16_t);
+
+        __builtin_memcpy(&key->rotation.z.value, ptr, sizeof(int16_t));
+        ptr += sizeof(int16_t);
+
+        key->rotation.w = ReconstructQuaternionW(key->rotation);
+      } else {
+        __builtin_memcpy(&key->translation.x.value, ptr, sizeof(int32_t));
+        ptr += sizeof(int32_t);
+
+        __builtin_memcpy(&key->translation.y.value, ptr, sizeof(int32_t));
+        ptr += sizeof(int32_t);
+
+        __builtin_memcpy(&key->translation.z.value, ptr, sizeof(int32_t));
+        ptr += sizeof(int32_t);
+      }
+    }
+  }
+
+  anim->markers = *markers;
+  *markers += anim->numMarkers;
+  for (int32_t i = 0; i < anim->numMarkers; i++) {
+    auto *marker = new (&anim->markers[i]) Marker();
+
+    uint8_t markerNameLength = *ptr++;
+    marker->name.assign(reinterpret_cast<const char *>(ptr), markerNameLength);
+    ptr += markerNameLength;
+
+    __builtin_memcpy(&marker->frame, ptr, sizeof(uint16_t));
+    ptr += sizeof(uint16_t);
+  }
+
+  return ptr;
+}
+
+// returns the bank holding this file, or -1
+static int32_t FindBank(const AnimationBank *banks, uint32_t fileHash, const char *fileName) {
+  for (int32_t i = 0; i < MAX_ANIMATION_BANKS; i++) {
+    if (banks[i].refCount > 0 && banks[i].fileHash == fileHash && banks[i].fileName == fileName)
+      return i;
+  }
+
+  return -1;
+}
 
 psyqo::Coroutine<> AnimationManager::LoadAnimation(const char *animationsFile) {
+  // already resident? just take another reference
+  auto fileHash = HashString(animationsFile);
+  auto existingBank = FindBank(m_banks, fileHash, animationsFile);
+  if (existingBank != -1) {
+    m_banks[existingBank].refCount++;
+    co_return;
+  }
+
   auto buffer = co_await ArchiveHelper::LoadFile(animationsFile);
+  ParseAnimation(animationsFile, eastl::move(buffer));
+}
 
+bool AnimationManager::ParseAnimation(const char *animationsFile, psyqo::Buffer<uint8_t> &&buffer) {
   void *data = buffer.data();
   size_t size = buffer.size();
   if (data == nullptr || size == 0) {
     buffer.clear();
     printf("ANIMATIONS: Failed to load animations file or it has no file size.\n");
-    co_return;
+    return false;
   }
 
-  // basic struct setup
-  __builtin_memset(&m_loadedAnimBin, 0, sizeof(AnimationBin));
+  // someone else may have loaded it while we were waiting on the read
+  auto fileHash = HashString(animationsFile);
+  auto existingBank = FindBank(m_banks, fileHash, animationsFile);
+  if (existingBank != -1) {
+    m_banks[existingBank].refCount++;
+    buffer.clear();
+    return true;
+  }
+
+  int32_t bankIx = -1;
+  for (int32_t i = 0; i < MAX_ANIMATION_BANKS; i++) {
+    if (m_banks[i].refCount == 0) {
+      bankIx = i;
+      break;
+    }
+  }
+
+  if (bankIx == -1) {
+    printf("ANIMATIONS: No free animation banks for %s.\n", animationsFile);
+    buffer.clear();
+    return false;
+  }
 
   // pointer math type
-  uint8_t *ptr = (uint8_t *)data;
+  const uint8_t *ptr = (const uint8_t *)data;
+  const uint8_t *end = ptr + size;
+
+  // animbin header. magic(7) + version(1) + count(1)
+  if (!Fits(ptr, end, 9)) {
+    printf("ANIMATIONS: File is truncated. aborting.\n");
+    buffer.clear();
+    return false;
+  }
 
-  // animbin header
-  eastl::fixed_string<char, 7> magic(reinterpret_cast<char *>(ptr), 7);
+  eastl::fixed_string<char, 7> magic(reinterpret_cast<const char *>(ptr), 7);
   ptr += 7;
 
   // verify the magic value
   if (magic.compare("ANIMBIN") != 0) {
     printf("ANIMATIONS: Header is invalid. aborting.\n");
     buffer.clear();
-    co_return;
+    return false;
   }
 
   // version + anim count
-  uint8_t version = 0;
-  __builtin_memcpy(&version, ptr++, 1);                       // 1 byte
-  __builtin_memcpy(&m_loadedAnimBin.numAnimations, ptr++, 1); // 1 byte
+  uint8_t version = *ptr++;
+  uint8_t numAnimations = *ptr++;
+  if (version != 1 && version != 2) {
+    printf("ANIMATIONS: Unsupported version %d. aborting.\n", version);
+    buffer.clear();
+    return false;
+  }
 
-  // for the number of animations...
-  for (int32_t i = 0; i < m_loadedAnimBin.numAnimations; i++) {
-    auto *anim = &m_loadedAnimBin.animations[i];
-    
-    // load the name
-    anim->name.assign(reinterpret_cast<char *>(ptr));
-    ptr += MAX_ANIMATION_NAME_LENGTH;
+  // size everything up front so the whole bin is a single allocation with no spare slots
+  AnimationBinCounts counts;
+  if (!CountAnimationBin(ptr, end, version, numAnimations, &counts)) {
+    printf("ANIMATIONS: File is truncated. aborting.\n");
+    buffer.clear();
+    return false;
+  }
 
-    // load any flags it has
-    __builtin_memcpy(&anim->flags, ptr, sizeof(uint32_t));
-    ptr += sizeof(uint32_t);
+  size_t binSize = sizeof(Animation) * numAnimations + sizeof(Track) * counts.tracks + sizeof(Key) * counts.keys +
+                   sizeof(Marker) * counts.markers;
+  uint8_t *block = (uint8_t *)SceneArena::Allocate(binSize);
+  if (block == nullptr) {
+    printf("ANIMATIONS: Failed to allocate %d bytes for animations.\n", binSize);
+    buffer.clear();
+    return false;
+  }
 
-    // length of animation
-    __builtin_memcpy(&anim->length, ptr, sizeof(uint16_t));
-    ptr += sizeof(uint16_t);
+  auto &bank = m_banks[bankIx];
+  bank.fileName = animationsFile;
+  bank.fileHash = fileHash;
+  bank.refCount = 1;
+  bank.bin.numAnimations = numAnimations;
+  bank.bin.animations = (Animation *)block;
 
-    // number of tracks
-    __builtin_memcpy(&anim->numTracks, ptr, sizeof(uint16_t));
-    ptr += sizeof(uint16_t);
+  auto *tracks = (Track *)(block + sizeof(Animation) * numAnimations);
+  auto *keys = (Key *)(tracks + counts.tracks);
+  auto *markers = (Marker *)(keys + counts.keys);
 
-    // numer of frame markers
-    __builtin_memcpy(&anim->numMarkers, ptr, sizeof(uint16_t));
-    ptr += sizeof(uint16_t);
+  // for the number of animations...
+  for (int32_t i = 0; i < numAnimations; i++) {
+    auto *anim = new (&bank.bin.animations[i]) Animation();
+
+    if (version == 1)
+      ptr = ReadAnimationV1(ptr, anim, &tracks, &keys, &markers);
+    else
+      ptr = ReadAnimationV2(ptr, anim, &tracks, &keys, &markers);
 
-    // load the tracks (should be one per bone)
+    // the exporter only writes a translation track for the root bone, and only for root motion.
+    // which bone is the root depends on the skeleton, so PlayAnimation checks that before using it
     for (int32_t j = 0; j < anim->numTracks; j++) {
-      auto *track = &anim->tracks[j];
+      if (anim->tracks[j].type == KeyType::TRANSLATION) {
+        anim->rootMotionTrack = j;
+        break;
+      }
+    }
+  }
 
-      // track type (rotation or translation)
-      __builtin_memcpy(&track->type, ptr++, sizeof(uint8_t));
+  IndexBank(bankIx);
 
-      // which bone
-      __builtin_memcpy(&track->jointId, ptr++, sizeof(uint8_t));
+  // free the buffer
+  buffer.clear();
+  printf("ANIMATIONS: Successfully loaded animations file of %d bytes into bank %d (%d bytes of memory).\n", size,
+         bankIx, binSize);
+  return true;
+}
 
-      // keyframes
-      __builtin_memcpy(&track->numKeys, ptr, sizeof(uint16_t));
-      ptr += sizeof(uint16_t);
+void AnimationManager::IndexBank(uint8_t bankIx) {
+  const auto &bank = m_banks[bankIx];
 
-      // for each frame (key)
-      for (int32_t k = 0; k < track->numKeys; k++) {
-        auto *key = &track->keys[k];
+  for (int32_t i = 0; i < bank.bin.numAnimations; i++) {
+    auto key = HashString(bank.bin.animations[i].name.c_str(), bank.fileHash);
 
-        // frame number
-        __builtin_memcpy(&key->frame, ptr, sizeof(uint16_t));
-        ptr += sizeof(uint16_t);
+    // linear probe for a free slot
+    uint16_t slot = key & (ANIMATION_CLIP_INDEX_SIZE - 1);
+    uint16_t probes = 0;
+    while (m_clipIndex[slot].handle.IsValid() && probes < ANIMATION_CLIP_INDEX_SIZE) {
+      slot = (slot + 1) & (ANIMATION_CLIP_INDEX_SIZE - 1);
+      probes++;
+    }
 
-        // key type
-        __builtin_memcpy(&key->keyType, ptr++, sizeof(uint8_t));
+    if (probes == ANIMATION_CLIP_INDEX_SIZE) {
+      printf("ANIMATIONS: Clip index is full, %s won't be found by name.\n", bank.bin.animations[i].name.c_str());
+      return;
+    }
 
-        // keytype data
-        if (key->keyType == KeyType::ROTATION) {
-          // rotation data
-          __builtin_memcpy(&key->rotation.w.value, ptr, sizeof(int16_t)); // 2 bytes
-          ptr += sizeof(int16_t);
+    m_clipIndex[slot] = {key, {uint8_t(bankIx + 1), uint8_t(i), bank.generation}};
+  }
+}
 
-          __builtin_memcpy(&key->rotation.x.value, ptr, sizeof(int16_t)); // 2 bytes
-          ptr += sizeof(int16_t);
+// open addressing can't just blank a slot without breaking probe chains, so unloads rebuild the whole thing.
+// they're rare (scene changes) and there's only a few hundred entries
+void AnimationManager::RebuildClipIndex() {
+  for (auto &entry : m_clipIndex) {
+    entry = {};
+  }
 
-          __builtin_memcpy(&key->rotation.y.value, ptr, sizeof(int16_t)); // 2 bytes
-          ptr += sizeof(int16_t);
+  for (int32_t i = 0; i < MAX_ANIMATION_BANKS; i++) {
+    if (m_banks[i].refCount > 0)
+      IndexBank(i);
+  }
+}
 
-          __builtin_memcpy(&key->rotation.z.value, ptr, sizeof(int16_t)); // 2 bytes
-          ptr += sizeof(int16_t);
-        } else if (key->keyType == KeyType::TRANSLATION) {
-          // translation data
-          __builtin_memcpy(&key->translation.x.value, ptr, sizeof(int32_t)); // 4 bytes
-          ptr += sizeof(int32_t);
+void AnimationManager::UnloadAnimation(const char *animationsFile) {
+  auto bankIx = FindBank(m_banks, HashString(animationsFile), animationsFile);
+  if (bankIx == -1)
+    return;
 
-          __builtin_memcpy(&key->translation.y.value, ptr, sizeof(int32_t)); // 4 bytes
-          ptr += sizeof(int32_t);
+  auto &bank = m_banks[bankIx];
+  if (--bank.refCount > 0)
+    return;
 
-          __builtin_memcpy(&key->translation.z.value, ptr, sizeof(int32_t)); // 4 bytes
-          ptr += sizeof(int32_t);
-        }
-      }
-    }
+  SceneArena::Free(bank.bin.animations);
+  bank.bin = {0, nullptr};
+  PoseCache::Clear();
+  bank.fileName.clear();
+  bank.generation++;
 
-    // if they have markers
-    if (anim->numMarkers) {
-      for (int32_t i = 0; i < anim->numMarkers; i++) {
-        auto *marker = &anim->markers[i];
-        // load the marker name
-        marker->name.assign(reinterpret_cast<char *>(ptr), MAX_ANIMATION_NAME_LENGTH);
-        ptr += MAX_ANIMATION_NAME_LENGTH;
-
-        // load the frame
-        __builtin_memcpy(&marker->frame, ptr, sizeof(uint16_t));
-        ptr += sizeof(uint16_t);
-      }
+  RebuildClipIndex();
+}
+
+AnimationHandle AnimationManager::FindAnimationInBank(uint8_t bankIx, const char *animationName) {
+  auto key = HashString(animationName, m_banks[bankIx].fileHash);
+
+  uint16_t slot = key & (ANIMATION_CLIP_INDEX_SIZE - 1);
+  for (uint16_t probes = 0; probes < ANIMATION_CLIP_INDEX_SIZE; probes++) {
+    const auto &entry = m_clipIndex[slot];
+
+    // hit an empty slot, it's not in here
+    if (!entry.handle.IsValid())
+      break;
+
+    // the hash could collide so make sure the bank and name actually match
+    if (entry.key == key && entry.handle.bank == bankIx + 1) {
+      auto *anim = GetAnimation(entry.handle);
+      if (anim && anim->name == animationName)
+        return entry.handle;
     }
+
+    slot = (slot + 1) & (ANIMATION_CLIP_INDEX_SIZE - 1);
   }
 
-  // free the buffer
-  buffer.clear();
-  printf("ANIMATIONS: Successfully loaded animations file of %d bytes into memory.\n", size);
+  return {};
+}
+
+AnimationHandle AnimationManager::FindAnimation(const char *animationsFile, const char *animationName) {
+  auto bankIx = FindBank(m_banks, HashString(animationsFile), animationsFile);
+  if (bankIx == -1)
+    return {};
+
+  return FindAnimationInBank(bankIx, animationName);
 }
 
-Animation * AnimationManager::GetAnimationFromName(const eastl::fixed_string<char, MAX_ANIMATION_NAME_LENGTH> &animationName) {
-  for (int32_t i = 0; i < m_loadedAnimBin.numAnimations; i++) {
-    auto *anim = &m_loadedAnimBin.animations[i];
-    if (anim == nullptr)
+AnimationHandle AnimationManager::FindAnimation(const char *animationName) {
+  // one lookup per resident bank, so still only a handful of hashes
+  for (int32_t i = 0; i < MAX_ANIMATION_BANKS; i++) {
+    if (m_banks[i].refCount == 0)
       continue;
 
-    if (anim->name == animationName)
-      return anim;
+    auto handle = FindAnimationInBank(i, animationName);
+    if (handle.IsValid())
+      return handle;
+  }
+
+  return {};
+}
+
+Animation *AnimationManager::GetAnimation(AnimationHandle handle) {
+  if (!handle.IsValid() || handle.bank > MAX_ANIMATION_BANKS)
+    return nullptr;
+
+  const auto &bank = m_banks[handle.bank - 1];
+  if (bank.refCount == 0 || bank.generation != handle.generation || handle.clip >= bank.bin.numAnimations)
+    return nullptr;
+
+  return &bank.bin.animations[handle.clip];
+}
+
+AnimationHandle AnimationManager::HandleOf(const Animation *animation) {
+  if (animation == nullptr)
+    return {};
+
+  // every clip in a bank is in its one block, so the pointer says which bank and clip it is
+  for (int32_t i = 0; i < MAX_ANIMATION_BANKS; i++) {
+    const auto &bank = m_banks[i];
+    if (bank.refCount == 0 || animation < bank.bin.animations || animation >= bank.bin.animations + bank.bin.numAnimations)
+      continue;
+
+    return {uint8_t(i + 1), uint8_t(animation - bank.bin.animations), bank.generation};
+  }
+
+  return {};
+}
+
+Animation *AnimationManager::GetAnimationFromName(const char *animationsFile, const eastl::fixed_string<char, MAX_ANIMATION_NAME_LENGTH> &animationName) {
+  return GetAnimation(FindAnimation(animationsFile, animationName.c_str()));
+}
+
+Animation *AnimationManager::GetAnimationFromName(const eastl::fixed_string<char, MAX_ANIMATION_NAME_LENGTH> &animationName) {
+  return GetAnimation(FindAnimation(animationName.c_str()));
+}
+
+void AnimationManager::Dump(void) {
+  for (auto &bank : m_banks) {
+    SceneArena::Free(bank.bin.animations);
+
+    bank.bin = {0, nullptr};
+    bank.fileName.clear();
+    bank.refCount = 0;
+    bank.generation++;
   }
 
-  return nullptr;
+  PoseCache::Clear();
+  RebuildClipIndex();
 }
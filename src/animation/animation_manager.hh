@@ -1,16 +1,62 @@
 #ifndef _ANIMATION_MANAGER_H
 #define _ANIMATION_MANAGER_H
 
+#include "../helpers/archive.hh"
 #include "EASTL/fixed_string.h"
 #include "animation.hh"
+#include "psyqo/buffer.hh"
 #include "psyqo/coroutine.hh"
 
+static constexpr uint8_t MAX_ANIMATION_BANKS = 8;
+
+// must be a power of 2. open addressed so keep it well above the number of resident clips
+static constexpr uint16_t ANIMATION_CLIP_INDEX_SIZE = 256;
+
+// one loaded .ANIMBIN file
+struct AnimationBank {
+  eastl::fixed_string<char, MAX_ARCHIVE_FILE_NAME_LEN> fileName;
+  uint32_t fileHash;
+  uint16_t refCount;
+  uint16_t generation; // bumped on unload so old handles stop resolving
+  AnimationBin bin;
+};
+
+// bank file + clip name hash -> clip, for every resident bank. two banks can both have an "idle"
+struct AnimationClipIndexEntry {
+  uint32_t key;
+  AnimationHandle handle;
+};
+
 class AnimationManager final {
-  static AnimationBin m_loadedAnimBin;
+  static AnimationBank m_banks[MAX_ANIMATION_BANKS];
+  static AnimationClipIndexEntry m_clipIndex[ANIMATION_CLIP_INDEX_SIZE];
+
+  static void IndexBank(uint8_t bankIx);
+  static void RebuildClipIndex();
+  static AnimationHandle FindAnimationInBank(uint8_t bankIx, const char *animationName);
 
 public:
+  // loading a file that's already resident just adds a reference to it
   static psyqo::Coroutine<> LoadAnimation(const char *animationsFile);
+
+  // the synchronous half of LoadAnimation, for a file that has already been read. takes ownership of the buffer
+  static bool ParseAnimation(const char *animationsFile, psyqo::Buffer<uint8_t> &&buffer);
+
+  // drops a reference, the bank is freed once nothing references it
+  static void UnloadAnimation(const char *animationsFile);
+
+  // a clip from one animbin. use this when banks share clip names
+  static AnimationHandle FindAnimation(const char *animationsFile, const char *animationName);
+  // the clip from the first resident bank that has one with this name
+  static AnimationHandle FindAnimation(const char *animationName);
+  static Animation *GetAnimation(AnimationHandle handle);
+  // the handle for a clip that's already been looked up. invalid if it isn't in a resident bank
+  static AnimationHandle HandleOf(const Animation *animation);
+  static Animation *GetAnimationFromName(const char *animationsFile, const eastl::fixed_string<char, MAX_ANIMATION_NAME_LENGTH> &animationName);
   static Animation *GetAnimationFromName(const eastl::fixed_string<char, MAX_ANIMATION_NAME_LENGTH> &animationName);
+
+  // free every bank regardless of references. used when switching to a loading screen
+  static void Dump(void);
 };
 
 #endif
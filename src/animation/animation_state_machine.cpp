@@ -0,0 +1,110 @@
+#include "animation_state_machine.hh"
+#include "animation_manager.hh"
+#include "psyqo/xprintf.h"
+
+uint8_t AnimationStateMachine::AddState(const char *animationName, uint16_t blendFrames) {
+  if (m_states.full()) {
+    printf("ANIMATIONS: Too many states in state machine. can't add %s\n", animationName);
+    return ANY_ANIMATION_STATE;
+  }
+
+  m_states.push_back({animationName, blendFrames});
+  return m_states.size() - 1;
+}
+
+void AnimationStateMachine::AddTransition(const AnimationTransition &transition) {
+  if (m_transitions.full()) {
+    printf("ANIMATIONS: Too many transitions in state machine.\n");
+    return;
+  }
+
+  m_transitions.push_back(transition);
+}
+
+void AnimationStateMachine::SetParameter(uint8_t parameter, int16_t value) {
+  if (parameter >= MAX_ANIMATION_PARAMETERS)
+    return;
+
+  m_parameters[parameter] = value;
+}
+
+int16_t AnimationStateMachine::parameter(uint8_t parameter) const {
+  if (parameter >= MAX_ANIMATION_PARAMETERS)
+    return 0;
+
+  return m_parameters[parameter];
+}
+
+AnimationHandle AnimationStateMachine::StateAnimation(uint8_t state) const {
+  if (m_animationsFile.empty())
+    return AnimationManager::FindAnimation(m_states[state].animationName.c_str());
+
+  return AnimationManager::FindAnimation(m_animationsFile.c_str(), m_states[state].animationName.c_str());
+}
+
+void AnimationStateMachine::EnterState(Skeleton *skeleton, uint8_t state) {
+  if (state >= m_states.size())
+    return;
+
+  m_currentState = state;
+
+  // looked up when entering so the animbin can be reloaded under us
+  auto animation = StateAnimation(state);
+  if (!animation.IsValid()) {
+    printf("ANIMATIONS: State machine couldn't find animation %s\n", m_states[state].animationName.c_str());
+    return;
+  }
+
+  SkeletonController::SetAnimation(skeleton, animation, m_states[state].blendFrames);
+}
+
+void AnimationStateMachine::Start(Skeleton *skeleton, uint8_t state) {
+  if (skeleton == nullptr || state >= m_states.size())
+    return;
+
+  // hard cut into the starting state
+  skeleton->animation = {};
+  skeleton->previousAnimation = {};
+  m_currentState = state;
+
+  auto animation = StateAnimation(state);
+  SkeletonController::SetAnimation(skeleton, animation);
+}
+
+void AnimationStateMachine::Update(Skeleton *skeleton) {
+  if (skeleton == nullptr)
+    return;
+
+  for (const auto &transition : m_transitions) {
+    if (transition.fromState != ANY_ANIMATION_STATE && transition.fromState != m_currentState)
+      continue;
+
+    // dont re-enter the state we're already in from an "any" transition
+    if (transition.toState == m_currentState)
+      continue;
+
+    auto value = parameter(transition.parameter);
+    bool passed = false;
+    switch (transition.condition) {
+    case AnimationCondition::EQUAL:
+      passed = value == transition.value;
+      break;
+    case AnimationCondition::NOT_EQUAL:
+      passed = value != transition.value;
+      break;
+    case AnimationCondition::GREATER:
+      passed = value > transition.value;
+      break;
+    case AnimationCondition::LESS:
+      passed = value < transition.value;
+      break;
+    }
+
+    if (!passed)
+      continue;
+
+    // first transition that passes wins
+    EnterState(skeleton, transition.toState);
+    return;
+  }
+}
@@ -0,0 +1,64 @@
+#ifndef _ANIMATION_STATE_MACHINE_HH
+#define _ANIMATION_STATE_MACHINE_HH
+
+#include "../helpers/archive.hh"
+#include "../mesh/skeleton/skeleton.hh"
+#include "EASTL/fixed_string.h"
+#include "EASTL/fixed_vector.h"
+#include "animation.hh"
+#include <cstdint>
+
+static constexpr uint8_t MAX_ANIMATION_STATES = 8;
+static constexpr uint8_t MAX_ANIMATION_TRANSITIONS = 16;
+static constexpr uint8_t MAX_ANIMATION_PARAMETERS = 8;
+static constexpr uint8_t ANY_ANIMATION_STATE = 0xff;
+
+enum class AnimationCondition : uint8_t { EQUAL, NOT_EQUAL, GREATER, LESS };
+
+// a state just plays a single clip from the loaded animbin
+struct AnimationState {
+  eastl::fixed_string<char, MAX_ANIMATION_NAME_LENGTH> animationName;
+  uint16_t blendFrames = 0; // cross-fade length when entering this state
+};
+
+// "when parameter X is (condition) Y, go from state A to state B"
+struct AnimationTransition {
+  uint8_t fromState; // ANY_ANIMATION_STATE = from any state
+  uint8_t toState;
+  uint8_t parameter;
+  AnimationCondition condition;
+  int16_t value;
+};
+
+// picks the clip to play on a skeleton from a table of states/transitions and a handful of game set parameters
+class AnimationStateMachine {
+  eastl::fixed_vector<AnimationState, MAX_ANIMATION_STATES, false> m_states;
+  eastl::fixed_vector<AnimationTransition, MAX_ANIMATION_TRANSITIONS, false> m_transitions;
+  int16_t m_parameters[MAX_ANIMATION_PARAMETERS] = {0};
+  uint8_t m_currentState = ANY_ANIMATION_STATE;
+  eastl::fixed_string<char, MAX_ARCHIVE_FILE_NAME_LEN> m_animationsFile;
+
+  void EnterState(Skeleton *skeleton, uint8_t state);
+  AnimationHandle StateAnimation(uint8_t state) const;
+
+public:
+  // look the states' clips up in this animbin only. without it they come from the first bank that has them
+  void SetAnimationsFile(const char *animationsFile) { m_animationsFile = animationsFile; }
+
+  // returns the index of the state to use in transitions
+  uint8_t AddState(const char *animationName, uint16_t blendFrames = 0);
+  void AddTransition(const AnimationTransition &transition);
+
+  void SetParameter(uint8_t parameter, int16_t value);
+  int16_t parameter(uint8_t parameter) const;
+
+  // jump straight into a state without blending
+  void Start(Skeleton *skeleton, uint8_t state);
+
+  // checks the transitions from the current state and blends to the first one that passes
+  void Update(Skeleton *skeleton);
+
+  uint8_t currentState() const { return m_currentState; }
+};
+
+#endif
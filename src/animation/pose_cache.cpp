@@ -0,0 +1,39 @@
+#include "pose_cache.hh"
+
+CachedPose PoseCache::m_entries[POSE_CACHE_SIZE] = {};
+uint32_t PoseCache::m_hits = 0;
+uint32_t PoseCache::m_misses = 0;
+
+uint8_t PoseCache::SlotFor(const Animation *animation, uint16_t frame) {
+  // animations are far bigger than 16 bytes so the low bits of the address are all the same
+  auto hash = (reinterpret_cast<uintptr_t>(animation) >> 4) * 31 + frame;
+  return hash & (POSE_CACHE_SIZE - 1);
+}
+
+const CachedPose *PoseCache::Find(const Animation *animation, uint16_t frame) {
+  const auto &entry = m_entries[SlotFor(animation, frame)];
+  if (entry.animation == animation && entry.frame == frame) {
+    m_hits++;
+    return &entry;
+  }
+
+  m_misses++;
+  return nullptr;
+}
+
+CachedPose *PoseCache::Insert(const Animation *animation, uint16_t frame) {
+  auto &entry = m_entries[SlotFor(animation, frame)];
+  entry.animation = animation;
+  entry.frame = frame;
+  entry.boneMask = 0;
+  return &entry;
+}
+
+void PoseCache::Clear(void) {
+  for (auto &entry : m_entries) {
+    entry.animation = nullptr;
+  }
+
+  m_hits = 0;
+  m_misses = 0;
+}
@@ -0,0 +1,43 @@
+#ifndef _POSE_CACHE_HH
+#define _POSE_CACHE_HH
+
+#include "../mesh/skeleton/skeleton.hh"
+#include "animation.hh"
+#include <cstdint>
+
+// must be a power of 2
+static constexpr uint8_t POSE_CACHE_SIZE = 32;
+
+// every tracked bone's rotation for one frame of one animation
+struct CachedPose {
+  const Animation *animation = nullptr;
+  uint16_t frame = 0;
+  uint16_t boneMask = 0; // which entries in rotations are set
+  Quaternion rotations[MAX_BONES];
+};
+
+// evaluated poses keyed by (animation, frame). keyed on the animation rather than the skeleton so every
+// character playing the same clip shares the same entries, e.g. a room of enemies all idling.
+// direct mapped, a new pose just replaces whatever was in its slot
+class PoseCache final {
+  static CachedPose m_entries[POSE_CACHE_SIZE];
+  static uint32_t m_hits;
+  static uint32_t m_misses;
+
+  static uint8_t SlotFor(const Animation *animation, uint16_t frame);
+
+public:
+  // nullptr on a miss
+  static const CachedPose *Find(const Animation *animation, uint16_t frame);
+
+  // claims the slot for this pose, the caller fills in boneMask and rotations
+  static CachedPose *Insert(const Animation *animation, uint16_t frame);
+
+  // must be called when animations are freed, the cache is keyed on their addresses
+  static void Clear(void);
+
+  static uint32_t hits() { return m_hits; }
+  static uint32_t misses() { return m_misses; }
+};
+
+#endif
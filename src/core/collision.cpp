@@ -30,7 +30,7 @@ void Collision::GenerateAABBForMesh(const GameObject *object, AABBCollision *col
   // for each vertex on the mesh
   for (uint16_t vert = 0; vert < mesh->vertexCount; vert++) {
     // apply object rotation to the vert positions
-    auto vertPos = mesh->vertices[vert];
+    auto vertPos = mesh->vertices[vert].ToVec3();
 
     // mins
     if (vertPos.x < collisionBoxOut->min.x)
@@ -1,15 +1,24 @@
 #include "perf_monitor.hh"
+#include "../../helpers/scene_arena.hh"
 #include "../../render/renderer.hh"
 #include "psyqo/alloc.h"
 
 GameplayHUD PerfMonitor::m_perfMontiorHUD = GameplayHUD("Perf Monitor", {.pos = {5, 10}, .size = {100, 100}});
 TextHUDElement *PerfMonitor::m_heapSizeText = nullptr;
 TextHUDElement *PerfMonitor::m_fpsText = nullptr;
+TextHUDElement *PerfMonitor::m_arenaText = nullptr;
+TextHUDElement *PerfMonitor::m_tpageText = nullptr;
 bool PerfMonitor::m_hasInitialized = false;
 uint32_t PerfMonitor::m_deltaTimeAccum;
 uint32_t PerfMonitor::m_frameCount;
 uint8_t PerfMonitor::m_renderedGameObjects;
 uint8_t PerfMonitor::m_totalGameObjects;
+uint32_t PerfMonitor::m_heapHighWater;
+uint32_t PerfMonitor::m_lastHeapUsed;
+uint32_t PerfMonitor::m_lastArenaUsed;
+uint32_t PerfMonitor::m_lastArenaSpills;
+uint32_t PerfMonitor::m_lastArenaCapacity;
+bool PerfMonitor::m_hasArenaText = false;
 
 void PerfMonitor::Init(void) {
   m_heapSizeText = m_perfMontiorHUD.AddTextHUDElement(TextHUDElement("HEAP", {.pos = {5, 0}, .size = {100, 100}}));
@@ -17,6 +26,15 @@ void PerfMonitor::Init(void) {
 
   m_fpsText = m_perfMontiorHUD.AddTextHUDElement(TextHUDElement("FPS", {.pos = {5, 15}, .size = {100, 100}}));
   m_fpsText->SetFont(Renderer::Instance().SystemFont());
+
+  m_arenaText = m_perfMontiorHUD.AddTextHUDElement(TextHUDElement("ARENA", {.pos = {5, 30}, .size = {100, 100}}));
+  m_arenaText->SetFont(Renderer::Instance().SystemFont());
+
+  m_tpageText = m_perfMontiorHUD.AddTextHUDElement(TextHUDElement("TPAGE", {.pos = {5, 45}, .size = {100, 100}}));
+  m_tpageText->SetFont(Renderer::Instance().SystemFont());
+
+  // the renderer only keeps track of tpage changes while something is showing them
+  Renderer::Instance().SetCountingTPageChanges(true);
   m_hasInitialized = true;
 }
 
@@ -24,10 +42,31 @@ void PerfMonitor::Render(uint32_t deltaTime) {
   if (!m_hasInitialized)
     Init();
 
-  char heapSize[GAMEPLAY_HUD_ELEMENT_MAX_STR_LEN];
-  snprintf(heapSize, GAMEPLAY_HUD_ELEMENT_MAX_STR_LEN, "Heap Used: %d",
-           (int)((uint8_t *)psyqo_heap_end() - (uint8_t *)psyqo_heap_start()));
-  m_heapSizeText->SetDisplayText(heapSize);
+  // this is the span of the heap, not what's live in it. a peak that keeps creeping up between scenes means it's fragmenting
+  uint32_t heapUsed = (uint8_t *)psyqo_heap_end() - (uint8_t *)psyqo_heap_start();
+  if (heapUsed > m_heapHighWater)
+    m_heapHighWater = heapUsed;
+
+  // these barely move, so only format them when they do. the text element only lays out text that's changed
+  if (heapUsed != m_lastHeapUsed) {
+    m_lastHeapUsed = heapUsed;
+    char heapSize[GAMEPLAY_HUD_ELEMENT_MAX_STR_LEN];
+    snprintf(heapSize, GAMEPLAY_HUD_ELEMENT_MAX_STR_LEN, "Heap Used: %d (peak %d)", (int)heapUsed, (int)m_heapHighWater);
+    m_heapSizeText->SetDisplayText(heapSize);
+  }
+
+  // arena use out of what it's holding from the heap, peak and how many allocations didn't fit
+  uint32_t arenaUsed = SceneArena::Used(), arenaSpills = SceneArena::HeapFallbacks(), arenaCapacity = SceneArena::Capacity();
+  if (arenaUsed != m_lastArenaUsed || arenaSpills != m_lastArenaSpills || arenaCapacity != m_lastArenaCapacity || !m_hasArenaText) {
+    m_lastArenaUsed = arenaUsed;
+    m_lastArenaSpills = arenaSpills;
+    m_lastArenaCapacity = arenaCapacity;
+    m_hasArenaText = true;
+    char arenaSize[GAMEPLAY_HUD_ELEMENT_MAX_STR_LEN];
+    snprintf(arenaSize, GAMEPLAY_HUD_ELEMENT_MAX_STR_LEN, "Arena: %dK of %dK held (peak %dK, %d spilled)", (int)(arenaUsed / 1024),
+             (int)(arenaCapacity / 1024), (int)(SceneArena::HighWater() / 1024), (int)arenaSpills);
+    m_arenaText->SetDisplayText(arenaSize);
+  }
 
   m_deltaTimeAccum += deltaTime;
   m_frameCount++;
@@ -37,6 +76,12 @@ void PerfMonitor::Render(uint32_t deltaTime) {
       char fpsStr[GAMEPLAY_HUD_ELEMENT_MAX_STR_LEN];
       snprintf(fpsStr, GAMEPLAY_HUD_ELEMENT_MAX_STR_LEN, "FPS: %d (%d/%d GO)", fps.integer(), m_renderedGameObjects, m_totalGameObjects);
       m_fpsText->SetDisplayText(fpsStr);
+
+      // how often the gpu had to switch tpage or clut between game object faces on the last frame
+      char tpageChanges[GAMEPLAY_HUD_ELEMENT_MAX_STR_LEN];
+      snprintf(tpageChanges, GAMEPLAY_HUD_ELEMENT_MAX_STR_LEN, "TPage changes: %d%s", Renderer::Instance().TPageChanges(),
+               Renderer::Instance().IsGroupingByTexture() ? " (grouped)" : "");
+      m_tpageText->SetDisplayText(tpageChanges);
       m_deltaTimeAccum = 0;
       m_frameCount = 0;
   }
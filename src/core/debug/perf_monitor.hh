@@ -14,6 +14,8 @@ private:
   static GameplayHUD m_perfMontiorHUD;
   static TextHUDElement *m_heapSizeText;
   static TextHUDElement *m_fpsText;
+  static TextHUDElement *m_arenaText;
+  static TextHUDElement *m_tpageText;
 
   static void Init(void);
 
@@ -21,6 +23,14 @@ private:
   static uint32_t m_frameCount;
   static uint8_t m_renderedGameObjects;
   static uint8_t m_totalGameObjects;
+  static uint32_t m_heapHighWater;
+
+  // what the text was last formatted from
+  static uint32_t m_lastHeapUsed;
+  static uint32_t m_lastArenaUsed;
+  static uint32_t m_lastArenaSpills;
+  static uint32_t m_lastArenaCapacity;
+  static bool m_hasArenaText;
 };
 
 #endif
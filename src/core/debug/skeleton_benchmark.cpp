@@ -0,0 +1,73 @@
+#include "skeleton_benchmark.hh"
+#include "../../defs.hh"
+#include "../../mesh/skeleton/skeleton.hh"
+#include "../../render/renderer.hh"
+#include "psyqo/xprintf.h"
+
+#if ENABLE_SKELETON_BENCHMARK
+
+static constexpr uint16_t BENCHMARK_ITERATIONS = 300;
+
+// hips, spine, chest, neck, head, l/r shoulder, arm, hand, l/r thigh, shin. parents in natural order
+static constexpr int8_t humanoidParents[MAX_BONES] = {-1, 0, 1, 2, 3, 2, 5, 6, 2, 8, 9, 0, 11, 0, 13};
+
+// bones are stored shuffled so children come before their parents, which the sort has to fix
+static constexpr uint8_t boneIdForHumanoidBone[MAX_BONES] = {14, 9, 3, 12, 0, 7, 1, 5, 10, 13, 2, 6, 11, 4, 8};
+
+static Skeleton rig;
+
+static void BuildRig(void) {
+  __builtin_memset(&rig, 0, sizeof(Skeleton));
+  rig.numBones = MAX_BONES;
+
+  for (int32_t i = 0; i < MAX_BONES; i++) {
+    auto &bone = rig.bones[boneIdForHumanoidBone[i]];
+    bone.id = boneIdForHumanoidBone[i];
+    bone.parent = humanoidParents[i] == -1 ? -1 : boneIdForHumanoidBone[humanoidParents[i]];
+    bone.localPos = {0, -0.25_fp, 0};
+    bone.localRotation = {1, 0, 0, 0};
+    bone.isDirty = true;
+  }
+
+  SkeletonController::SortBones(&rig);
+  SkeletonController::UpdateSkeletonBoneMatrices(&rig);
+  SkeletonController::MarkBonesClean(&rig);
+}
+
+// animates the bones in `mask` between two rotations and returns the average microseconds per update
+static uint32_t TimeUpdates(uint16_t mask) {
+  static const Quaternion poses[2] = {{1, 0, 0, 0}, {psyqo::GTE::Short(0.98_fp), psyqo::GTE::Short(0.2_fp), 0, 0}};
+  auto &gpu = Renderer::Instance().GPU();
+
+  auto start = gpu.now();
+  for (int32_t i = 0; i < BENCHMARK_ITERATIONS; i++) {
+    for (int32_t b = 0; b < rig.numBones; b++) {
+      if (mask & (1 << b))
+        rig.bones[b].localRotation = poses[i & 1];
+    }
+
+    SkeletonController::UpdateSkeletonBoneMatrices(&rig);
+    SkeletonController::MarkBonesClean(&rig);
+  }
+
+  return (gpu.now() - start) / BENCHMARK_ITERATIONS;
+}
+
+void SkeletonBenchmark::Run(void) {
+  BuildRig();
+
+  auto rootBone = boneIdForHumanoidBone[0];
+  auto leafBone = boneIdForHumanoidBone[10]; // right hand
+
+  printf("SKELETON BENCHMARK: %d bones, %d updates each\n", rig.numBones, BENCHMARK_ITERATIONS);
+  printf("SKELETON BENCHMARK: static pose %dus\n", TimeUpdates(0));
+  printf("SKELETON BENCHMARK: one leaf moving %dus\n", TimeUpdates(1 << leafBone));
+  printf("SKELETON BENCHMARK: root moving %dus\n", TimeUpdates(1 << rootBone));
+  printf("SKELETON BENCHMARK: every bone moving %dus\n", TimeUpdates(ALL_BONES_MASK));
+}
+
+#else
+
+void SkeletonBenchmark::Run(void) {}
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef _SKELETON_BENCHMARK_H
+#define _SKELETON_BENCHMARK_H
+
+// times the skeleton matrix update on a 15 bone humanoid rig for a few common cases
+// (nothing moving, one leaf moving, the root moving, everything moving) and prints the average per update.
+// does nothing unless ENABLE_SKELETON_BENCHMARK is set in defs.hh
+class SkeletonBenchmark final {
+public:
+  static void Run(void);
+};
+
+#endif
@@ -12,6 +12,7 @@ void GameObject::Destroy(void)
     m_pos = {0, 0, 0};
     m_rotation = {0, 0, 0};
     m_tag = GameObjectTag::NONE;
+    MeshManager::ReleaseMesh(m_mesh);
     m_mesh = nullptr;
     m_texture = nullptr;
     m_rotationMatrix = {0};
@@ -22,7 +23,10 @@ void GameObject::Destroy(void)
 
 void GameObject::SetMesh(const char *meshName)
 {
-    MeshManager::GetMeshFromName(meshName, &m_mesh);
+    // take the new one first incase it's the same mesh
+    auto *mesh = MeshManager::AcquireMesh(meshName);
+    MeshManager::ReleaseMesh(m_mesh);
+    m_mesh = mesh;
     GenerateOBB();
 }
 
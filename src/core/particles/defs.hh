@@ -5,7 +5,8 @@
 
 static constexpr uint32_t MICROSECONDS_IN_A_SECOND = 1000000;
 static constexpr uint8_t MAX_PARTICLE_EMITTER_NAME_LENGTH = 32;
-static constexpr uint8_t MAX_PARTICLE_EMITTERS = 3;
+static constexpr uint8_t MAX_PARTICLE_EMITTERS = 8;
+static constexpr uint16_t MAX_PARTICLES = 512; // shared between every emitter
 static constexpr uint8_t INVALID_PARTICLE_EMITTER_ID = 255;
 
 #endif
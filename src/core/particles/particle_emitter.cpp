@@ -1,6 +1,7 @@
 #include "particle_emitter.hh"
 #include "defs.hh"
-#include "particle.hh"
+#include "particle_pool.hh"
+#include "../../math/vector.hh"
 #include "../../render/renderer.hh"
 #include "../../madnight.hh"
 #include "../../math/gte-math.hh"
@@ -24,7 +25,12 @@ void ParticleEmitter::Destroy(void) {
     m_radius = 0;
     m_id = INVALID_PARTICLE_EMITTER_ID;
     m_isEnabled = false;
-    m_spawnedParticles.clear();
+
+    // hand our range of the pool back
+    if (m_maxParticles)
+        ParticlePool::Release(m_firstParticle);
+    m_liveParticles = 0;
+    m_maxParticles = 0;
 }
 
 psyqo::Vec2 ParticleEmitter::GenerateRandomPointOnCircumfrence(void) {
@@ -41,16 +47,41 @@ void ParticleEmitter::Process(const uint32_t &deltaTime) {
 
     m_timeSinceLastParticleSpawn += delta;
 
-    // process active particles
-    for (auto &particle : m_spawnedParticles) {
-        if (!particle.IsDead()) particle.Process(delta);
-    }
- 
-    // clear out dead ones
-    for (int i = m_spawnedParticles.size() - 1; i >= 0; i--) {
-        auto const &particle = m_spawnedParticles.at(i);
-        if (particle.IsDead())
-            m_spawnedParticles.erase(m_spawnedParticles.begin() + i);
+    // need to convert delta time into seconds to get fp first
+    auto fpDeltaTime = 1.0_fp * (delta / 1000) / 1000;
+    auto lifetimeMS = m_lifetimeMicroSeconds / 1000;
+
+    auto &positions = ParticlePool::Positions();
+    auto &velocities = ParticlePool::Velocities();
+    auto &sizes = ParticlePool::Sizes();
+    auto &colours = ParticlePool::Colours();
+    auto &ages = ParticlePool::Ages();
+
+    // process active particles. dead ones get the last live particle swapped into their place,
+    // so only move on once the one in this slot has been processed
+    uint16_t i = m_firstParticle;
+    while (i < m_firstParticle + m_liveParticles) {
+        ages[i] += delta;
+        if (ages[i] >= m_lifetimeMicroSeconds) {
+            m_liveParticles--;
+            ParticlePool::Move(m_firstParticle + m_liveParticles, i);
+            continue;
+        }
+
+        auto lifetimeLerp = (1.0_fp * (ages[i] / 1000)) / (1.0_fp * lifetimeMS);
+        auto r = (m_particleStartColour.r * (1.0_fp - lifetimeLerp) + m_particleEndColour.r * lifetimeLerp).value >> 12;
+        auto g = (m_particleStartColour.g * (1.0_fp - lifetimeLerp) + m_particleEndColour.g * lifetimeLerp).value >> 12;
+        auto b = (m_particleStartColour.b * (1.0_fp - lifetimeLerp) + m_particleEndColour.b * lifetimeLerp).value >> 12;
+
+        colours[i] = {
+            static_cast<uint8_t>(r),
+            static_cast<uint8_t>(g),
+            static_cast<uint8_t>(b)
+        };
+        sizes[i] = Lerp(m_particleStartSize, m_particleEndSize, lifetimeLerp);
+        velocities[i] = Lerp(m_particleRotatedStartVelocity, m_particleRotatedEndVelocity, lifetimeLerp);
+        positions[i] += velocities[i] * fpDeltaTime;
+        i++;
     }
 
     // make sure we're enabled
@@ -58,18 +89,20 @@ void ParticleEmitter::Process(const uint32_t &deltaTime) {
         
     // make sure its been a second and we dont have too many spawned
     m_timeOfLastProcess = now;
-    if (m_timeSinceLastParticleSpawn < m_spawnRate || m_spawnedParticles.size() >= m_maxParticles)
+    if (m_timeSinceLastParticleSpawn < m_spawnRate || m_liveParticles >= m_maxParticles)
         return;
 
     // generate a particle at a random point on the circumfrence
     auto pos = GenerateRandomPointOnCircumfrence();
     auto spawnPos = m_rotatedPos + psyqo::Vec3{pos.x, 0, pos.y};
-    auto particle = Particle(spawnPos, m_particleStartSize, m_particleEndSize, m_particleStartColour, m_particleEndColour, m_particleRotatedStartVelocity, m_particleRotatedEndVelocity, m_particleLifeTime);
+    auto ix = m_firstParticle + m_liveParticles++;
 
-    if (m_particleTexture)
-        particle.SetUVCoords(m_particleUVCoords);
+    ParticlePool::Positions()[ix] = spawnPos;
+    ParticlePool::Velocities()[ix] = m_particleRotatedStartVelocity;
+    ParticlePool::Sizes()[ix] = m_particleStartSize;
+    ParticlePool::Colours()[ix] = m_particleStartColour;
+    ParticlePool::Ages()[ix] = 0;
 
-    m_spawnedParticles.push_back(particle);
     m_timeSinceLastParticleSpawn = 0;
 }
 
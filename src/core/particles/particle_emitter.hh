@@ -1,9 +1,11 @@
 #ifndef _PARTICLE_EMITTER_H
 #define _PARTICLE_EMITTER_H
 
-#include "EASTL/vector.h"
+#include "EASTL/array.h"
+#include "EASTL/fixed_string.h"
 #include "defs.hh"
-#include "particle.hh"
+#include "particle_pool.hh"
+#include "../../textures/texture_manager.hh"
 #include "psyqo/fixed-point.hh"
 #include "psyqo/matrix.hh"
 #include "psyqo/trigonometry.hh"
@@ -20,7 +22,7 @@ typedef struct _EmitterRotation {
 class ParticleEmitter final {
 public:
     ParticleEmitter() = default;
-    ParticleEmitter(const eastl::fixed_string<char, MAX_PARTICLE_EMITTER_NAME_LENGTH> &name, const uint8_t &id, const psyqo::Vec3 &pos, const psyqo::FixedPoint<> radius, const uint8_t &particlesPerSecond, const uint8_t &particleLifeTimeSecs) {
+    ParticleEmitter(const eastl::fixed_string<char, MAX_PARTICLE_EMITTER_NAME_LENGTH> &name, const uint8_t &id, const psyqo::Vec3 &pos, const psyqo::FixedPoint<> radius, const uint8_t &particlesPerSecond, const uint8_t &particleLifeTimeSecs, const uint16_t &firstParticle) {
         m_id = id;
         m_name = name;
         m_pos = pos;
@@ -28,7 +30,9 @@ public:
         m_radius = radius;
         m_particlesPerSecond = particlesPerSecond;
         m_particleLifeTime = particleLifeTimeSecs;
-        m_maxParticles = m_particlesPerSecond * m_particleLifeTime;
+        m_maxParticles = ParticlesNeeded(m_particlesPerSecond, m_particleLifeTime);
+        m_lifetimeMicroSeconds = MICROSECONDS_IN_A_SECOND * m_particleLifeTime;
+        m_firstParticle = firstParticle;
         m_spawnRate = MICROSECONDS_IN_A_SECOND / m_particlesPerSecond;
 
         GenerateRotationMatrix();
@@ -42,7 +46,11 @@ public:
     void Destroy(void);
 
     void Process(const uint32_t &deltaTime);
-    const eastl::vector<Particle> &particles() const { return m_spawnedParticles; };
+
+    // live particles are ParticlePool indices [FirstParticle, FirstParticle + LiveParticles)
+    const uint16_t &FirstParticle() const { return m_firstParticle; }
+    const uint16_t &LiveParticles() const { return m_liveParticles; }
+    static uint16_t ParticlesNeeded(const uint8_t &particlesPerSecond, const uint8_t &particleLifeTimeSecs) { return particlesPerSecond * particleLifeTimeSecs; }
 
     void SetRotation(const EmitterRotation &rotation);
 
@@ -62,6 +70,7 @@ public:
 
     const TimFile *pParticleTexture() const { return m_particleTexture; }
     const bool &AreParticles2D() const { return m_particleIs2D; }
+    const eastl::array<psyqo::PrimPieces::UVCoords, 4> &ParticleUVCoords() const { return m_particleUVCoords; }
 private:
     bool m_isEnabled = false;
     eastl::fixed_string<char, MAX_PARTICLE_EMITTER_NAME_LENGTH> m_name;
@@ -73,7 +82,8 @@ private:
     psyqo::FixedPoint<> m_radius = 0;
     uint16_t m_maxParticles = 0;
     uint8_t m_particlesPerSecond = 0;
-    eastl::vector<Particle> m_spawnedParticles;
+    uint16_t m_firstParticle = 0;
+    uint16_t m_liveParticles = 0;
     uint16_t m_spawnRate = 0;
     uint32_t m_timeSinceLastParticleSpawn = 0;
     uint32_t m_timeOfLastProcess = 0;
@@ -87,6 +97,7 @@ private:
     psyqo::Vec3 m_particleEndVelocity = {0, 0, 0};
     psyqo::Vec3 m_particleRotatedEndVelocity = {0, 0, 0};
     uint8_t m_particleLifeTime = 0;
+    uint32_t m_lifetimeMicroSeconds = 0;
     eastl::array<psyqo::PrimPieces::UVCoords, 4> m_particleUVCoords;
     TimFile *m_particleTexture = nullptr;
     bool m_particleIs2D = true;
@@ -1,7 +1,9 @@
 #include "particle_manager.hh"
 #include "defs.hh"
 #include "particle_emitter.hh"
+#include "particle_pool.hh"
 #include "psyqo/fixed-point.hh"
+#include "psyqo/xprintf.h"
 
 
 eastl::array<ParticleEmitter, MAX_PARTICLE_EMITTERS> ParticleEmitterManager::m_emitters;
@@ -18,7 +20,15 @@ ParticleEmitter *ParticleEmitterManager::CreateParticleEmitter(const eastl::fixe
     if (ix == -1)
         return nullptr;
 
-    m_emitters[ix] = ParticleEmitter(name, ix, pos, radius, particlesPerSecond, particleLifeTimeSecs);
+    // every particle the emitter can have alive at once gets a slot in the pool up front
+    auto particlesNeeded = ParticleEmitter::ParticlesNeeded(particlesPerSecond, particleLifeTimeSecs);
+    uint16_t firstParticle = 0;
+    if (!ParticlePool::Reserve(particlesNeeded, &firstParticle)) {
+        printf("PARTICLES: No room for %d more particles for '%s', %d of %d are taken.\n", particlesNeeded, name.c_str(), ParticlePool::Reserved(), MAX_PARTICLES);
+        return nullptr;
+    }
+
+    m_emitters[ix] = ParticleEmitter(name, ix, pos, radius, particlesPerSecond, particleLifeTimeSecs, firstParticle);
     return &m_emitters[ix];
 }
 
@@ -0,0 +1,56 @@
+#include "particle_pool.hh"
+#include "defs.hh"
+
+eastl::array<psyqo::Vec3, MAX_PARTICLES> ParticlePool::m_positions;
+eastl::array<psyqo::Vec3, MAX_PARTICLES> ParticlePool::m_velocities;
+eastl::array<psyqo::Vec2, MAX_PARTICLES> ParticlePool::m_sizes;
+eastl::array<psyqo::Color, MAX_PARTICLES> ParticlePool::m_colours;
+eastl::array<uint32_t, MAX_PARTICLES> ParticlePool::m_ages;
+eastl::fixed_vector<ParticleRange, MAX_PARTICLE_EMITTERS, false> ParticlePool::m_ranges;
+
+bool ParticlePool::Reserve(const uint16_t &count, uint16_t *first) {
+    if (count == 0 || m_ranges.full())
+        return false;
+
+    // first gap thats big enough
+    uint16_t start = 0;
+    auto it = m_ranges.begin();
+    for (; it != m_ranges.end(); it++) {
+        if (it->first - start >= count)
+            break;
+
+        start = it->first + it->count;
+    }
+
+    if (it == m_ranges.end() && MAX_PARTICLES - start < count)
+        return false;
+
+    m_ranges.insert(it, {start, count});
+    *first = start;
+    return true;
+}
+
+void ParticlePool::Release(const uint16_t &first) {
+    for (auto it = m_ranges.begin(); it != m_ranges.end(); it++) {
+        if (it->first == first) {
+            m_ranges.erase(it);
+            return;
+        }
+    }
+}
+
+uint16_t ParticlePool::Reserved(void) {
+    uint16_t reserved = 0;
+    for (const auto &range : m_ranges)
+        reserved += range.count;
+
+    return reserved;
+}
+
+void ParticlePool::Move(const uint16_t &from, const uint16_t &to) {
+    m_positions[to] = m_positions[from];
+    m_velocities[to] = m_velocities[from];
+    m_sizes[to] = m_sizes[from];
+    m_colours[to] = m_colours[from];
+    m_ages[to] = m_ages[from];
+}
@@ -0,0 +1,47 @@
+#ifndef _PARTICLE_POOL_H
+#define _PARTICLE_POOL_H
+
+#include "defs.hh"
+#include "EASTL/array.h"
+#include "EASTL/fixed_vector.h"
+#include "psyqo/primitives/common.hh"
+#include "psyqo/vector.hh"
+
+typedef struct _ParticleRange {
+    uint16_t first;
+    uint16_t count;
+} ParticleRange;
+
+/*
+* every particle in the game lives in here, one array per field so processing and rendering
+* walk straight through memory. each emitter reserves a range when its created and keeps its
+* live particles packed at the start of it, so a dead one is swapped with the last live one.
+*/
+class ParticlePool final {
+public:
+    // finds room for count particles. false if the pool is too full
+    static bool Reserve(const uint16_t &count, uint16_t *first);
+    static void Release(const uint16_t &first);
+    static uint16_t Reserved(void);
+
+    // copy a particle over another one, used when removing dead particles
+    static void Move(const uint16_t &from, const uint16_t &to);
+
+    static eastl::array<psyqo::Vec3, MAX_PARTICLES> &Positions(void) { return m_positions; }
+    static eastl::array<psyqo::Vec3, MAX_PARTICLES> &Velocities(void) { return m_velocities; }
+    static eastl::array<psyqo::Vec2, MAX_PARTICLES> &Sizes(void) { return m_sizes; }
+    static eastl::array<psyqo::Color, MAX_PARTICLES> &Colours(void) { return m_colours; }
+    static eastl::array<uint32_t, MAX_PARTICLES> &Ages(void) { return m_ages; }
+
+private:
+    static eastl::array<psyqo::Vec3, MAX_PARTICLES> m_positions;
+    static eastl::array<psyqo::Vec3, MAX_PARTICLES> m_velocities;
+    static eastl::array<psyqo::Vec2, MAX_PARTICLES> m_sizes;
+    static eastl::array<psyqo::Color, MAX_PARTICLES> m_colours;
+    static eastl::array<uint32_t, MAX_PARTICLES> m_ages;
+
+    // kept in order of where they start in the pool
+    static eastl::fixed_vector<ParticleRange, MAX_PARTICLE_EMITTERS, false> m_ranges;
+};
+
+#endif
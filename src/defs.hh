@@ -3,4 +3,7 @@
 
 #define ENABLE_BONE_DEBUG 0
 
+// times UpdateSkeletonBoneMatrices on a 15 bone rig at startup and prints the results over printf
+#define ENABLE_SKELETON_BENCHMARK 0
+
 #endif
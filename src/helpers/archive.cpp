@@ -53,3 +53,19 @@ psyqo::Coroutine<psyqo::Buffer<uint8_t>> ArchiveHelper::LoadFile(const char *fil
 		co_return psyqo::Buffer<uint8_t>{};
 	}
 }
+
+uint32_t ArchiveHelper::FileSector(const char *fileName) {
+	if (!m_archiveManagerInit)
+		return NO_ARCHIVE_SECTOR;
+
+	auto *entry = m_archiveManager.getIndexEntry(fileName);
+	return entry ? entry->getSectorOffset() : NO_ARCHIVE_SECTOR;
+}
+
+uint32_t ArchiveHelper::FileSize(const char *fileName) {
+	if (!m_archiveManagerInit)
+		return 0;
+
+	auto *entry = m_archiveManager.getIndexEntry(fileName);
+	return entry ? entry->getDecompSize() : 0;
+}
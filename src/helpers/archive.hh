@@ -8,11 +8,18 @@
 #include "psyqo-paths/archive-manager.hh"
 
 constexpr uint8_t MAX_ARCHIVE_FILE_NAME_LEN = 255;
+constexpr uint32_t NO_ARCHIVE_SECTOR = 0xffffffff;
 
 class ArchiveHelper final {
 public:
     static void init(eastl::function<void()> cb);
     static psyqo::Coroutine<psyqo::Buffer<uint8_t>> LoadFile(const char* fileName);
+
+    // where a file starts in the archive, in sectors. NO_ARCHIVE_SECTOR if it isn't in there
+    static uint32_t FileSector(const char* fileName);
+
+    // how big a file is once it's read, in bytes. 0 if it isn't in the archive
+    static uint32_t FileSize(const char* fileName);
 private:
 #ifdef PCDRV
     static psyqo::CDRomPCDrv m_cdrom;
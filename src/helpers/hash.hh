@@ -0,0 +1,29 @@
+#ifndef _HASH_H
+#define _HASH_H
+
+#include <cstdint>
+
+// FNV-1a. good enough for asset names and cheap on the R3000 (one xor + one mul per char).
+// pass another hash as the seed to hash two strings as if they were joined together
+constexpr uint32_t HashString(const char *str, uint32_t hash = 2166136261u) {
+  while (*str) {
+    hash ^= static_cast<uint8_t>(*str++);
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+// same again over raw data, for things like palettes that aren't strings
+constexpr uint32_t HashBytes(const void *data, uint32_t size) {
+  auto bytes = static_cast<const uint8_t *>(data);
+  uint32_t hash = 2166136261u;
+  for (uint32_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+#endif
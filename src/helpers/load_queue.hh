@@ -4,7 +4,7 @@
 #include "EASTL/fixed_string.h"
 #include "archive.hh"
 
-enum LoadFileType { OBJECT, TEXTURE, MOD_FILE, ANIMATION, COLBIN, VAG, SCENE = 255 };
+enum LoadFileType { OBJECT, TEXTURE, MOD_FILE, ANIMATION, COLBIN, VAG, SCENE_PACK, SCENE = 255 };
 
 typedef struct _LOAD_QUEUE {
   eastl::fixed_string<char, MAX_ARCHIVE_FILE_NAME_LEN> name;
@@ -0,0 +1,85 @@
+#include "scene_arena.hh"
+
+#include "psyqo/alloc.h"
+#include "psyqo/xprintf.h"
+
+uint8_t *SceneArena::m_block = nullptr;
+uint32_t SceneArena::m_capacity = 0;
+uint32_t SceneArena::m_maxCapacity = SCENE_ARENA_SIZE;
+uint32_t SceneArena::m_used = 0;
+uint32_t SceneArena::m_highWater = 0;
+uint32_t SceneArena::m_heapFallbacks = 0;
+bool SceneArena::m_isOpen = false;
+
+void SceneArena::Open(uint32_t sizeHint) {
+  // grab the block before anything else loads so it sits low in the heap.
+  // a load that isn't dumping keeps adding to the block that's already there
+  if (m_block == nullptr) {
+    uint32_t size = sizeHint < m_maxCapacity ? sizeHint : m_maxCapacity;
+    size = (size + SCENE_ARENA_ALIGNMENT - 1) & ~(SCENE_ARENA_ALIGNMENT - 1);
+
+    if (size > 0) {
+      m_block = (uint8_t *)psyqo_malloc(size);
+      if (m_block == nullptr)
+        printf("ARENA: Failed to reserve %d bytes, using the heap instead.\n", size);
+      else
+        m_capacity = size;
+    }
+  }
+
+  m_isOpen = true;
+}
+
+void SceneArena::Close(void) { m_isOpen = false; }
+
+void SceneArena::Reset(void) {
+  printf("ARENA: Reset with %d of %d bytes used (%d spilled to the heap).\n", m_used, Capacity(), m_heapFallbacks);
+  m_used = 0;
+  m_heapFallbacks = 0;
+
+  // hand the block back, the next scene might need less of it or none at all
+  psyqo_free(m_block);
+  m_block = nullptr;
+  m_capacity = 0;
+}
+
+void *SceneArena::TryAllocate(size_t size) {
+  if (!m_isOpen || m_block == nullptr)
+    return nullptr;
+
+  uint32_t start = (m_used + SCENE_ARENA_ALIGNMENT - 1) & ~(SCENE_ARENA_ALIGNMENT - 1);
+  if (start + size > m_capacity)
+    return nullptr;
+
+  m_used = start + size;
+  if (m_used > m_highWater)
+    m_highWater = m_used;
+
+  return m_block + start;
+}
+
+void *SceneArena::Allocate(size_t size) {
+  auto *ptr = TryAllocate(size);
+  if (ptr)
+    return ptr;
+
+  if (m_isOpen && m_block) {
+    printf("ARENA: Out of space for %d bytes, falling back to the heap.\n", size);
+    m_heapFallbacks++;
+  }
+
+  return psyqo_malloc(size);
+}
+
+void SceneArena::Free(void *ptr) {
+  // arena memory only goes away on Reset
+  if (ptr == nullptr || Owns(ptr))
+    return;
+
+  psyqo_free(ptr);
+}
+
+bool SceneArena::Owns(const void *ptr) {
+  auto *p = (const uint8_t *)ptr;
+  return m_block && p >= m_block && p < m_block + m_capacity;
+}
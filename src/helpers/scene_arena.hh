@@ -0,0 +1,58 @@
+#ifndef _SCENE_ARENA_HH
+#define _SCENE_ARENA_HH
+
+#include <stddef.h>
+#include <stdint.h>
+
+// the most the arena will take from the heap, unless changed with SetMaxCapacity
+static constexpr uint32_t SCENE_ARENA_SIZE = 512 * 1024;
+static constexpr uint32_t SCENE_ARENA_ALIGNMENT = 4;
+
+/*
+ * a bump allocator for everything a scene loads.
+ * LoadingScene::LoadFiles opens it, so whatever the asset managers allocate
+ * while loading gets packed into one block instead of being scattered around
+ * the heap. a hard load resets it in one go.
+ *
+ * the block is taken from the heap when it's opened, sized for the scene being loaded,
+ * and given back on reset so the next scene can size it again.
+ *
+ * when the arena isn't open, or it's full, Allocate falls back to the heap.
+ * always give memory back with Free, it knows which is which.
+ */
+class SceneArena final {
+public:
+  // sizeHint is only used when there's no block yet. it's capped at the max capacity and 0 means use the heap
+  static void Open(uint32_t sizeHint);
+  static void Close(void);
+
+  // throws away everything in the arena and gives the block back. only safe once every manager has dumped
+  static void Reset(void);
+
+  // caps how big the block can get. takes effect the next time the block is reserved
+  static void SetMaxCapacity(uint32_t bytes) { m_maxCapacity = bytes; }
+
+  static void *Allocate(size_t size);
+  static void *TryAllocate(size_t size); // nullptr instead of falling back to the heap
+  static void Free(void *ptr);
+  static bool Owns(const void *ptr);
+
+  static bool IsOpen(void) { return m_isOpen; }
+
+  // stats
+  static uint32_t Used(void) { return m_used; }
+  static uint32_t Capacity(void) { return m_capacity; }
+  static uint32_t HighWater(void) { return m_highWater; }
+  static uint32_t HeapFallbacks(void) { return m_heapFallbacks; }
+
+private:
+  static uint8_t *m_block;
+  static uint32_t m_capacity;
+  static uint32_t m_maxCapacity;
+  static uint32_t m_used;
+  static uint32_t m_highWater;
+  static uint32_t m_heapFallbacks;
+  static bool m_isOpen;
+};
+
+#endif
@@ -5,6 +5,8 @@
 #include "psyqo/xprintf.h"
 
 #include "core/debug/debug_menu.hh"
+#include "core/debug/skeleton_benchmark.hh"
+#include "defs.hh"
 #include "helpers/cdrom.hh"
 #include "helpers/load_queue.hh"
 #include "madnight.hh"
@@ -51,6 +53,8 @@ void MadnightEngine::prepare() {
     // our application inits
     DebugMenu::Init();
 
+    SkeletonBenchmark::Run();
+
     // hook into the game code
     m_initialLoadRoutine = InitialLoad();
     m_initialLoadRoutine.resume();
@@ -75,3 +75,47 @@ void GTEMath::MultiplyMatrixVec3(const psyqo::Matrix33 &rotationMatrix, const ps
 	out->y = svOut.y;
 	out->z = svOut.z;
 }
+
+void GTEMath::MultiplyMatrix33AndVec3(const psyqo::Matrix33 &rotationMatrixA, const psyqo::Matrix33 &rotationMatrixB,
+									  const psyqo::Vec3 &posVector, psyqo::Matrix33 *outMatrix, psyqo::Vec3 *outVec) {
+	psyqo::Vec3 svOut = psyqo::Vec3::ZERO();
+
+	// matrix A stays in the rotation register for all 4 multiplies
+	psyqo::GTE::writeSafe<psyqo::GTE::PseudoRegister::Rotation>(rotationMatrixA);
+
+	// x column of B
+	psyqo::GTE::writeSafe<psyqo::GTE::PseudoRegister::V0>(
+		psyqo::Vec3{rotationMatrixB.vs[0].x, rotationMatrixB.vs[1].x, rotationMatrixB.vs[2].x});
+	psyqo::GTE::Kernels::mvmva<psyqo::GTE::Kernels::MX::RT, psyqo::GTE::Kernels::MV::V0>();
+	svOut = psyqo::GTE::readSafe<psyqo::GTE::PseudoRegister::SV>();
+	outMatrix->vs[0].x = svOut.x;
+	outMatrix->vs[1].x = svOut.y;
+	outMatrix->vs[2].x = svOut.z;
+
+	// y column
+	psyqo::GTE::writeSafe<psyqo::GTE::PseudoRegister::V0>(
+		psyqo::Vec3{rotationMatrixB.vs[0].y, rotationMatrixB.vs[1].y, rotationMatrixB.vs[2].y});
+	psyqo::GTE::Kernels::mvmva<psyqo::GTE::Kernels::MX::RT, psyqo::GTE::Kernels::MV::V0>();
+	svOut = psyqo::GTE::readSafe<psyqo::GTE::PseudoRegister::SV>();
+	outMatrix->vs[0].y = svOut.x;
+	outMatrix->vs[1].y = svOut.y;
+	outMatrix->vs[2].y = svOut.z;
+
+	// z column
+	psyqo::GTE::writeSafe<psyqo::GTE::PseudoRegister::V0>(
+		psyqo::Vec3{rotationMatrixB.vs[0].z, rotationMatrixB.vs[1].z, rotationMatrixB.vs[2].z});
+	psyqo::GTE::Kernels::mvmva<psyqo::GTE::Kernels::MX::RT, psyqo::GTE::Kernels::MV::V0>();
+	svOut = psyqo::GTE::readSafe<psyqo::GTE::PseudoRegister::SV>();
+	outMatrix->vs[0].z = svOut.x;
+	outMatrix->vs[1].z = svOut.y;
+	outMatrix->vs[2].z = svOut.z;
+
+	// then the vector
+	psyqo::GTE::writeSafe<psyqo::GTE::PseudoRegister::V0>(posVector);
+	psyqo::GTE::Kernels::rtv0();
+	svOut = psyqo::GTE::readSafe<psyqo::GTE::PseudoRegister::SV>();
+
+	outVec->x = svOut.x;
+	outVec->y = svOut.y;
+	outVec->z = svOut.z;
+}
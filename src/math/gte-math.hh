@@ -10,6 +10,10 @@ public:
   static void MultiplyMatrix33(const psyqo::Matrix33 &rotationMatrixA, const psyqo::Matrix33 rotationMatrixB,
                                psyqo::Matrix33 *out);
   static void MultiplyMatrixVec3(const psyqo::Matrix33 &rotationMatrix, const psyqo::Vec3 posVector, psyqo::Vec3 *out);
+
+  // A * B and A * v with A only written to the GTE once. used for parent * local transforms
+  static void MultiplyMatrix33AndVec3(const psyqo::Matrix33 &rotationMatrixA, const psyqo::Matrix33 &rotationMatrixB,
+                                      const psyqo::Vec3 &posVector, psyqo::Matrix33 *outMatrix, psyqo::Vec3 *outVec);
 };
 
 #endif
@@ -1,4 +1,5 @@
 #include "colbin_manager.hh"
+#include "../helpers/scene_arena.hh"
 #include "psyqo/alloc.h"
 #include "psyqo/coroutine.hh"
 #include "psyqo/xprintf.h"
@@ -11,13 +12,17 @@ psyqo::Coroutine<> ColbinManager::LoadColbin(const eastl::fixed_string<char, MAX
     *colbinOut = nullptr;
 
     auto buffer = co_await ArchiveHelper::LoadFile(name.c_str());
+    *colbinOut = ParseColbin(eastl::move(buffer));
+}
+
+ColBin *ColbinManager::ParseColbin(psyqo::Buffer<uint8_t> &&buffer) {
     void *data = buffer.data();
     size_t size = buffer.size();
 
     if (data == nullptr || size == 0) {
         buffer.clear();
         printf("COLBIN: Failed to load colbin or it has no file size.\n");
-        co_return;
+        return nullptr;
     }
 
     // prepare the struct
@@ -33,7 +38,7 @@ psyqo::Coroutine<> ColbinManager::LoadColbin(const eastl::fixed_string<char, MAX
     if (m_colbin.header.magic.compare("COLBIN") != 0) {
         printf("COLBIN: Header is invalid, aborting.\n");
         buffer.clear();
-        co_return;
+        return nullptr;
     }
 
     // version + counts
@@ -61,9 +66,20 @@ psyqo::Coroutine<> ColbinManager::LoadColbin(const eastl::fixed_string<char, MAX
     ptr += sizeof(uint16_t);
 
     // handle grid cells
+    // count the indices first so the cells and all their indices can share one allocation
     auto gridCells = m_colbin.gridHeader.gridWidth * m_colbin.gridHeader.gridHeight;
-    size_t gridCellsSize = sizeof(GridCell) * gridCells;
-    m_colbin.gridCells = (GridCell*)psyqo_malloc(gridCellsSize);
+    size_t totalIndices = 0;
+    const uint8_t *countPtr = ptr;
+    for (int i = 0; i < gridCells; i++) {
+        uint16_t count = 0;
+        __builtin_memcpy(&count, countPtr, sizeof(uint16_t));
+        countPtr += sizeof(uint16_t) * (count + 1);
+        totalIndices += count;
+    }
+
+    size_t gridCellsSize = sizeof(GridCell) * gridCells + sizeof(uint16_t) * totalIndices;
+    m_colbin.gridCells = (GridCell*)SceneArena::Allocate(gridCellsSize);
+    uint16_t *indices = (uint16_t*)(m_colbin.gridCells + gridCells);
 
     for (int i = 0; i < gridCells; i++) {
         uint16_t count = 0;
@@ -74,20 +90,17 @@ psyqo::Coroutine<> ColbinManager::LoadColbin(const eastl::fixed_string<char, MAX
         m_colbin.gridCells[i].count = count;
 
         if (count > 0) {
-            size_t gridCellIndicesSize = sizeof(uint16_t) * m_colbin.gridCells[i].count;
-            m_colbin.gridCells[i].indices = (uint16_t*)psyqo_malloc(gridCellIndicesSize);
-
-            for (int j = 0; j < count; j++) {
-                __builtin_memcpy(&m_colbin.gridCells[i].indices[j], ptr, sizeof(uint16_t));
-                ptr += sizeof(uint16_t);
-            }
+            m_colbin.gridCells[i].indices = indices;
+            __builtin_memcpy(indices, ptr, sizeof(uint16_t) * count);
+            ptr += sizeof(uint16_t) * count;
+            indices += count;
         } else
             m_colbin.gridCells[i].indices = nullptr;
     }
 
     // handle floor tris
     size_t floorTrisSize = sizeof(FloorTri) * m_colbin.header.floorTriCount;
-    m_colbin.floors = (FloorTri*)psyqo_malloc(floorTrisSize);
+    m_colbin.floors = (FloorTri*)SceneArena::Allocate(floorTrisSize);
 
     for (int i = 0; i < m_colbin.header.floorTriCount; i++) {
         // first vertex
@@ -136,7 +149,7 @@ psyqo::Coroutine<> ColbinManager::LoadColbin(const eastl::fixed_string<char, MAX
 
     // now we can move onto the OBB walls
     size_t wallOBBSize = sizeof(OBB) * m_colbin.header.wallOBBCount;
-    m_colbin.walls = (OBB*)psyqo_malloc(wallOBBSize);
+    m_colbin.walls = (OBB*)SceneArena::Allocate(wallOBBSize);
 
     for (int i = 0; i < m_colbin.header.wallOBBCount; i++) {
         // centres
@@ -178,17 +191,17 @@ psyqo::Coroutine<> ColbinManager::LoadColbin(const eastl::fixed_string<char, MAX
     }
 
     buffer.clear();
-    *colbinOut = &m_colbin;
     printf("COLBIN: Successfully loaded COLBIN of %d bytes into memory.\n", size);
+    return &m_colbin;
 }
 
 // dump the colbin in memory and start fresh
 // this is used when switching to a loading screen for instance.
 // this is a dangerous function as it wont check if anything is used
 void ColbinManager::Dump(void) {
-    psyqo_free(m_colbin.floors);
-    psyqo_free(m_colbin.walls);
-    psyqo_free(m_colbin.gridCells);
+    SceneArena::Free(m_colbin.floors);
+    SceneArena::Free(m_colbin.walls);
+    SceneArena::Free(m_colbin.gridCells); // the cell indices live in the same block
     m_colbin = {{"", 0, 0, 0,}, 0, 0, 0, 0, 0, nullptr, nullptr, nullptr};
 }
 
@@ -5,6 +5,7 @@
 #include "../core/collision_types.hh"
 #include "EASTL/fixed_string.h"
 #include "EASTL/span.h"
+#include "psyqo/buffer.hh"
 #include "psyqo/coroutine.hh"
 #include "psyqo/vector.hh"
 
@@ -46,6 +47,10 @@ struct ColBin {
 class ColbinManager {
 public:
     static psyqo::Coroutine<> LoadColbin(const eastl::fixed_string<char, MAX_ARCHIVE_FILE_NAME_LEN> &name, ColBin **colbinOut);
+
+    // the synchronous half of LoadColbin, for a file that has already been read. takes ownership of the buffer
+    static ColBin *ParseColbin(psyqo::Buffer<uint8_t> &&buffer);
+
     static ColBin *Colbin(void) { return &m_colbin; }
     static void Dump(void);
     static eastl::span<OBB> walls(void) { return {m_colbin.walls, m_colbin.header.wallOBBCount}; };
@@ -1,5 +1,7 @@
 #include "mesh_manager.hh"
 #include "../helpers/archive.hh"
+#include "../helpers/hash.hh"
+#include "../helpers/scene_arena.hh"
 #include "psyqo/fixed-point.hh"
 #include "skeleton/skeleton.hh"
 
@@ -9,155 +11,260 @@
 #include "psyqo/xprintf.h"
 
 LoadedMeshBin MeshManager::mLoadedMeshes[MAX_LOADED_MESHES];
+uint8_t MeshManager::mMeshIndex[MESH_INDEX_SIZE];
 
-psyqo::Coroutine<> MeshManager::LoadMesh(const char *meshName, MeshBin **meshOut) {
-  // make sure we get a valid response at least
-  *meshOut = nullptr;
+// magic(7) version(1) type(1) pad(3) counts(5*4) hasSkeleton(1) numBones(1) chunkCount(2) aabb(12) bsphere(16) offsets.
+// v5 has the same header, only the vertices change from int32 x3 to int16 x4. v6 adds the chunk count and offset
+static constexpr size_t MESHBIN_V4_OFFSETS_START = 64;
 
-  // is it already loaded?
-  auto *pMesh = IsMeshLoaded(meshName);
-  if (pMesh != nullptr) {
-    *meshOut = pMesh;
-    co_return;
-  }
+// the skeleton and the skinned vertex positions are both runtime state so can't live in the file.
+// allocate them together so there's still only one thing to free
+static bool AllocateSkeleton(MeshBin *mesh) {
+  auto *block = (uint8_t *)SceneArena::Allocate(sizeof(Skeleton) + sizeof(MeshBinVertex) * mesh->vertexCount);
+  if (block == nullptr)
+    return false;
 
-  // is there space for this mesh?
-  int8_t meshIx = FindSpaceForMesh();
-  if (meshIx == -1)
-    co_return;
+  mesh->skeleton = (Skeleton *)block;
+  mesh->verticesOnBonePos = (MeshBinVertex *)(block + sizeof(Skeleton));
 
-  auto buffer = co_await ArchiveHelper::LoadFile(meshName);
+  __builtin_memset(mesh->skeleton, 0, sizeof(Skeleton));
+  __builtin_memset(&mesh->skeleton->bones, 0, sizeof(SkeletonBone) * MAX_BONES);
 
-  void *data = buffer.data();
-  size_t size = buffer.size();
-  if (data == nullptr || size == 0) {
-    buffer.clear();
-    printf("MESH: Failed to load mesh or it has no file size.\n");
-    co_return;
+  // number of bones
+  mesh->skeleton->numBones = mesh->numBones > MAX_BONES ? MAX_BONES : mesh->numBones;
+  return true;
+}
+
+// older versions store positions as int32 x3. the GTE only takes the bottom 16 bits of each so narrow them on load
+static const uint8_t *ReadVertex32(const uint8_t *ptr, MeshBinVertex *vertex) {
+  int32_t pos[3];
+  __builtin_memcpy(pos, ptr, sizeof(pos));
+
+  vertex->x = int16_t(pos[0]);
+  vertex->y = int16_t(pos[1]);
+  vertex->z = int16_t(pos[2]);
+  vertex->pad = 0;
+  return ptr + sizeof(pos);
+}
+
+// parent(1) localPos(3*4) localRotation(4*2). v4 pads the parent out to 4 bytes so the rest is aligned
+static const uint8_t *ReadBone(const uint8_t *ptr, SkeletonBone *bone, bool padded) {
+  // parent bone
+  __builtin_memcpy(&bone->parent, ptr, sizeof(int8_t)); // 1 byte
+  ptr += padded ? 4 : 1;
+
+  // local pos
+  __builtin_memcpy(&bone->localPos.x.value, ptr, sizeof(int32_t)); // 4 bytes
+  ptr += sizeof(int32_t);
+
+  __builtin_memcpy(&bone->localPos.y.value, ptr, sizeof(int32_t)); // 4 bytes
+  ptr += sizeof(int32_t);
+
+  __builtin_memcpy(&bone->localPos.z.value, ptr, sizeof(int32_t)); // 4 bytes
+  ptr += sizeof(int32_t);
+
+  // local rotation
+  __builtin_memcpy(&bone->localRotation.w.value, ptr, sizeof(int16_t)); // 2 bytes
+  ptr += sizeof(int16_t);
+
+  __builtin_memcpy(&bone->localRotation.x.value, ptr, sizeof(int16_t)); // 2 bytes
+  ptr += sizeof(int16_t);
+
+  __builtin_memcpy(&bone->localRotation.y.value, ptr, sizeof(int16_t)); // 2 bytes
+  ptr += sizeof(int16_t);
+
+  __builtin_memcpy(&bone->localRotation.z.value, ptr, sizeof(int16_t)); // 2 bytes
+  ptr += sizeof(int16_t);
+
+  // mark as dirty initially
+  bone->isDirty = true;
+  return ptr;
+}
+
+// v4+ files are laid out exactly how MeshBin wants them in memory, so instead of copying anything
+// we just point the mesh at each section of the loaded file
+static bool FixupMeshV4(uint8_t *base, size_t size, uint8_t version, MeshBin *mesh) {
+  const int32_t sectionCount = version >= 6 ? SECTION_COUNT : SECTION_CHUNKS;
+  if (size < MESHBIN_V4_OFFSETS_START + sizeof(uint32_t) * sectionCount)
+    return false;
+
+  // counts
+  const uint8_t *ptr = base + 12;
+  __builtin_memcpy(&mesh->vertexCount, ptr, sizeof(uint32_t));
+  __builtin_memcpy(&mesh->indicesCount, ptr + 4, sizeof(uint32_t));
+  __builtin_memcpy(&mesh->facesCount, ptr + 8, sizeof(uint32_t));
+  __builtin_memcpy(&mesh->normalsCount, ptr + 12, sizeof(uint32_t));
+  __builtin_memcpy(&mesh->uvCount, ptr + 16, sizeof(uint32_t));
+  mesh->hasSkeleton = ptr[20];
+  mesh->numBones = ptr[21];
+  if (version >= 6)
+    __builtin_memcpy(&mesh->chunkCount, ptr + 22, sizeof(uint16_t));
+
+  // aabb. int16 to keep the header the same as older versions
+  int16_t aabb[6];
+  __builtin_memcpy(aabb, base + 36, sizeof(aabb));
+  mesh->collisionBox.min.x.value = aabb[0];
+  mesh->collisionBox.min.y.value = aabb[1];
+  mesh->collisionBox.min.z.value = aabb[2];
+  mesh->collisionBox.max.x.value = aabb[3];
+  mesh->collisionBox.max.y.value = aabb[4];
+  mesh->collisionBox.max.z.value = aabb[5];
+
+  // bounding sphere, native Vec3 + radius
+  __builtin_memcpy(&mesh->bsphere, base + 48, sizeof(BoundingSphere));
+  mesh->bsphere.radius += 6 * 128; // same leeway as older versions
+
+  uint32_t offsets[SECTION_COUNT] = {0};
+  __builtin_memcpy(offsets, base + MESHBIN_V4_OFFSETS_START, sizeof(uint32_t) * sectionCount);
+
+  // how big each section should be, to make sure the file isn't lying about its offsets
+  const uint32_t bonesSize = mesh->hasSkeleton ? 24 * mesh->numBones : 0;
+  const uint32_t boneForVertexSize = mesh->hasSkeleton ? mesh->vertexCount : 0;
+  const uint32_t vertexSize = version >= 5 ? sizeof(MeshBinVertex) : sizeof(int32_t) * 3;
+  const uint32_t sectionSizes[SECTION_COUNT] = {
+      vertexSize * mesh->vertexCount,
+      sizeof(MeshBinVertexColours) * mesh->vertexCount,
+      sizeof(MeshBinIndex) * mesh->indicesCount,
+      sizeof(psyqo::Vec3) * mesh->normalsCount,
+      sizeof(MeshBinIndex) * mesh->indicesCount,
+      sizeof(psyqo::PrimPieces::UVCoords) * mesh->uvCount,
+      sizeof(MeshBinIndex) * mesh->indicesCount,
+      bonesSize,
+      boneForVertexSize,
+      sizeof(MeshBinChunk) * mesh->chunkCount,
+  };
+
+  for (int32_t i = 0; i < sectionCount; i++) {
+    // written so it can't wrap around, an offset near 4GB would pass offset + size > fileSize
+    if ((offsets[i] & 3) != 0 || offsets[i] > size || sectionSizes[i] > size - offsets[i]) {
+      printf("MESH: Section %d is misaligned or out of bounds.\n", i);
+      return false;
+    }
   }
 
-  // basic struct setup and blanking out of the meshbin struct
-  LoadedMeshBin loaded_mesh = {"", 0};
-  loaded_mesh.meshName = meshName;
-  __builtin_memset(&loaded_mesh.mesh, 0, sizeof(MeshBin));
+  mesh->vertices = (MeshBinVertex *)(base + offsets[SECTION_VERTICES]);
 
-  // get ready with our buffer
-  unsigned char *ptr = (unsigned char *)data;
+  // v4 vertices are int32 x3, squash them down in place. each one is read before it's written
+  // and never lands past the start of the next, so this is safe going forwards
+  if (version == 4) {
+    const uint8_t *vertexPtr = base + offsets[SECTION_VERTICES];
+    for (int32_t i = 0; i < mesh->vertexCount; i++) {
+      MeshBinVertex vertex;
+      vertexPtr = ReadVertex32(vertexPtr, &vertex);
+      mesh->vertices[i] = vertex;
+    }
+  }
 
-  // meshbin header
-  // check the magic
-  eastl::fixed_string<char, 7> magic;
-  magic.assign(reinterpret_cast<char*>(ptr), 7);
-  if (magic.compare("MESHBIN")) {
-    printf("MESH: Header is invalid. aborting (%s).\n", magic.c_str());
-    buffer.clear();
-    co_return;
+  mesh->vertexColours = (MeshBinVertexColours *)(base + offsets[SECTION_VERTEX_COLOURS]);
+  mesh->vertexIndices = (MeshBinIndex *)(base + offsets[SECTION_VERTEX_INDICES]);
+  mesh->normals = (psyqo::Vec3 *)(base + offsets[SECTION_NORMALS]);
+  mesh->normalIndices = (MeshBinIndex *)(base + offsets[SECTION_NORMAL_INDICES]);
+  mesh->uvs = (psyqo::PrimPieces::UVCoords *)(base + offsets[SECTION_UVS]);
+  mesh->uvIndices = (MeshBinIndex *)(base + offsets[SECTION_UV_INDICES]);
+
+  if (mesh->chunkCount) {
+    mesh->chunks = (MeshBinChunk *)(base + offsets[SECTION_CHUNKS]);
+
+    for (int32_t i = 0; i < mesh->chunkCount; i++) {
+      const auto &chunk = mesh->chunks[i];
+      if (chunk.firstFace + chunk.faceCount > mesh->facesCount) {
+        printf("MESH: Chunk %d has faces out of range.\n", i);
+        return false;
+      }
+    }
   }
-  ptr += 7;
 
-  // version + type
-  uint8_t version;
-  __builtin_memcpy(&version, ptr, sizeof(uint8_t));    
-  ptr += sizeof(uint8_t);
+  if (mesh->hasSkeleton) {
+    mesh->boneForVertex = base + offsets[SECTION_BONE_FOR_VERTEX];
 
-  uint8_t type;
-  __builtin_memcpy(&type, ptr, sizeof(uint8_t));    
-  ptr += sizeof(uint8_t);
+    if (!AllocateSkeleton(mesh))
+      return false;
+
+    const uint8_t *bonePtr = base + offsets[SECTION_BONES];
+    for (int32_t i = 0; i < mesh->skeleton->numBones; i++) {
+      mesh->skeleton->bones[i].id = i;
+      bonePtr = ReadBone(bonePtr, &mesh->skeleton->bones[i], true);
+    }
+  }
+
+  return true;
+}
 
+// v1-v3 files are packed with no alignment, so every section has to be copied out into its own array
+static bool ReadMeshLegacy(const uint8_t *ptr, uint8_t version, MeshBin *mesh) {
   // subheader (counts basically)
-  __builtin_memcpy(&loaded_mesh.mesh.vertexCount, ptr, sizeof(uint32_t)); // 4 bytes
+  __builtin_memcpy(&mesh->vertexCount, ptr, sizeof(uint32_t)); // 4 bytes
   ptr += sizeof(uint32_t);
 
-  __builtin_memcpy(&loaded_mesh.mesh.indicesCount, ptr, sizeof(uint32_t)); // 4 bytes
+  __builtin_memcpy(&mesh->indicesCount, ptr, sizeof(uint32_t)); // 4 bytes
   ptr += sizeof(uint32_t);
 
-  __builtin_memcpy(&loaded_mesh.mesh.facesCount, ptr, sizeof(uint32_t)); // 4 bytes
+  __builtin_memcpy(&mesh->facesCount, ptr, sizeof(uint32_t)); // 4 bytes
   ptr += sizeof(uint32_t);
 
-  __builtin_memcpy(&loaded_mesh.mesh.normalsCount, ptr, sizeof(uint32_t)); // 4 bytes
+  __builtin_memcpy(&mesh->normalsCount, ptr, sizeof(uint32_t)); // 4 bytes
   ptr += sizeof(uint32_t);
 
-  __builtin_memcpy(&loaded_mesh.mesh.uvCount, ptr, sizeof(uint32_t)); // 4 bytes
+  __builtin_memcpy(&mesh->uvCount, ptr, sizeof(uint32_t)); // 4 bytes
   ptr += sizeof(uint32_t);
 
   // skeleton exists and how many bones?
   // v2 onwards has skeleton data
   if (version > 1) {
-    __builtin_memcpy(&loaded_mesh.mesh.hasSkeleton, ptr++, sizeof(uint8_t)); // 1 byte
-    __builtin_memcpy(&loaded_mesh.mesh.numBones, ptr++, sizeof(uint8_t));    // 1 byte
-  }
-
-  // do we have too many faces?
-  if (loaded_mesh.mesh.facesCount >= MAX_FACES_PER_MESH) {
-    printf("MESH: Mesh has too many faces, aborting load.\n");
-    __builtin_memset(&loaded_mesh, 0, sizeof(LoadedMeshBin));
-    buffer.clear();
-    co_return;
+    __builtin_memcpy(&mesh->hasSkeleton, ptr++, sizeof(uint8_t)); // 1 byte
+    __builtin_memcpy(&mesh->numBones, ptr++, sizeof(uint8_t));    // 1 byte
   }
 
   // read the verts
-  size_t verticesSize = sizeof(psyqo::Vec3) * loaded_mesh.mesh.vertexCount;
-  loaded_mesh.mesh.vertices = (psyqo::Vec3 *)psyqo_malloc(verticesSize);
-
-  for (int32_t i = 0; i < loaded_mesh.mesh.vertexCount; i++) {
-    __builtin_memcpy(&loaded_mesh.mesh.vertices[i].x.value, ptr, sizeof(int32_t));
-    ptr += sizeof(int32_t);
+  size_t verticesSize = sizeof(MeshBinVertex) * mesh->vertexCount;
+  mesh->vertices = (MeshBinVertex *)SceneArena::Allocate(verticesSize);
 
-    __builtin_memcpy(&loaded_mesh.mesh.vertices[i].y.value, ptr, sizeof(int32_t));
-    ptr += sizeof(int32_t);
-
-    __builtin_memcpy(&loaded_mesh.mesh.vertices[i].z.value, ptr, sizeof(int32_t));
-    ptr += sizeof(int32_t);
-  }
-
-  if (loaded_mesh.mesh.hasSkeleton) {
-    for (int32_t i = 0; i < loaded_mesh.mesh.vertexCount; i++) {
-      loaded_mesh.mesh.verticesOnBonePos[i] = loaded_mesh.mesh.vertices[i];
-    }
+  for (int32_t i = 0; i < mesh->vertexCount; i++) {
+    ptr = ReadVertex32(ptr, &mesh->vertices[i]);
   }
 
   // read the vert colours data
-  size_t verticesPaintSize = sizeof(MeshBinVertexColours) * loaded_mesh.mesh.vertexCount;
-  loaded_mesh.mesh.vertexColours = (MeshBinVertexColours *)psyqo_malloc(verticesPaintSize);
-  __builtin_memcpy(loaded_mesh.mesh.vertexColours, ptr, verticesPaintSize);
+  size_t verticesPaintSize = sizeof(MeshBinVertexColours) * mesh->vertexCount;
+  mesh->vertexColours = (MeshBinVertexColours *)SceneArena::Allocate(verticesPaintSize);
+  __builtin_memcpy(mesh->vertexColours, ptr, verticesPaintSize);
   ptr += verticesPaintSize;
 
   // read the verts indices
-  size_t vertexIndicesSize = sizeof(MeshBinIndex) * loaded_mesh.mesh.indicesCount;
-  loaded_mesh.mesh.vertexIndices = (MeshBinIndex *)psyqo_malloc(vertexIndicesSize);
-  __builtin_memcpy(loaded_mesh.mesh.vertexIndices, ptr, vertexIndicesSize);
+  size_t vertexIndicesSize = sizeof(MeshBinIndex) * mesh->indicesCount;
+  mesh->vertexIndices = (MeshBinIndex *)SceneArena::Allocate(vertexIndicesSize);
+  __builtin_memcpy(mesh->vertexIndices, ptr, vertexIndicesSize);
   ptr += vertexIndicesSize;
 
   // read the normals data
-  size_t normalsSize = sizeof(psyqo::Vec3) * loaded_mesh.mesh.normalsCount;
-  loaded_mesh.mesh.normals = (psyqo::Vec3 *)psyqo_malloc(normalsSize);
+  size_t normalsSize = sizeof(psyqo::Vec3) * mesh->normalsCount;
+  mesh->normals = (psyqo::Vec3 *)SceneArena::Allocate(normalsSize);
 
-  for (int i = 0; i < loaded_mesh.mesh.normalsCount; i++) {
-    __builtin_memcpy(&loaded_mesh.mesh.normals[i].x.value, ptr, sizeof(int16_t));
+  for (int i = 0; i < mesh->normalsCount; i++) {
+    __builtin_memcpy(&mesh->normals[i].x.value, ptr, sizeof(int16_t));
     ptr += sizeof(int16_t);
 
-    __builtin_memcpy(&loaded_mesh.mesh.normals[i].y.value, ptr, sizeof(int16_t));
+    __builtin_memcpy(&mesh->normals[i].y.value, ptr, sizeof(int16_t));
     ptr += sizeof(int16_t);
 
-    __builtin_memcpy(&loaded_mesh.mesh.normals[i].z.value, ptr, sizeof(int16_t));
+    __builtin_memcpy(&mesh->normals[i].z.value, ptr, sizeof(int16_t));
     ptr += sizeof(int16_t);
   }
 
-  size_t normalsIndicesSize = sizeof(MeshBinIndex) * loaded_mesh.mesh.indicesCount;
-  loaded_mesh.mesh.normalIndices = (MeshBinIndex *)psyqo_malloc(normalsIndicesSize);
-  __builtin_memcpy(loaded_mesh.mesh.normalIndices, ptr, normalsIndicesSize);
+  size_t normalsIndicesSize = sizeof(MeshBinIndex) * mesh->indicesCount;
+  mesh->normalIndices = (MeshBinIndex *)SceneArena::Allocate(normalsIndicesSize);
+  __builtin_memcpy(mesh->normalIndices, ptr, normalsIndicesSize);
   ptr += normalsIndicesSize;
 
   // read the uv data
-  size_t uvSize = sizeof(psyqo::PrimPieces::UVCoords) * loaded_mesh.mesh.uvCount;
-  loaded_mesh.mesh.uvs = (psyqo::PrimPieces::UVCoords *)psyqo_malloc(uvSize);
-  __builtin_memcpy(loaded_mesh.mesh.uvs, ptr, uvSize);
+  size_t uvSize = sizeof(psyqo::PrimPieces::UVCoords) * mesh->uvCount;
+  mesh->uvs = (psyqo::PrimPieces::UVCoords *)SceneArena::Allocate(uvSize);
+  __builtin_memcpy(mesh->uvs, ptr, uvSize);
   ptr += uvSize;
 
   // read the uv indices
-  size_t uvIndicesSize = sizeof(MeshBinIndex) * loaded_mesh.mesh.indicesCount;
-  loaded_mesh.mesh.uvIndices = (MeshBinIndex *)psyqo_malloc(uvIndicesSize);
-  __builtin_memcpy(loaded_mesh.mesh.uvIndices, ptr, uvIndicesSize);
+  size_t uvIndicesSize = sizeof(MeshBinIndex) * mesh->indicesCount;
+  mesh->uvIndices = (MeshBinIndex *)SceneArena::Allocate(uvIndicesSize);
+  __builtin_memcpy(mesh->uvIndices, ptr, uvIndicesSize);
   ptr += uvIndicesSize;
 
   // load aabb min data
@@ -165,157 +272,285 @@ psyqo::Coroutine<> MeshManager::LoadMesh(const char *meshName, MeshBin **meshOut
   __builtin_memcpy(&tempVal, ptr, sizeof(int16_t));
   ptr += sizeof(int16_t);
 
-  loaded_mesh.mesh.collisionBox.min.x.value = static_cast<int32_t>(tempVal);
+  mesh->collisionBox.min.x.value = static_cast<int32_t>(tempVal);
 
   __builtin_memcpy(&tempVal, ptr, sizeof(int16_t));
   ptr += sizeof(int16_t);
 
-  loaded_mesh.mesh.collisionBox.min.y.value = static_cast<int32_t>(tempVal);
+  mesh->collisionBox.min.y.value = static_cast<int32_t>(tempVal);
 
   __builtin_memcpy(&tempVal, ptr, sizeof(int16_t));
   ptr += sizeof(int16_t);
 
-  loaded_mesh.mesh.collisionBox.min.z.value = static_cast<int32_t>(tempVal);
+  mesh->collisionBox.min.z.value = static_cast<int32_t>(tempVal);
 
   // load aabb max data
   __builtin_memcpy(&tempVal, ptr, sizeof(int16_t));
   ptr += sizeof(int16_t);
 
-  loaded_mesh.mesh.collisionBox.max.x.value = static_cast<int32_t>(tempVal);
+  mesh->collisionBox.max.x.value = static_cast<int32_t>(tempVal);
 
   __builtin_memcpy(&tempVal, ptr, sizeof(int16_t));
   ptr += sizeof(int16_t);
 
-  loaded_mesh.mesh.collisionBox.max.y.value = static_cast<int32_t>(tempVal);
+  mesh->collisionBox.max.y.value = static_cast<int32_t>(tempVal);
 
   __builtin_memcpy(&tempVal, ptr, sizeof(int16_t));
   ptr += sizeof(int16_t);
 
-  loaded_mesh.mesh.collisionBox.max.z.value = static_cast<int32_t>(tempVal);
+  mesh->collisionBox.max.z.value = static_cast<int32_t>(tempVal);
 
   // load bounding sphere
   if (version >= 3) {
     tempVal = 0;
     __builtin_memcpy(&tempVal, ptr, sizeof(int16_t));
     ptr += sizeof(int16_t);
-    loaded_mesh.mesh.bsphere.centre.x.value = static_cast<int32_t>(tempVal);
+    mesh->bsphere.centre.x.value = static_cast<int32_t>(tempVal);
 
     __builtin_memcpy(&tempVal, ptr, sizeof(int16_t));
     ptr += sizeof(int16_t);
-    loaded_mesh.mesh.bsphere.centre.y.value = static_cast<int32_t>(tempVal);
+    mesh->bsphere.centre.y.value = static_cast<int32_t>(tempVal);
 
     __builtin_memcpy(&tempVal, ptr, sizeof(int16_t));
     ptr += sizeof(int16_t);
-    loaded_mesh.mesh.bsphere.centre.z.value = static_cast<int32_t>(tempVal);
+    mesh->bsphere.centre.z.value = static_cast<int32_t>(tempVal);
     
-    __builtin_memcpy(&loaded_mesh.mesh.bsphere.radius, ptr, sizeof(int32_t));
-    loaded_mesh.mesh.bsphere.radius += 6 * 128; // add a bit of leeway to the sphere
+    __builtin_memcpy(&mesh->bsphere.radius, ptr, sizeof(int32_t));
+    mesh->bsphere.radius += 6 * 128; // add a bit of leeway to the sphere
   }
 
   // if we didn't get bounding radius from the MB file, figure a rough one out
-  if (loaded_mesh.mesh.bsphere.radius == 0) {
-    loaded_mesh.mesh.bsphere.centre = (loaded_mesh.mesh.collisionBox.min + loaded_mesh.mesh.collisionBox.max) / 2;
+  if (mesh->bsphere.radius == 0) {
+    mesh->bsphere.centre = (mesh->collisionBox.min + mesh->collisionBox.max) / 2;
     
     // figure out a sphere bounding box radius
-    auto d = loaded_mesh.mesh.collisionBox.max - loaded_mesh.mesh.collisionBox.min;
+    auto d = mesh->collisionBox.max - mesh->collisionBox.min;
     int32_t sum = d.x.integer() * d.x.integer() + d.y.integer() * d.y.integer() + d.z.integer() * d.z.integer();
     
     // radius = half diagonal, >> 1 is divide by 2 in fp12
-    loaded_mesh.mesh.bsphere.radius = (psyqo::SoftMath::squareRoot(1.0_fp * sum) >> 1).integer();
+    mesh->bsphere.radius = (psyqo::SoftMath::squareRoot(1.0_fp * sum) >> 1).integer();
   }
   
   // load skeleton bones
-  if (version > 1 && loaded_mesh.mesh.hasSkeleton) {
-    loaded_mesh.mesh.skeleton = (Skeleton *)psyqo_malloc(sizeof(Skeleton));
-    loaded_mesh.mesh.verticesOnBonePos = (psyqo::Vec3 *)psyqo_malloc(sizeof(psyqo::Vec3) * loaded_mesh.mesh.vertexCount);
-
-    __builtin_memset(loaded_mesh.mesh.skeleton, 0, sizeof(Skeleton));
-    __builtin_memset(&loaded_mesh.mesh.skeleton->bones, 0, sizeof(SkeletonBone) * MAX_BONES);
-
-    // number of bones
-    loaded_mesh.mesh.skeleton->numBones = loaded_mesh.mesh.numBones;
+  if (version > 1 && mesh->hasSkeleton) {
+    if (!AllocateSkeleton(mesh))
+      return false;
 
     // individual bone data
-    for (int32_t i = 0; i < loaded_mesh.mesh.numBones; i++) {
-      loaded_mesh.mesh.skeleton->bones[i].id = i;
-
+    for (int32_t i = 0; i < mesh->numBones; i++) {
       if (i >= MAX_BONES)
         break;
 
-      // parent bone
-      __builtin_memcpy(&loaded_mesh.mesh.skeleton->bones[i].parent, ptr++, sizeof(int8_t)); // 1 byte
+      mesh->skeleton->bones[i].id = i;
+      ptr = ReadBone(ptr, &mesh->skeleton->bones[i], false);
+    }
+
+    // map a bone id to a vertex ix
+    size_t boneForVertexSize = sizeof(uint8_t) * mesh->vertexCount;
+    mesh->boneForVertex = (uint8_t *)SceneArena::Allocate(boneForVertexSize);
+    __builtin_memcpy(mesh->boneForVertex, ptr, boneForVertexSize);
+    ptr += boneForVertexSize;  
+  }
+
+  return true;
+}
+
+psyqo::Coroutine<> MeshManager::LoadMesh(const char *meshName, MeshBin **meshOut) {
+  // make sure we get a valid response at least
+  *meshOut = nullptr;
+
+  // is it already loaded?
+  auto *pMesh = IsMeshLoaded(meshName);
+  if (pMesh != nullptr) {
+    *meshOut = pMesh;
+    co_return;
+  }
+
+  // is there space for this mesh?
+  if (FindSpaceForMesh() == -1)
+    co_return;
+
+  auto buffer = co_await ArchiveHelper::LoadFile(meshName);
+  *meshOut = ParseMesh(meshName, eastl::move(buffer));
+}
+
+MeshBin *MeshManager::ParseMesh(const char *meshName, psyqo::Buffer<uint8_t> &&buffer) {
+  void *data = buffer.data();
+  size_t size = buffer.size();
+  if (data == nullptr || size == 0) {
+    buffer.clear();
+    printf("MESH: Failed to load mesh or it has no file size.\n");
+    return nullptr;
+  }
+
+  // something else could have loaded this same mesh while we waited on the read
+  auto *pMesh = IsMeshLoaded(meshName);
+  if (pMesh != nullptr) {
+    buffer.clear();
+    return pMesh;
+  }
 
-      // local pos
-      __builtin_memcpy(&loaded_mesh.mesh.skeleton->bones[i].localPos.x.value, ptr, sizeof(int32_t)); // 4 bytes
-      ptr += sizeof(int32_t);
+  // look for the slot again now, something else could have loaded while we waited on the read
+  int16_t meshIx = FindSpaceForMesh();
+  if (meshIx == -1) {
+    buffer.clear();
+    return nullptr;
+  }
 
-      __builtin_memcpy(&loaded_mesh.mesh.skeleton->bones[i].localPos.y.value, ptr, sizeof(int32_t)); // 4 bytes
-      ptr += sizeof(int32_t);
+  // basic struct setup and blanking out of the meshbin struct
+  auto &loaded_mesh = mLoadedMeshes[meshIx];
+  loaded_mesh.meshName = meshName;
+  loaded_mesh.nameHash = HashString(meshName);
+  loaded_mesh.refCount = 0;
+  __builtin_memset(&loaded_mesh.mesh, 0, sizeof(MeshBin));
+
+  // get ready with our buffer
+  unsigned char *ptr = (unsigned char *)data;
 
-      __builtin_memcpy(&loaded_mesh.mesh.skeleton->bones[i].localPos.z.value, ptr, sizeof(int32_t)); // 4 bytes
-      ptr += sizeof(int32_t);
+  // meshbin header
+  // check the magic
+  eastl::fixed_string<char, 7> magic;
+  magic.assign(reinterpret_cast<char*>(ptr), 7);
+  if (magic.compare("MESHBIN")) {
+    printf("MESH: Header is invalid. aborting (%s).\n", magic.c_str());
+    FreeMesh(&loaded_mesh);
+    buffer.clear();
+    return nullptr;
+  }
+  ptr += 7;
 
-      // local rotation
-      __builtin_memcpy(&loaded_mesh.mesh.skeleton->bones[i].localRotation.w.value, ptr, sizeof(int16_t)); // 2 bytes
-      ptr += sizeof(int16_t);
+  // version + type
+  uint8_t version;
+  __builtin_memcpy(&version, ptr, sizeof(uint8_t));    
+  ptr += sizeof(uint8_t);
 
-      __builtin_memcpy(&loaded_mesh.mesh.skeleton->bones[i].localRotation.x.value, ptr, sizeof(int16_t)); // 2 bytes
-      ptr += sizeof(int16_t);
+  uint8_t type;
+  __builtin_memcpy(&type, ptr, sizeof(uint8_t));    
+  ptr += sizeof(uint8_t);
 
-      __builtin_memcpy(&loaded_mesh.mesh.skeleton->bones[i].localRotation.y.value, ptr, sizeof(int16_t)); // 2 bytes
-      ptr += sizeof(int16_t);
+  if (version >= 4) {
+    // the mesh keeps hold of the read buffer itself. copying it into the arena would need the file twice over
+    // while loading, and the memory couldn't be given back until the next hard load
+    auto *fileData = (uint8_t *)data;
+    loaded_mesh.fileData = eastl::move(buffer);
+
+    // the mesh points straight into the file, no copying out and no extra allocations
+    if (!FixupMeshV4(fileData, size, version, &loaded_mesh.mesh)) {
+      printf("MESH: v%d mesh is invalid. aborting (%s).\n", version, meshName);
+      FreeMesh(&loaded_mesh);
+      return nullptr;
+    }
+  } else {
+    bool isRead = ReadMeshLegacy(ptr, version, &loaded_mesh.mesh);
 
-      __builtin_memcpy(&loaded_mesh.mesh.skeleton->bones[i].localRotation.z.value, ptr, sizeof(int16_t)); // 2 bytes
-      ptr += sizeof(int16_t);
+    // everything has been copied out, free the data
+    buffer.clear();
 
-      // mark as dirty initially
-      loaded_mesh.mesh.skeleton->bones[i].isDirty = true;
+    if (!isRead) {
+      printf("MESH: Out of memory for the skeleton. aborting (%s).\n", meshName);
+      FreeMesh(&loaded_mesh);
+      return nullptr;
     }
+  }
 
-    // map a bone id to a vertex ix
-    size_t boneForVertexSize = sizeof(uint8_t) * loaded_mesh.mesh.vertexCount;
-    loaded_mesh.mesh.boneForVertex = (uint8_t *)psyqo_malloc(boneForVertexSize);
-    __builtin_memcpy(loaded_mesh.mesh.boneForVertex, ptr, boneForVertexSize);
-    ptr += boneForVertexSize;  
+  // do we have too many faces? chunked meshes can be any size as long as each chunk fits
+  bool tooManyFaces = loaded_mesh.mesh.chunkCount == 0 && loaded_mesh.mesh.facesCount >= MAX_FACES_PER_CHUNK;
+  for (int32_t i = 0; i < loaded_mesh.mesh.chunkCount; i++) {
+    if (loaded_mesh.mesh.chunks[i].faceCount >= MAX_FACES_PER_CHUNK)
+      tooManyFaces = true;
+  }
+
+  if (tooManyFaces) {
+    printf("MESH: Mesh has too many faces, aborting load.\n");
+    FreeMesh(&loaded_mesh);
+    return nullptr;
+  }
+
+  // skinned verts start off at their bind pose
+  if (loaded_mesh.mesh.skeleton) {
+    for (int32_t i = 0; i < loaded_mesh.mesh.vertexCount; i++) {
+      loaded_mesh.mesh.verticesOnBonePos[i] = loaded_mesh.mesh.vertices[i];
+    }
   }
 
   // mark mesh as loaded
   loaded_mesh.isLoaded = true;
-
-  // store in loaded meshes
-  mLoadedMeshes[meshIx] = loaded_mesh;
+  IndexMesh(meshIx);
 
   // now generate the skeleton bones matrix's + bindpose etc.
-  if (loaded_mesh.mesh.hasSkeleton) SkeletonController::UpdateSkeletonBoneMatrices(mLoadedMeshes[meshIx].mesh.skeleton);
+  if (loaded_mesh.mesh.hasSkeleton) {
+    SkeletonController::SortBones(mLoadedMeshes[meshIx].mesh.skeleton);
+    SkeletonController::UpdateSkeletonBoneMatrices(mLoadedMeshes[meshIx].mesh.skeleton);
+  }
 
-  // free the data
-  buffer.clear();
+  printf("MESH: Successfully loaded mesh of %d bytes into memory.\n", size);
 
   // give back the pointer to this mesh
-  *meshOut = &mLoadedMeshes[meshIx].mesh;
-
-  printf("MESH: Successfully loaded mesh of %d bytes into memory.\n", size);
+  return &mLoadedMeshes[meshIx].mesh;
 }
 
 MeshBin *MeshManager::IsMeshLoaded(const char *meshName) {
-  using FixedString = eastl::fixed_string<char, MAX_ARCHIVE_FILE_NAME_LEN>;
-  FixedString eastl_mesh_name(meshName);
-
-  LoadedMeshBin *loadedMesh = nullptr;
-  for (int i = 0; i < MAX_LOADED_MESHES; i++) {
-    // find the first loaded mesh that matches this mesh_name
-    loadedMesh = &mLoadedMeshes[i];
-    if (loadedMesh && eastl_mesh_name == FixedString(loadedMesh->meshName)) {
-      return &loadedMesh->mesh;
-    }
+  auto meshIx = FindMesh(meshName);
+  return meshIx == -1 ? nullptr : &mLoadedMeshes[meshIx].mesh;
+}
+
+int16_t MeshManager::FindMesh(const char *meshName) {
+  auto nameHash = HashString(meshName);
+
+  uint16_t slot = nameHash & (MESH_INDEX_SIZE - 1);
+  for (uint16_t probes = 0; probes < MESH_INDEX_SIZE; probes++) {
+    // hit an empty slot, it's not loaded
+    if (mMeshIndex[slot] == 0)
+      break;
+
+    // the hash could collide so make sure the name actually matches
+    const auto &loadedMesh = mLoadedMeshes[mMeshIndex[slot] - 1];
+    if (loadedMesh.nameHash == nameHash && loadedMesh.meshName == meshName)
+      return mMeshIndex[slot] - 1;
+
+    slot = (slot + 1) & (MESH_INDEX_SIZE - 1);
   }
 
   // can't find a mesh with this file name
-  return nullptr;
+  return -1;
 }
 
-int8_t MeshManager::FindSpaceForMesh(void) {
-  for (int8_t i = 0; i < MAX_LOADED_MESHES; i++) {
+int16_t MeshManager::FindMesh(const MeshBin *mesh) {
+  if (mesh == nullptr)
+    return -1;
+
+  // meshes only ever hand out pointers into mLoadedMeshes, so the slot falls straight out of the address
+  auto offset = (const uint8_t *)mesh - (const uint8_t *)&mLoadedMeshes[0].mesh;
+  auto meshIx = offset / (int32_t)sizeof(LoadedMeshBin);
+  if (offset < 0 || meshIx >= MAX_LOADED_MESHES || &mLoadedMeshes[meshIx].mesh != mesh)
+    return -1;
+
+  return meshIx;
+}
+
+void MeshManager::IndexMesh(uint8_t meshIx) {
+  // linear probe for a free slot. the index is bigger than MAX_LOADED_MESHES so there's always one
+  uint16_t slot = mLoadedMeshes[meshIx].nameHash & (MESH_INDEX_SIZE - 1);
+  while (mMeshIndex[slot] != 0) {
+    slot = (slot + 1) & (MESH_INDEX_SIZE - 1);
+  }
+
+  mMeshIndex[slot] = meshIx + 1;
+}
+
+// same as the animation clip index, removing from open addressing breaks probe chains so rebuild it instead.
+// unloads are rare and there's only MAX_LOADED_MESHES entries
+void MeshManager::RebuildMeshIndex(void) {
+  __builtin_memset(mMeshIndex, 0, sizeof(mMeshIndex));
+
+  for (uint8_t i = 0; i < MAX_LOADED_MESHES; i++) {
+    if (mLoadedMeshes[i].isLoaded)
+      IndexMesh(i);
+  }
+}
+
+int16_t MeshManager::FindSpaceForMesh(void) {
+  for (int16_t i = 0; i < MAX_LOADED_MESHES; i++) {
     // return the first mesh that isn't loaded
     if (mLoadedMeshes[i].isLoaded == false)
       return i;
@@ -325,32 +560,88 @@ int8_t MeshManager::FindSpaceForMesh(void) {
   return -1;
 }
 
+void MeshManager::FreeMesh(LoadedMeshBin *loadedMesh) {
+  auto &mesh = loadedMesh->mesh;
+
+  // verticesOnBonePos comes with the skeleton
+  SceneArena::Free(mesh.skeleton);
+
+  if (loadedMesh->fileData.size()) {
+    // v4, everything else points into the file
+    loadedMesh->fileData.clear();
+  } else {
+    // anything in the arena is left alone by SceneArena::Free
+    SceneArena::Free(mesh.vertices);
+    SceneArena::Free(mesh.vertexColours);
+    SceneArena::Free(mesh.vertexIndices);
+    SceneArena::Free(mesh.normals);
+    SceneArena::Free(mesh.normalIndices);
+    SceneArena::Free(mesh.uvs);
+    SceneArena::Free(mesh.uvIndices);
+    SceneArena::Free(mesh.boneForVertex);
+  }
+
+  __builtin_memset(&mesh, 0, sizeof(MeshBin));
+  loadedMesh->meshName.clear();
+  loadedMesh->nameHash = 0;
+  loadedMesh->refCount = 0;
+  loadedMesh->isLoaded = false;
+}
+
 void MeshManager::UnloadMesh(const char *mesh_name) {
-  using FixedString = eastl::fixed_string<char, MAX_ARCHIVE_FILE_NAME_LEN>;
-  FixedString eastl_mesh_name(mesh_name);
-
-  LoadedMeshBin *loaded_mesh = nullptr;
-  for (int i = 0; i < MAX_LOADED_MESHES; i++) {
-    // find the first loaded mesh that matches this mesh_name
-    loaded_mesh = &mLoadedMeshes[i];
-    if (loaded_mesh && eastl_mesh_name == FixedString(loaded_mesh->meshName)) {
-      if (loaded_mesh->mesh.hasSkeleton && loaded_mesh->mesh.skeleton) {
-        psyqo_free(loaded_mesh->mesh.skeleton);
-        psyqo_free(loaded_mesh->mesh.verticesOnBonePos);
-      }
+  auto meshIx = FindMesh(mesh_name);
+  if (meshIx == -1)
+    return;
 
-      __builtin_memset(loaded_mesh, 0, sizeof(LoadedMeshBin));
-      break;
+  auto &loadedMesh = mLoadedMeshes[meshIx];
+  if (loadedMesh.refCount > 0) {
+    printf("MESH: %s is still used by %d objects, not unloading.\n", mesh_name, loadedMesh.refCount);
+    return;
+  }
+
+  FreeMesh(&loadedMesh);
+  RebuildMeshIndex();
+}
+
+void MeshManager::UnloadUnusedMeshes(void) {
+  bool unloadedAny = false;
+  for (uint8_t i = 0; i < MAX_LOADED_MESHES; i++) {
+    if (mLoadedMeshes[i].isLoaded && mLoadedMeshes[i].refCount == 0) {
+      FreeMesh(&mLoadedMeshes[i]);
+      unloadedAny = true;
     }
   }
+
+  if (unloadedAny)
+    RebuildMeshIndex();
 }
 
 void MeshManager::GetMeshFromName(const char *meshName, MeshBin **meshOut) { *meshOut = IsMeshLoaded(meshName); }
 
+MeshBin *MeshManager::AcquireMesh(const char *meshName) {
+  auto meshIx = FindMesh(meshName);
+  if (meshIx == -1)
+    return nullptr;
+
+  mLoadedMeshes[meshIx].refCount++;
+  return &mLoadedMeshes[meshIx].mesh;
+}
+
+void MeshManager::ReleaseMesh(const MeshBin *mesh) {
+  auto meshIx = FindMesh(mesh);
+  if (meshIx == -1 || mLoadedMeshes[meshIx].refCount == 0)
+    return;
+
+  // the mesh stays loaded at zero, it's only freed by an unload or the next hard load
+  mLoadedMeshes[meshIx].refCount--;
+}
+
 void MeshManager::Dump(void) {
-  // clear out every instance of loaded_mesh, putting it back to zero
+  // release every loaded mesh, putting it back to zero
   for (uint8_t i = 0; i < MAX_LOADED_MESHES; i++) {
-    __builtin_memset(&mLoadedMeshes[i].mesh, 0, sizeof(MeshBin));
-    mLoadedMeshes[i].meshName = "";
+    if (mLoadedMeshes[i].isLoaded)
+      FreeMesh(&mLoadedMeshes[i]);
   }
+
+  __builtin_memset(mMeshIndex, 0, sizeof(mMeshIndex));
 }
@@ -4,6 +4,7 @@
 #include <EASTL/fixed_string.h>
 #include <stdint.h>
 
+#include "psyqo/buffer.hh"
 #include "psyqo/coroutine.hh"
 #include "psyqo/primitives/common.hh"
 #include "psyqo/vector.hh"
@@ -13,12 +14,45 @@
 #include "skeleton/skeleton.hh"
 
 static constexpr uint8_t MAX_LOADED_MESHES = 250;
-static constexpr uint16_t MAX_FACES_PER_MESH = 1000;
+static constexpr uint16_t MAX_FACES_PER_CHUNK = 1000; // meshes without chunks count as one chunk
+
+// name hash -> slot lookup. kept at roughly double MAX_LOADED_MESHES so probe chains stay short
+static constexpr uint16_t MESH_INDEX_SIZE = 512;
 
 struct MeshBinVertexColours {
   uint8_t r, g, b; // -1 if not present. otherwise 0-255
 };
 
+// same layout as an SVECTOR, so a vertex goes into the GTE as VXY0 + VZ0 with no packing.
+// V0 is only 16 bits per component anyway, so nothing is lost storing them like this
+struct MeshBinVertex {
+  union {
+    struct {
+      int16_t x, y;
+    };
+    uint32_t xy;
+  };
+  int16_t z;
+  int16_t pad;
+
+  psyqo::Vec3 ToVec3(void) const {
+    psyqo::Vec3 out;
+    out.x.value = x;
+    out.y.value = y;
+    out.z.value = z;
+    return out;
+  }
+
+  static MeshBinVertex FromVec3(const psyqo::Vec3 &v) {
+    MeshBinVertex out;
+    out.x = int16_t(v.x.value);
+    out.y = int16_t(v.y.value);
+    out.z = int16_t(v.z.value);
+    out.pad = 0;
+    return out;
+  }
+};
+
 struct MeshBinIndex {
   int16_t i1, i2, i3, i4;
 };
@@ -28,6 +62,14 @@ struct BoundingSphere {
   int32_t radius;
 };
 
+// a spatial piece of a big mesh. its faces are contiguous so it can be culled on its own
+struct MeshBinChunk {
+  MeshBinVertex centre; // bounding sphere centre, packed so it goes straight into V0
+  int32_t radius;
+  uint16_t firstFace;
+  uint16_t faceCount;
+};
+
 struct MeshBin {
   uint8_t type;                       // 1 = quads, 2 = tris (unused)
 
@@ -42,7 +84,7 @@ struct MeshBin {
 
   // variable-length data
   // verts
-  psyqo::Vec3 *vertices;
+  MeshBinVertex *vertices;
   MeshBinVertexColours *vertexColours;
   MeshBinIndex *vertexIndices;
 
@@ -55,35 +97,76 @@ struct MeshBin {
   MeshBinIndex *uvIndices;
 
   // skeleton info
-  Skeleton* skeleton;
+  Skeleton* skeleton;             // verticesOnBonePos lives in the same allocation, straight after it
   uint8_t *boneForVertex; // vertex index -> bone index
-  psyqo::Vec3* verticesOnBonePos;
+  MeshBinVertex* verticesOnBonePos;
 
   // basic min/max collision box
   AABBCollision collisionBox;
   BoundingSphere bsphere;
+
+  // v6 onwards. 0 means the whole mesh is drawn as one
+  uint16_t chunkCount;
+  MeshBinChunk *chunks;
+};
+
+// v4+ meshbin section offsets, from the start of the file
+enum MeshBinSection : uint8_t {
+  SECTION_VERTICES,
+  SECTION_VERTEX_COLOURS,
+  SECTION_VERTEX_INDICES,
+  SECTION_NORMALS,
+  SECTION_NORMAL_INDICES,
+  SECTION_UVS,
+  SECTION_UV_INDICES,
+  SECTION_BONES,
+  SECTION_BONE_FOR_VERTEX,
+  SECTION_CHUNKS, // v6 onwards
+  SECTION_COUNT
 };
 
 struct LoadedMeshBin {
   eastl::fixed_string<char, MAX_ARCHIVE_FILE_NAME_LEN> meshName;
+  uint32_t nameHash;
+  uint16_t refCount; // game objects using this mesh
   bool isLoaded;
   MeshBin mesh;
+
+  // v4 onwards the mesh arrays point straight into the file, so we hang onto it.
+  // empty for older versions, which copy into their own arrays
+  psyqo::Buffer<uint8_t> fileData;
 };
 
 class MeshManager {
   static LoadedMeshBin mLoadedMeshes[MAX_LOADED_MESHES];
+  static uint8_t mMeshIndex[MESH_INDEX_SIZE]; // slot + 1, 0 is empty
 
   static MeshBin *IsMeshLoaded(const char *mesh_name);
-  static int8_t FindSpaceForMesh(void);
+  static int16_t FindMesh(const char *meshName);
+  static int16_t FindMesh(const MeshBin *mesh);
+  static int16_t FindSpaceForMesh(void);
+  static void FreeMesh(LoadedMeshBin *loadedMesh);
+  static void IndexMesh(uint8_t meshIx);
+  static void RebuildMeshIndex(void);
 
 public:
   static psyqo::Coroutine<> LoadMesh(const char *meshName, MeshBin **meshOut);
+
+  // the synchronous half of LoadMesh, for a file that has already been read. takes ownership of the buffer
+  static MeshBin *ParseMesh(const char *meshName, psyqo::Buffer<uint8_t> &&buffer);
   static void GetMeshFromName(const char *meshName, MeshBin **meshOut);
+
+  // same as GetMeshFromName but counts the caller as a user of the mesh until it calls ReleaseMesh
+  static MeshBin *AcquireMesh(const char *meshName);
+  static void ReleaseMesh(const MeshBin *mesh);
+
+  // these leave any mesh that's still in use alone, so parts of a scene can be swapped out safely
   static void UnloadMesh(const char *mesh_name);
+  static void UnloadUnusedMeshes(void);
 
   // dump all meshes in memory and start fresh
   // this is used when switching to a loading screen for instance.
-  // this is a dangerous function as it wont check if anything is used
+  // this is a dangerous function as it ignores ref counts, use UnloadUnusedMeshes for partial swaps
   static void Dump(void);
 };
 
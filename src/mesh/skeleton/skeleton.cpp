@@ -1,84 +1,120 @@
 #include "skeleton.hh"
+#include "../../animation/animation_manager.hh"
+#include "../../animation/pose_cache.hh"
 #include "../../math/gte-math.hh"
+#include "../../math/lerp.hh"
+#include "../../math/vector.hh"
 #include "../../math/matrix.hh"
 #include "psyqo/fixed-point.hh"
 #include "psyqo/gte-registers.hh"
 #include "psyqo/matrix.hh"
 #include "psyqo/vector.hh"
 #include "../../defs.hh"
+#include "psyqo/xprintf.h"
 
-void SkeletonController::UpdateSkeletonBoneMatrices(Skeleton *skeleton) {
+void SkeletonController::SortBones(Skeleton *skeleton) {
 	if (!skeleton)
 		return;
 
+	bool placed[MAX_BONES] = {false};
+	uint8_t numPlaced = 0;
+
 	for (int32_t i = 0; i < skeleton->numBones; i++) {
-		// for each bone in the skeleton, we need to do a recursive world matrix update
-		// but we need to know its local matrix first
-		auto *bone = &skeleton->bones[i];
-		if (!bone)
-			continue;
+		auto &bone = skeleton->bones[i];
+		skeleton->parents[i] = bone.parent;
 
-		// not got a parent and its not dirty, continue
-		if (bone->parent == -1 && !bone->isDirty)
-			continue;
+		// normalise once here rather than every time the bone is rebuilt. animated rotations come out of Slerp normalised
+		bone.localRotation.Normalize();
+	}
 
-		// parent isnt dirty, and this bone isn't dirty, continue
-		if (bone->parent != -1 && !skeleton->bones[bone->parent].isDirty && !bone->isDirty)
-			continue;
+	// keep sweeping until every bone whose parent is already placed is placed. 15 bones so n^2 is fine
+	while (numPlaced < skeleton->numBones) {
+		auto placedThisSweep = numPlaced;
 
-		// normalize quat rotation
-		auto localRot = bone->localRotation;
-		localRot.Normalize();
+		for (int32_t i = 0; i < skeleton->numBones; i++) {
+			if (placed[i])
+				continue;
 
-		// generate its rotation matrix
-		auto localRotMatrix = localRot.ToRotationMatrix();
-		auto localTrans = bone->localPos;
+			auto parent = skeleton->parents[i];
+			if (parent != -1 && !placed[parent])
+				continue;
 
-		// store local translation matrix
-		bone->localMatrix = {localRotMatrix, localTrans};
+			skeleton->evaluationOrder[numPlaced++] = i;
+			placed[i] = true;
+		}
 
-		// next we need to compute its world matrix.
-		// if we have no parent then just use the local matrix for this
-		if (bone->parent == -1)
-			bone->worldMatrix = bone->localMatrix;
-		else {
-			auto *parent = &skeleton->bones[bone->parent];
-			if (!parent)
-				continue;
+		// nothing moved, so whats left has a parent loop or a parent out of range. treat them as roots
+		if (placedThisSweep == numPlaced) {
+			for (int32_t i = 0; i < skeleton->numBones; i++) {
+				if (placed[i])
+					continue;
+
+				printf("SKELETON: Bone %d has an invalid parent %d, treating it as a root.\n", i, skeleton->parents[i]);
+				skeleton->parents[i] = -1;
+				skeleton->bones[i].parent = -1;
+				skeleton->evaluationOrder[numPlaced++] = i;
+				placed[i] = true;
+			}
+		}
+	}
+}
+
+void SkeletonController::UpdateSkeletonBoneMatrices(Skeleton *skeleton) {
+	if (!skeleton)
+		return;
 
-			// if the parent is dirty, then this one is
-			if (parent->isDirty)
-				bone->isDirty = true;
+	// single pass in parent-first order, so a parents world matrix is always final by the time its children read it
+	for (int32_t o = 0; o < skeleton->numBones; o++) {
+		auto i = skeleton->evaluationOrder[o];
+		auto &bone = skeleton->bones[i];
+		auto parentIx = skeleton->parents[i];
 
-			if (!bone->isDirty)
-				continue;
+		bool rotationChanged = bone.localRotation != bone.evaluatedRotation;
+		bool parentChanged = parentIx != -1 && skeleton->bones[parentIx].isDirty;
 
-			// rotation
-			psyqo::Matrix33 worldRot;
-			GTEMath::MultiplyMatrix33(parent->worldMatrix.rotationMatrix, bone->localMatrix.rotationMatrix, &worldRot);
+		// same rotation as last time and nothing above it moved, the matrices are still good
+		if (!bone.isDirty && !rotationChanged && !parentChanged)
+			continue;
 
-			// translation
+		// the local matrix only depends on this bone
+		if (bone.isDirty || rotationChanged) {
+			bone.localMatrix = {bone.localRotation.ToRotationMatrix(), bone.localPos};
+			bone.evaluatedRotation = bone.localRotation;
+		}
+
+		// next we need to compute its world matrix.
+		// if we have no parent then just use the local matrix for this
+		if (parentIx == -1) {
+			bone.worldMatrix = bone.localMatrix;
+		} else {
+			const auto &parent = skeleton->bones[parentIx];
+
+			// rotation + translation with the parents rotation only loaded into the GTE once
 			psyqo::Vec3 worldTrans;
-			GTEMath::MultiplyMatrixVec3(parent->worldMatrix.rotationMatrix, bone->localMatrix.translation, &worldTrans);
+			GTEMath::MultiplyMatrix33AndVec3(parent.worldMatrix.rotationMatrix, bone.localMatrix.rotationMatrix,
+			                                 bone.localMatrix.translation, &bone.worldMatrix.rotationMatrix, &worldTrans);
 
 			// final world matrix (parent + rotated local)
-			bone->worldMatrix = {worldRot, parent->worldMatrix.translation + worldTrans};
+			bone.worldMatrix.translation = parent.worldMatrix.translation + worldTrans;
 		}
 
+		// children and skinning check this
+		bone.isDirty = true;
+
 		// if we dont have a bindpose + bindpose inverse stored. then do that
-		if (!bone->hasDoneBindPose) {
+		if (!bone.hasDoneBindPose) {
 			// bind pose
-			bone->bindPose = bone->worldMatrix;
-			bone->initialLocalRotation = bone->localRotation;
+			bone.bindPose = bone.worldMatrix;
+			bone.initialLocalRotation = bone.localRotation;
 
 			// inverse of bind pose
-			auto inverseRotation = TransposeMatrix33(bone->bindPose.rotationMatrix);
+			auto inverseRotation = TransposeMatrix33(bone.bindPose.rotationMatrix);
 			psyqo::Vec3 inverseTranslation;
-			GTEMath::MultiplyMatrixVec3(inverseRotation, -bone->bindPose.translation, &inverseTranslation);
-			bone->bindPoseInverse = {inverseRotation, inverseTranslation};
+			GTEMath::MultiplyMatrixVec3(inverseRotation, -bone.bindPose.translation, &inverseTranslation);
+			bone.bindPoseInverse = {inverseRotation, inverseTranslation};
 
 			// mark it as having done this so we dont lose t-pose data
-			bone->hasDoneBindPose = true;
+			bone.hasDoneBindPose = true;
 		}
 	}
  
@@ -117,71 +153,292 @@ void SkeletonController::MarkBonesClean(Skeleton *skeleton) {
 	}
 }
 
-// right now this will just overwrite the animation. no blending
-void SkeletonController::SetAnimation(Skeleton *skeleton, Animation *animation) {
-	if (skeleton == nullptr || animation == nullptr)
+void SkeletonController::SetAnimation(Skeleton *skeleton, AnimationHandle animation, uint16_t blendFrames, bool restartIfPlaying) {
+	if (skeleton == nullptr || AnimationManager::GetAnimation(animation) == nullptr)
 		return;
 
+	// already playing this and the caller just wants it kept going
+	if (!restartIfPlaying && skeleton->animation == animation)
+		return;
+
+	// keep the old animation running so we can fade out of it
+	if (blendFrames > 0 && AnimationManager::GetAnimation(skeleton->animation) != nullptr) {
+		skeleton->previousAnimation = skeleton->animation;
+		skeleton->previousAnimationFrame = skeleton->animationCurrentFrame;
+		skeleton->blendFrames = blendFrames;
+		skeleton->blendCurrentFrame = 0;
+	} else {
+		skeleton->previousAnimation = {};
+		skeleton->blendFrames = 0;
+	}
+
 	// set the animation and reset its frame
 	skeleton->animation = animation;
 	skeleton->animationCurrentFrame = 0;
+	skeleton->hasRootTranslation = false;
 }
 
-void SkeletonController::PlayAnimation(Skeleton *skeleton, uint32_t deltaTime) {
-	if (skeleton == nullptr)
+void SkeletonController::SetAnimation(Skeleton *skeleton, Animation *animation, uint16_t blendFrames, bool restartIfPlaying) {
+	SetAnimation(skeleton, AnimationManager::HandleOf(animation), blendFrames, restartIfPlaying);
+}
+
+void SkeletonController::SetLayer(Skeleton *skeleton, uint8_t layerIx, AnimationHandle animation, uint16_t boneMask,
+                                  psyqo::FixedPoint<> weight, bool additive) {
+	if (skeleton == nullptr || layerIx >= MAX_ANIMATION_LAYERS)
 		return;
 
-	// if theres no animation then stop
-	if (skeleton->animation == nullptr)
+	auto &layer = skeleton->layers[layerIx];
+	if (!(layer.animation == animation))
+		layer.currentFrame = 0;
+
+	layer.animation = animation;
+	layer.boneMask = boneMask;
+	layer.weight = weight;
+	layer.additive = additive;
+}
+
+void SkeletonController::SetLayer(Skeleton *skeleton, uint8_t layerIx, Animation *animation, uint16_t boneMask,
+                                  psyqo::FixedPoint<> weight, bool additive) {
+	SetLayer(skeleton, layerIx, AnimationManager::HandleOf(animation), boneMask, weight, additive);
+}
+
+void SkeletonController::ClearLayer(Skeleton *skeleton, uint8_t layerIx) {
+	if (skeleton == nullptr || layerIx >= MAX_ANIMATION_LAYERS)
 		return;
 
-	const auto &animation = skeleton->animation;
-	if (skeleton->animationCurrentFrame >= animation->length) {
-		// restart if looping, otherwise set to the last frame
-		if (animation->flags & 1)
-			skeleton->animationCurrentFrame = 0;
-		else
-			skeleton->animationCurrentFrame = animation->length - 1;
+	skeleton->layers[layerIx].animation = {};
+	skeleton->layers[layerIx].currentFrame = 0;
+}
+
+// loop or clamp the frame to the animations length. true if it looped back round
+static bool WrapAnimationFrame(const Animation *animation, uint16_t &frame) {
+	if (frame < animation->length)
+		return false;
+
+	// restart if looping, otherwise set to the last frame
+	if (animation->flags & 1) {
+		frame = 0;
+		return true;
+	}
+
+	frame = animation->length - 1;
+	return false;
+}
+
+// find the two keys either side of the frame and how far between them we are
+static void FindKeys(const Track &track, uint16_t currentFrame, const Key **prevOut, const Key **nextOut,
+                     psyqo::FixedPoint<> *factorOut) {
+	// placeholder prev/next key
+	const Key *prev = &track.keys[0];
+	const Key *next = &track.keys[0];
+
+	// find the two keyframes around the current frame
+	for (int32_t j = 0; j < track.numKeys - 1; j++) {
+		if (currentFrame >= track.keys[j].frame && currentFrame < track.keys[j + 1].frame) {
+			prev = &track.keys[j];
+			next = &track.keys[j + 1];
+			break;
+		}
+	}
+
+	// if we never broke out of loop (we’re past last key)
+	if (currentFrame >= track.keys[track.numKeys - 1].frame) {
+		prev = &track.keys[track.numKeys - 1];
+		next = prev; // stay fixed on last key, no interpolation
 	}
 
-	// for each track
+	auto frameDiff = next->frame - prev->frame;
+	*factorOut = frameDiff > 0 ? inverseLerp(prev->frame, next->frame, currentFrame) : 0.0_fp;
+	*prevOut = prev;
+	*nextOut = next;
+}
+
+static void SampleTrackTranslation(const Track &track, uint16_t currentFrame, psyqo::Vec3 *translationOut) {
+	const Key *prev, *next;
+	psyqo::FixedPoint<> factor;
+	FindKeys(track, currentFrame, &prev, &next, &factor);
+
+	*translationOut = Lerp(prev->translation, next->translation, factor);
+}
+
+// evaluates every rotation track of an animation at a frame into pose, returning a mask of the bones it set.
+// goes through the pose cache so characters playing the same clip only evaluate each frame once between them
+static uint16_t SampleAnimationPose(const Animation *animation, uint16_t frame, uint8_t numBones, Quaternion *pose) {
+	if (const auto *cached = PoseCache::Find(animation, frame)) {
+		for (int32_t i = 0; i < numBones; i++) {
+			if (cached->boneMask & (1 << i))
+				pose[i] = cached->rotations[i];
+		}
+
+		return cached->boneMask & ((1 << numBones) - 1);
+	}
+
+	auto *entry = PoseCache::Insert(animation, frame);
 	for (int32_t i = 0; i < animation->numTracks; i++) {
 		const auto &track = animation->tracks[i];
+		if (track.numKeys == 0 || track.type != KeyType::ROTATION || track.jointId >= MAX_BONES)
+			continue;
 
-		// placeholder prev/next key
-		const Key *prev = &track.keys[0];
-		const Key *next = &track.keys[0];
+		const Key *prev, *next;
+		psyqo::FixedPoint<> slerpFactor;
+		FindKeys(track, frame, &prev, &next, &slerpFactor);
 
-		// find the two keyframes around the current frame
-		auto &currentFrame = skeleton->animationCurrentFrame;
-		for (int32_t j = 0; j < track.numKeys - 1; j++) {
-			if (currentFrame >= track.keys[j].frame && currentFrame < track.keys[j + 1].frame) {
-				prev = &track.keys[j];
-				next = &track.keys[j + 1];
-				break;
-			}
+		entry->rotations[track.jointId] = Slerp(prev->rotation, next->rotation, slerpFactor);
+		entry->boneMask |= 1 << track.jointId;
+	}
+
+	// bones the skeleton doesnt have are still cached, another skeleton playing this might have them
+	for (int32_t i = 0; i < numBones; i++) {
+		if (entry->boneMask & (1 << i))
+			pose[i] = entry->rotations[i];
+	}
+
+	return entry->boneMask & ((1 << numBones) - 1);
+}
+
+// moves the root motion on by however far the root track moved since last frame
+static void ExtractRootMotion(Skeleton *skeleton, const Animation *animation, bool looped) {
+	// only a root bone's translation is root motion. anything else would move the whole object
+	int16_t trackIx = animation->rootMotionTrack;
+	for (; trackIx < animation->numTracks; trackIx++) {
+		const auto &track = animation->tracks[trackIx];
+		if (track.type == KeyType::TRANSLATION && track.jointId < skeleton->numBones && skeleton->parents[track.jointId] == -1)
+			break;
+	}
+
+	if (trackIx == animation->numTracks)
+		return;
+
+	const auto &track = animation->tracks[trackIx];
+	if (track.numKeys == 0)
+		return;
+
+	psyqo::Vec3 current;
+	SampleTrackTranslation(track, skeleton->animationCurrentFrame, &current);
+
+	if (skeleton->hasRootTranslation) {
+		if (looped) {
+			// finish off the last loop, then start the new one from the first frame
+			psyqo::Vec3 loopEnd, loopStart;
+			SampleTrackTranslation(track, animation->length - 1, &loopEnd);
+			SampleTrackTranslation(track, 0, &loopStart);
+			skeleton->rootMotion += (loopEnd - skeleton->lastRootTranslation) + (current - loopStart);
+		} else {
+			skeleton->rootMotion += current - skeleton->lastRootTranslation;
+		}
+	}
+
+	skeleton->lastRootTranslation = current;
+	skeleton->hasRootTranslation = true;
+}
+
+void SkeletonController::PlayAnimation(Skeleton *skeleton, uint32_t deltaTime) {
+	if (skeleton == nullptr)
+		return;
+
+	// if theres no animation then stop. the same goes if its bank has been unloaded
+	const auto *animation = AnimationManager::GetAnimation(skeleton->animation);
+	if (animation == nullptr) {
+		skeleton->animation = {};
+		return;
+	}
+
+	auto looped = WrapAnimationFrame(animation, skeleton->animationCurrentFrame);
+
+	// start from last frames pose so bones without a track keep their rotation
+	Quaternion pose[MAX_BONES];
+	Quaternion sampled[MAX_BONES];
+	for (int32_t i = 0; i < skeleton->numBones; i++) {
+		pose[i] = skeleton->bones[i].localRotation;
+	}
+
+	// base animation
+	uint16_t touchedBones = SampleAnimationPose(animation, skeleton->animationCurrentFrame, skeleton->numBones, pose);
+
+	if (animation->rootMotionTrack != -1)
+		ExtractRootMotion(skeleton, animation, looped);
+
+	// cross-fade out of the previous animation
+	const auto *previous = AnimationManager::GetAnimation(skeleton->previousAnimation);
+	if (previous == nullptr) {
+		skeleton->previousAnimation = {};
+		skeleton->blendFrames = 0;
+	} else {
+		WrapAnimationFrame(previous, skeleton->previousAnimationFrame);
+
+		// 0 = all previous animation, 1 = all new animation
+		auto blendFactor = inverseLerp(0, skeleton->blendFrames, skeleton->blendCurrentFrame);
+
+		auto previousBones = SampleAnimationPose(previous, skeleton->previousAnimationFrame, skeleton->numBones, sampled);
+		for (int32_t i = 0; i < skeleton->numBones; i++) {
+			if (previousBones & (1 << i))
+				pose[i] = Slerp(sampled[i], pose[i], blendFactor);
+		}
+		touchedBones |= previousBones;
+
+		// finished blending, drop the old animation
+		skeleton->blendCurrentFrame += deltaTime;
+		skeleton->previousAnimationFrame += deltaTime;
+		if (skeleton->blendCurrentFrame >= skeleton->blendFrames) {
+			skeleton->previousAnimation = {};
+			skeleton->blendFrames = 0;
 		}
+	}
+
+	// layers on top, in order
+	for (int32_t l = 0; l < MAX_ANIMATION_LAYERS; l++) {
+		auto &layer = skeleton->layers[l];
+		if (!layer.animation.IsValid() || layer.weight == 0.0_fp)
+			continue;
 
-		// if we never broke out of loop (we’re past last key)
-		if (currentFrame >= track.keys[track.numKeys - 1].frame) {
-			prev = &track.keys[track.numKeys - 1];
-			next = prev; // stay fixed on last key, no interpolation
+		const auto *layerAnimation = AnimationManager::GetAnimation(layer.animation);
+		if (layerAnimation == nullptr) {
+			layer.animation = {};
+			continue;
 		}
 
-		// need to slerp
-		auto frameDiff = next->frame - prev->frame;
-		auto slerpFactor =
-		    frameDiff > 0 ? ((skeleton->animationCurrentFrame - prev->frame) / frameDiff * 1.0_fp) : 0;
+		WrapAnimationFrame(layerAnimation, layer.currentFrame);
+
+		auto layerBones = SampleAnimationPose(layerAnimation, layer.currentFrame, skeleton->numBones, sampled) &
+		                  layer.boneMask;
 
-		auto &bone = skeleton->bones[track.jointId];
-		if (next->keyType == KeyType::ROTATION) {
-			bone.localRotation = Slerp(prev->rotation, next->rotation, slerpFactor);
+		// additive layers are relative to their first frame
+		Quaternion reference[MAX_BONES];
+		if (layer.additive)
+			SampleAnimationPose(layerAnimation, 0, skeleton->numBones, reference);
+
+		for (int32_t i = 0; i < skeleton->numBones; i++) {
+			if (!(layerBones & (1 << i)))
+				continue;
+
+			if (layer.additive) {
+				// rotation relative to the layers first frame, applied on top of whatever is underneath
+				auto delta = sampled[i] * -reference[i];
+				pose[i] = Slerp(Quaternion{}, delta, layer.weight) * pose[i];
+			} else {
+				pose[i] = Slerp(pose[i], sampled[i], layer.weight);
+			}
 		}
-		// TODO: translation
+		touchedBones |= layerBones;
 
-		bone.isDirty = true;
+		layer.currentFrame += deltaTime;
+	}
+
+	// write the pose back. UpdateSkeletonBoneMatrices works out which of these actually changed
+	for (int32_t i = 0; i < skeleton->numBones; i++) {
+		if (touchedBones & (1 << i))
+			skeleton->bones[i].localRotation = pose[i];
 	}
 
 	// increase what animation frame we're on
 	skeleton->animationCurrentFrame += deltaTime;
 }
+
+psyqo::Vec3 SkeletonController::ConsumeRootMotion(Skeleton *skeleton) {
+	if (skeleton == nullptr)
+		return {0, 0, 0};
+
+	auto rootMotion = skeleton->rootMotion;
+	skeleton->rootMotion = {0, 0, 0};
+	return rootMotion;
+}
@@ -7,6 +7,10 @@
 #include "psyqo/vector.hh"
 
 static constexpr uint8_t MAX_BONES = 15;
+static constexpr uint8_t MAX_ANIMATION_LAYERS = 2;
+
+// every bone. used as the default mask for layers
+static constexpr uint16_t ALL_BONES_MASK = (1 << MAX_BONES) - 1;
 
 struct SkeletonBoneMatrix {
   psyqo::Matrix33 rotationMatrix = {{{0, 0, 0}, {0, 0, 0}, {0, 0, 0}}};
@@ -19,29 +23,72 @@ struct SkeletonBone {
   psyqo::Vec3 localPos = {0, 0, 0};        // relative to parent
   Quaternion localRotation = {0, 0, 0, 0}; // relative to parent
   Quaternion initialLocalRotation = {0, 0, 0, 0};
+  Quaternion evaluatedRotation = {0, 0, 0, 0}; // the localRotation the matrices below were last built from
   SkeletonBoneMatrix localMatrix;     // computed itself. to generate this see `GameObject::GenerateRotationMatrix`
   SkeletonBoneMatrix worldMatrix;     // computed from parent. to generate this see `GameObject::GenerateRotationMatrix`
   SkeletonBoneMatrix bindPose;        // initial pose when the skeleton is loaded in
   SkeletonBoneMatrix bindPoseInverse; // inverse bind pose matrix
-  bool isDirty = true;                // set by the animation to determine if we need to regenrate the above
+  bool isDirty = true;                // forces a rebuild. UpdateSkeletonBoneMatrices sets it on every bone it rebuilt
   bool hasDoneBindPose = false;
   psyqo::Vec3 startPos = {0,0,0};
   psyqo::Vec3 endPos = {0,0,0};
 };
 
+// an animation played on top of the base animation for a subset of bones. e.g. upper body aiming over a walk
+struct AnimationLayer {
+  AnimationHandle animation;
+  uint16_t currentFrame = 0;
+  uint16_t boneMask = ALL_BONES_MASK; // bit per bone id. only these bones are touched by the layer
+  psyqo::FixedPoint<> weight = 1.0_fp;
+  bool additive = false; // additive layers apply their rotation relative to their first frame
+};
+
 struct Skeleton {
   uint8_t numBones;
   SkeletonBone bones[MAX_BONES];
-  Animation *animation;
+
+  // built once at load by SortBones. bones are walked in this order so parents are always done first
+  int8_t parents[MAX_BONES];
+  uint8_t evaluationOrder[MAX_BONES];
+
+  // handles rather than pointers, so a clip whose bank gets unloaded just stops instead of being read after it's freed
+  AnimationHandle animation;
   uint16_t animationCurrentFrame = 0;
+
+  // cross-fade from the previous animation into `animation` over `blendFrames` frames
+  AnimationHandle previousAnimation;
+  uint16_t previousAnimationFrame = 0;
+  uint16_t blendFrames = 0;
+  uint16_t blendCurrentFrame = 0;
+
+  AnimationLayer layers[MAX_ANIMATION_LAYERS];
+
+  // root motion accumulated since the last ConsumeRootMotion, in model space
+  psyqo::Vec3 rootMotion = {0, 0, 0};
+  psyqo::Vec3 lastRootTranslation = {0, 0, 0};
+  bool hasRootTranslation = false; // false until the first frame of an animation has been sampled
 };
 
 class SkeletonController {
 public:
+  // must be called once after the bones are loaded, before anything else
+  static void SortBones(Skeleton *skeleton);
   static void UpdateSkeletonBoneMatrices(Skeleton *skeleton);
   static void MarkBonesClean(Skeleton *skeleton);
-  static void SetAnimation(Skeleton *skeleton, Animation *animation);
+  // blendFrames = 0 hard cuts to the new animation, otherwise the old one is faded out over that many frames.
+  // setting the animation that's already playing starts it again from frame 0 unless restartIfPlaying is false
+  static void SetAnimation(Skeleton *skeleton, AnimationHandle animation, uint16_t blendFrames = 0, bool restartIfPlaying = true);
+  static void SetAnimation(Skeleton *skeleton, Animation *animation, uint16_t blendFrames = 0, bool restartIfPlaying = true);
+  static void SetLayer(Skeleton *skeleton, uint8_t layerIx, AnimationHandle animation, uint16_t boneMask = ALL_BONES_MASK,
+                       psyqo::FixedPoint<> weight = 1.0_fp, bool additive = false);
+  static void SetLayer(Skeleton *skeleton, uint8_t layerIx, Animation *animation, uint16_t boneMask = ALL_BONES_MASK,
+                       psyqo::FixedPoint<> weight = 1.0_fp, bool additive = false);
+  static void ClearLayer(Skeleton *skeleton, uint8_t layerIx);
+  // anything whose bank has been unloaded since it was set is dropped here
   static void PlayAnimation(Skeleton *skeleton, uint32_t deltaTime);
+
+  // returns how far the root moved since the last call and resets it. add this to the game objects position
+  static psyqo::Vec3 ConsumeRootMotion(Skeleton *skeleton);
 };
 
 #endif
@@ -7,10 +7,13 @@
 #include "../core/object/gameobject_manager.hh"
 #include "../core/billboard/billboard_manager.hh"
 #include "../core/particles/particle_manager.hh"
+#include "../core/particles/particle_pool.hh"
 #include "../core/debug/perf_monitor.hh"
 #include "../math/gte-math.hh"
+#include "../textures/vram_allocator.hh"
 #include "../defs.hh"
 
+#include "psyqo/alloc.h"
 #include "psyqo/fixed-point.hh"
 #include "psyqo/fragment-concept.hh"
 #include "psyqo/fragments.hh"
@@ -24,9 +27,10 @@
 #include "psyqo/primitives/sprites.hh"
 #include "psyqo/primitives/triangles.hh"
 #include "psyqo/vector.hh"
+#include "psyqo/xprintf.h"
 
 Renderer *Renderer::m_instance = nullptr;
-psyqo::Font<100> Renderer::m_systemFont;
+HUDFont Renderer::m_systemFont;
 static constexpr psyqo::Rect SCREEN_SPACE = {.pos = {0, 0}, .size = {320, 240}};
 static constexpr psyqo::Matrix33 identityMatrix = {
     {{1.0_fp, 0.0_fp, 0.0_fp}, {0.0_fp, 1.0_fp, 0.0_fp}, {0.0_fp, 0.0_fp, 1.0_fp}}};
@@ -89,12 +93,25 @@ static constexpr psyqo::Color boneColours[MAX_BONES] = {
 };
 #endif
 
+// mesh verts are already packed like an SVECTOR so they go straight into V0 without the shifting and masking
+// writeSafe<V0> does for a Vec3
+static inline void WriteVertexToV0(const MeshBinVertex &vertex) {
+  psyqo::GTE::write<psyqo::GTE::Register::VXY0, psyqo::GTE::Unsafe>(vertex.xy);
+  psyqo::GTE::write<psyqo::GTE::Register::VZ0, psyqo::GTE::Safe>(uint16_t(vertex.z));
+}
+
 void Renderer::Init(psyqo::GPU &gpuInstance) {
   if (m_instance != nullptr)
     return;
 
   m_instance = new Renderer(gpuInstance);
-  m_systemFont.uploadSystemFont(m_instance->GPU(), {960, 256});
+  m_systemFont.uploadSystemFont(m_instance->GPU(), SYSTEM_FONT_VRAM_POS);
+  ReserveSystemFontVRam();
+}
+
+void Renderer::ReserveSystemFontVRam(void) {
+  VRamAllocator::ReserveTexture(psyqo::Prim::TPageAttr::ColorMode::Tex4Bits, SYSTEM_FONT_VRAM_POS.x, SYSTEM_FONT_VRAM_POS.y,
+                                SYSTEM_FONT_VRAM_WIDTH, SYSTEM_FONT_VRAM_HEIGHT);
 }
 
 void Renderer::VRamUpload(const uint16_t *data, int16_t x, int16_t y, int16_t width, int16_t height) {
@@ -167,8 +184,9 @@ uint32_t Renderer::Process(void) {
   // update last frame count
   m_lastFrameCounter = currentFrameCount;
 
-  // reset what sprite/tpage we're drawing
-  m_currentSpriteFragment = 0;
+  // everything this frame is allocated from here, including sprites drawn before Render or without it
+  m_allocators[m_gpu.getParity()].reset();
+  m_pendingSpriteCount = 0;
 
   // give back the delta time
   return deltaTime;
@@ -217,10 +235,6 @@ void Renderer::Render(uint32_t deltaTime) {
   // get the frame buffer we're currently rendering
   int frameBuffer = m_gpu.getParity();
 
-  // get the current allocator so we can reset it
-  auto &allocator = m_allocators[frameBuffer];
-  allocator.reset();
-  
   // chain the fill command to clear the buffer
   auto &clear = m_clear[frameBuffer];
   m_gpu.getNextClear(clear.primitive, m_lighting->m_fogColour);
@@ -269,6 +283,10 @@ void Renderer::RenderGameObjects(uint32_t deltaTime, const psyqo::Matrix33 &came
   if (gameObjects.empty())
     return;
 
+  // texture groups only mean anything within a frame
+  m_textureGroupCount = 0;
+  m_tpageChanges = 0;
+
   // now for each object...
   int renderedObjects = 0;
   for (const auto &gameObject : gameObjects) {
@@ -315,8 +333,8 @@ void Renderer::RenderGameObjects(uint32_t deltaTime, const psyqo::Matrix33 &came
 
         // final position
         psyqo::Vec3 rotatedVert;
-        GTEMath::MultiplyMatrixVec3(rotationOffset, mesh->vertices[i], &rotatedVert);
-        mesh->verticesOnBonePos[i] = rotatedVert + translationOffset;
+        GTEMath::MultiplyMatrixVec3(rotationOffset, mesh->vertices[i].ToVec3(), &rotatedVert);
+        mesh->verticesOnBonePos[i] = MeshBinVertex::FromVec3(rotatedVert + translationOffset);
       }
 
       // mark all bones as clean
@@ -326,170 +344,193 @@ void Renderer::RenderGameObjects(uint32_t deltaTime, const psyqo::Matrix33 &came
     // now we've done all this we can render the mesh and apply texture (if needed)
     // we dont need to get texture data for every single vert since it wont change, so lets only do that once
     // if its not a nullptr fill out some data so we don't have to do it every face
-    const auto texture = gameObject->texture();
+    // far away objects use a smaller version of their texture if there is one, so the gpu has less to fetch
+    uint8_t lodShift;
+    const auto texture = TextureManager::DrawableLod(gameObject->texture(), GetLodLevel(deltaCentre.z.raw()), &lodShift);
     if (texture) {
       // get the tpage and uv offset info
       tpage = TextureManager::GetTPageAttr(texture);
       offset = TextureManager::GetTPageUVForTim(texture);
       offset.pos.y += (texture->height - 1);
     }
+    m_currentGroup = TextureGroup(texture);
 
     auto applyUV = [&](auto& uvDest, int index) {
       auto uv = mesh->uvs[index];
-      uvDest.u = offset.pos.x + uv.u;
-      uvDest.v = offset.pos.y - uv.v;
+      uvDest.u = offset.pos.x + (uv.u >> lodShift);
+      uvDest.v = offset.pos.y - (uv.v >> lodShift);
     };
 
     auto renderVerts = mesh->hasSkeleton ? mesh->verticesOnBonePos : mesh->vertices;
-    for (int32_t i = 0; i < mesh->facesCount; i++) {
-        auto isQuad = mesh->vertexIndices[i].i2 != -1;
 
-        uint32_t pA, pB, pC, pD;
+    // big meshes are split into chunks that get culled on their own. anything else is one chunk of every face
+    const MeshBinChunk wholeMesh = {{}, 0, 0, uint16_t(mesh->facesCount)};
+    const auto *chunks = mesh->chunkCount ? mesh->chunks : &wholeMesh;
+    const uint16_t chunkCount = mesh->chunkCount ? mesh->chunkCount : 1;
+
+    for (uint16_t c = 0; c < chunkCount; c++) {
+      const auto &chunk = chunks[c];
+
+      // the gte already has this object's transform, so rt puts the chunk centre straight into view space.
+      // skinned meshes move about so their chunk spheres can't be trusted
+      if (chunkCount > 1 && !mesh->hasSkeleton) {
+        WriteVertexToV0(chunk.centre);
+        psyqo::GTE::Kernels::rt();
+        auto chunkCentre = psyqo::GTE::readSafe<psyqo::GTE::PseudoRegister::SV>();
+        if (!IsGameObjectVisible(chunkCentre, mesh->collisionBox, chunk.radius))
+          continue;
+      }
 
-        // vert 1
-        psyqo::GTE::writeSafe<psyqo::GTE::PseudoRegister::V0>(renderVerts[mesh->vertexIndices[i].i1]);
-        psyqo::GTE::Kernels::rtps();
-        pA = psyqo::GTE::readRaw<psyqo::GTE::Register::IR0>();
+      for (int32_t i = chunk.firstFace; i < chunk.firstFace + chunk.faceCount; i++) {
+          auto isQuad = mesh->vertexIndices[i].i2 != -1;
 
-        // vert 2
-        psyqo::GTE::writeSafe<psyqo::GTE::PseudoRegister::V0>(isQuad ? renderVerts[mesh->vertexIndices[i].i2] : renderVerts[mesh->vertexIndices[i].i3]);
-        psyqo::GTE::Kernels::rtps();
-        pB = psyqo::GTE::readRaw<psyqo::GTE::Register::IR0>();
+          uint32_t pA, pB, pC, pD;
 
-        // vert 3
-        psyqo::GTE::writeSafe<psyqo::GTE::PseudoRegister::V0>(isQuad ? renderVerts[mesh->vertexIndices[i].i3] : renderVerts[mesh->vertexIndices[i].i4]);
-        psyqo::GTE::Kernels::rtps();
-        pC = psyqo::GTE::readRaw<psyqo::GTE::Register::IR0>();
+          // vert 1
+          WriteVertexToV0(renderVerts[mesh->vertexIndices[i].i1]);
+          psyqo::GTE::Kernels::rtps();
+          pA = psyqo::GTE::readRaw<psyqo::GTE::Register::IR0>();
 
-        // nclip determines the winding order of the vertices. if they are clockwise then it is facing towards us
-        psyqo::GTE::Kernels::nclip();
+          // vert 2
+          WriteVertexToV0(isQuad ? renderVerts[mesh->vertexIndices[i].i2] : renderVerts[mesh->vertexIndices[i].i3]);
+          psyqo::GTE::Kernels::rtps();
+          pB = psyqo::GTE::readRaw<psyqo::GTE::Register::IR0>();
 
-        // read the result of this and skip rendering if its backfaced
-        if (psyqo::GTE::readRaw<psyqo::GTE::Register::MAC0>() == 0)
-            continue;
+          // vert 3
+          WriteVertexToV0(isQuad ? renderVerts[mesh->vertexIndices[i].i3] : renderVerts[mesh->vertexIndices[i].i4]);
+          psyqo::GTE::Kernels::rtps();
+          pC = psyqo::GTE::readRaw<psyqo::GTE::Register::IR0>();
 
-        // read projected verts from SXY0/1/2
-        psyqo::GTE::read<psyqo::GTE::Register::SXY0>(&projected[0].packed);
-        psyqo::GTE::read<psyqo::GTE::Register::SXY1>(&projected[1].packed);
-        psyqo::GTE::read<psyqo::GTE::Register::SXY2>(&projected[2].packed);
-
-        if (isQuad) {
-            // vert 4
-            psyqo::GTE::writeSafe<psyqo::GTE::PseudoRegister::V0>(renderVerts[mesh->vertexIndices[i].i4]);
-            psyqo::GTE::Kernels::rtps();
-            pD = psyqo::GTE::readRaw<psyqo::GTE::Register::IR0>();
-            psyqo::GTE::read<psyqo::GTE::Register::SXY2>(&projected[3].packed);
-
-            // average z index for ordering
-            psyqo::GTE::Kernels::avsz4();
-        } else {
-            // average z index for ordering
-            psyqo::GTE::Kernels::avsz3();
-        }
+          // nclip determines the winding order of the vertices. if they are clockwise then it is facing towards us
+          psyqo::GTE::Kernels::nclip();
 
-        // make sure we dont go out of bounds
-        zIndex = psyqo::GTE::readRaw<psyqo::GTE::Register::OTZ>();
-        if (zIndex == 0 || zIndex >= ORDERING_TABLE_SIZE)
-            continue;
-
-        // if its out of the screen space we can clip too
-        if ((isQuad && quad_clip(&SCREEN_SPACE, &projected[0], &projected[1], &projected[2], &projected[3])) || (!isQuad && tri_clip(&SCREEN_SPACE, &projected[0], &projected[1], &projected[2])))
-            continue;
-
-        // now apply colours using stored IR0 values
-        psyqo::Color colA = {mesh->vertexColours[mesh->vertexIndices[i].i1].r, mesh->vertexColours[mesh->vertexIndices[i].i1].g, mesh->vertexColours[mesh->vertexIndices[i].i1].b};
-        psyqo::Color colB, colC;
-        if (isQuad) {
-            colB = {mesh->vertexColours[mesh->vertexIndices[i].i2].r, mesh->vertexColours[mesh->vertexIndices[i].i2].g, mesh->vertexColours[mesh->vertexIndices[i].i2].b};
-            colC = {mesh->vertexColours[mesh->vertexIndices[i].i3].r, mesh->vertexColours[mesh->vertexIndices[i].i3].g, mesh->vertexColours[mesh->vertexIndices[i].i3].b};
-        } else {
-            colB = {mesh->vertexColours[mesh->vertexIndices[i].i3].r, mesh->vertexColours[mesh->vertexIndices[i].i3].g, mesh->vertexColours[mesh->vertexIndices[i].i3].b};
-            colC = {mesh->vertexColours[mesh->vertexIndices[i].i4].r, mesh->vertexColours[mesh->vertexIndices[i].i4].g, mesh->vertexColours[mesh->vertexIndices[i].i4].b};
-        }
+          // read the result of this and skip rendering if its backfaced
+          if (psyqo::GTE::readRaw<psyqo::GTE::Register::MAC0>() == 0)
+              continue;
 
-        ApplyAmbientToColour(&colA);
-        colA = ApplyFogToColourGTE(colA, pA);
-        ApplyAmbientToColour(&colB);
-        colB = ApplyFogToColourGTE(colB, pB);
-        ApplyAmbientToColour(&colC);
-        colC = ApplyFogToColourGTE(colC, pC);
-
-        if (isQuad) {
-            psyqo::Color colD = {mesh->vertexColours[mesh->vertexIndices[i].i4].r, mesh->vertexColours[mesh->vertexIndices[i].i4].g, mesh->vertexColours[mesh->vertexIndices[i].i4].b};
-            ApplyAmbientToColour(&colD);
-            colD = ApplyFogToColourGTE(colD, pD);
-
-            // now take a quad fragment from our array and:
-            // set its vertices
-            auto &quad = allocator.allocateFragment<psyqo::Prim::GouraudTexturedQuad>();
-            quad.primitive.pointA = projected[0];
-            quad.primitive.pointB = projected[1];
-            quad.primitive.pointC = projected[2];
-            quad.primitive.pointD = projected[3];
-
-            // set its colour, and make it opaque
-            quad.primitive.setColorA(colA);
-            quad.primitive.setColorB(colB);
-            quad.primitive.setColorC(colC);
-            quad.primitive.setColorD(colD);
-            quad.primitive.setOpaque();
-
-            // do we have a texture for this?
-            if (texture) {
-                // set its tpage
-                quad.primitive.tpage = tpage;
-
-                // set its clut if it has one
-                if (texture->hasClut)
-                    quad.primitive.clutIndex = {texture->clutX, texture->clutY};
-
-                // set its uv coords
-                applyUV(quad.primitive.uvA, mesh->uvIndices[i].i1);
-                applyUV(quad.primitive.uvB, mesh->uvIndices[i].i2);
-                applyUV(quad.primitive.uvC, mesh->uvIndices[i].i3);
-                applyUV(quad.primitive.uvD, mesh->uvIndices[i].i4);
-            }
-
-            // finally we can insert the quad fragment into the ordering table at the calculated z-index
-            if (zIndex <= SUBDIVISION_DISTANCE)
-                SubdivideTexturedQuad(&quad, zIndex, &ot, 2);
-            else
-                ot.insert(quad, zIndex);
-        } else {
-            // now take a tri fragment from our array and:
-            // set its vertices
-            auto &tri = allocator.allocateFragment<psyqo::Prim::GouraudTexturedTriangle>();
-            tri.primitive.pointA = projected[0];
-            tri.primitive.pointB = projected[1];
-            tri.primitive.pointC = projected[2];
-
-            // set its colour, and make it opaque
-            tri.primitive.setColorA(colA);
-            tri.primitive.setColorB(colB);
-            tri.primitive.setColorC(colC);
-            tri.primitive.setOpaque();
-
-            // do we have a texture for this?
-            if (texture) {
-                // set its tpage
-                tri.primitive.tpage = tpage;
-
-                // set its clut if it has one
-                if (texture->hasClut)
-                    tri.primitive.clutIndex = {texture->clutX, texture->clutY};
-
-                // set its uv coords
-                applyUV(tri.primitive.uvA, mesh->uvIndices[i].i3);
-                applyUV(tri.primitive.uvB, mesh->uvIndices[i].i1);
-                applyUV(tri.primitive.uvC, mesh->uvIndices[i].i4);
-            }
-
-            // finally we can insert the tri fragment into the ordering table at the calculated z-index
-            if (zIndex <= SUBDIVISION_DISTANCE)
-                SubdivideTexturedTri(&tri, zIndex, &ot, 2);
-            else
-                ot.insert(tri, zIndex);
-        }
+          // read projected verts from SXY0/1/2
+          psyqo::GTE::read<psyqo::GTE::Register::SXY0>(&projected[0].packed);
+          psyqo::GTE::read<psyqo::GTE::Register::SXY1>(&projected[1].packed);
+          psyqo::GTE::read<psyqo::GTE::Register::SXY2>(&projected[2].packed);
+
+          if (isQuad) {
+              // vert 4
+              WriteVertexToV0(renderVerts[mesh->vertexIndices[i].i4]);
+              psyqo::GTE::Kernels::rtps();
+              pD = psyqo::GTE::readRaw<psyqo::GTE::Register::IR0>();
+              psyqo::GTE::read<psyqo::GTE::Register::SXY2>(&projected[3].packed);
+
+              // average z index for ordering
+              psyqo::GTE::Kernels::avsz4();
+          } else {
+              // average z index for ordering
+              psyqo::GTE::Kernels::avsz3();
+          }
+
+          // make sure we dont go out of bounds
+          zIndex = psyqo::GTE::readRaw<psyqo::GTE::Register::OTZ>();
+          if (zIndex == 0 || zIndex >= ORDERING_TABLE_SIZE)
+              continue;
+
+          // if its out of the screen space we can clip too
+          if ((isQuad && quad_clip(&SCREEN_SPACE, &projected[0], &projected[1], &projected[2], &projected[3])) || (!isQuad && tri_clip(&SCREEN_SPACE, &projected[0], &projected[1], &projected[2])))
+              continue;
+
+          // now apply colours using stored IR0 values
+          psyqo::Color colA = {mesh->vertexColours[mesh->vertexIndices[i].i1].r, mesh->vertexColours[mesh->vertexIndices[i].i1].g, mesh->vertexColours[mesh->vertexIndices[i].i1].b};
+          psyqo::Color colB, colC;
+          if (isQuad) {
+              colB = {mesh->vertexColours[mesh->vertexIndices[i].i2].r, mesh->vertexColours[mesh->vertexIndices[i].i2].g, mesh->vertexColours[mesh->vertexIndices[i].i2].b};
+              colC = {mesh->vertexColours[mesh->vertexIndices[i].i3].r, mesh->vertexColours[mesh->vertexIndices[i].i3].g, mesh->vertexColours[mesh->vertexIndices[i].i3].b};
+          } else {
+              colB = {mesh->vertexColours[mesh->vertexIndices[i].i3].r, mesh->vertexColours[mesh->vertexIndices[i].i3].g, mesh->vertexColours[mesh->vertexIndices[i].i3].b};
+              colC = {mesh->vertexColours[mesh->vertexIndices[i].i4].r, mesh->vertexColours[mesh->vertexIndices[i].i4].g, mesh->vertexColours[mesh->vertexIndices[i].i4].b};
+          }
+
+          ApplyAmbientToColour(&colA);
+          colA = ApplyFogToColourGTE(colA, pA);
+          ApplyAmbientToColour(&colB);
+          colB = ApplyFogToColourGTE(colB, pB);
+          ApplyAmbientToColour(&colC);
+          colC = ApplyFogToColourGTE(colC, pC);
+
+          if (isQuad) {
+              psyqo::Color colD = {mesh->vertexColours[mesh->vertexIndices[i].i4].r, mesh->vertexColours[mesh->vertexIndices[i].i4].g, mesh->vertexColours[mesh->vertexIndices[i].i4].b};
+              ApplyAmbientToColour(&colD);
+              colD = ApplyFogToColourGTE(colD, pD);
+
+              // now take a quad fragment from our array and:
+              // set its vertices
+              auto &quad = allocator.allocateFragment<psyqo::Prim::GouraudTexturedQuad>();
+              quad.primitive.pointA = projected[0];
+              quad.primitive.pointB = projected[1];
+              quad.primitive.pointC = projected[2];
+              quad.primitive.pointD = projected[3];
+
+              // set its colour, and make it opaque
+              quad.primitive.setColorA(colA);
+              quad.primitive.setColorB(colB);
+              quad.primitive.setColorC(colC);
+              quad.primitive.setColorD(colD);
+              quad.primitive.setOpaque();
+
+              // do we have a texture for this?
+              if (texture) {
+                  // set its tpage
+                  quad.primitive.tpage = tpage;
+
+                  // set its clut if it has one
+                  if (texture->hasClut)
+                      quad.primitive.clutIndex = {texture->clutX, texture->clutY};
+
+                  // set its uv coords
+                  applyUV(quad.primitive.uvA, mesh->uvIndices[i].i1);
+                  applyUV(quad.primitive.uvB, mesh->uvIndices[i].i2);
+                  applyUV(quad.primitive.uvC, mesh->uvIndices[i].i3);
+                  applyUV(quad.primitive.uvD, mesh->uvIndices[i].i4);
+              }
+
+              // finally we can insert the quad fragment into the ordering table at the calculated z-index
+              if (zIndex <= SUBDIVISION_DISTANCE)
+                  SubdivideTexturedQuad(&quad, zIndex, &ot, 2);
+              else
+                  InsertFace(quad, zIndex);
+          } else {
+              // now take a tri fragment from our array and:
+              // set its vertices
+              auto &tri = allocator.allocateFragment<psyqo::Prim::GouraudTexturedTriangle>();
+              tri.primitive.pointA = projected[0];
+              tri.primitive.pointB = projected[1];
+              tri.primitive.pointC = projected[2];
+
+              // set its colour, and make it opaque
+              tri.primitive.setColorA(colA);
+              tri.primitive.setColorB(colB);
+              tri.primitive.setColorC(colC);
+              tri.primitive.setOpaque();
+
+              // do we have a texture for this?
+              if (texture) {
+                  // set its tpage
+                  tri.primitive.tpage = tpage;
+
+                  // set its clut if it has one
+                  if (texture->hasClut)
+                      tri.primitive.clutIndex = {texture->clutX, texture->clutY};
+
+                  // set its uv coords
+                  applyUV(tri.primitive.uvA, mesh->uvIndices[i].i3);
+                  applyUV(tri.primitive.uvB, mesh->uvIndices[i].i1);
+                  applyUV(tri.primitive.uvC, mesh->uvIndices[i].i4);
+              }
+
+              // finally we can insert the tri fragment into the ordering table at the calculated z-index
+              if (zIndex <= SUBDIVISION_DISTANCE)
+                  SubdivideTexturedTri(&tri, zIndex, &ot, 2);
+              else
+                  InsertFace(tri, zIndex);
+          }
+      }
     }
 
 #if ENABLE_BONE_DEBUG
@@ -517,9 +558,139 @@ void Renderer::RenderGameObjects(uint32_t deltaTime, const psyqo::Matrix33 &came
 #endif
   }
 
+  FlushFaces();
+  FinishTPageCount();
+
   PerfMonitor::SetRenderedGameObjects(renderedObjects, gameObjects.size());
 }
 
+uint8_t Renderer::TextureGroup(const TimFile *texture) {
+  if (!texture)
+    return 0;
+
+  // textures packed into the same tpage with the same clut draw the same way, so they share a group
+  uint32_t key = 1 | (texture->x / texturePageWidth) << 1 | (texture->y / texturePageHeight) << 5 | uint32_t(texture->colourMode) << 6;
+  if (texture->hasClut)
+    key |= uint32_t(texture->clutX / 16) << 8 | uint32_t(texture->clutY) << 16;
+
+  // group 0 is untextured, so it's never handed out here
+  if (m_textureGroupCount == 0)
+    m_textureGroupCount = 1;
+
+  for (uint8_t i = 1; i < m_textureGroupCount; i++) {
+    if (m_textureGroupKeys[i] == key)
+      return i;
+  }
+
+  if (m_textureGroupCount == MAX_TEXTURE_GROUPS)
+    return MAX_TEXTURE_GROUPS - 1;
+
+  m_textureGroupKeys[m_textureGroupCount] = key;
+  return m_textureGroupCount++;
+}
+
+bool Renderer::DeferFace(void *fragment, uint32_t zIndex, bool isQuad) {
+  if (!m_isGroupingByTexture || m_sortedFaceCount == MAX_SORTED_FACES)
+    return false;
+
+  m_sortedFaces[m_sortedFaceCount++] = {fragment, uint16_t(zIndex), m_currentGroup, isQuad};
+  return true;
+}
+
+void Renderer::InsertFace(psyqo::Fragments::SimpleFragment<psyqo::Prim::GouraudTexturedQuad> &quad, uint32_t zIndex) {
+  if (DeferFace(&quad, zIndex, true))
+    return;
+
+  CountTPageChange(zIndex, m_currentGroup);
+  m_orderingTables[m_gpu.getParity()].insert(quad, zIndex);
+}
+
+void Renderer::InsertFace(psyqo::Fragments::SimpleFragment<psyqo::Prim::GouraudTexturedTriangle> &tri, uint32_t zIndex) {
+  if (DeferFace(&tri, zIndex, false))
+    return;
+
+  CountTPageChange(zIndex, m_currentGroup);
+  m_orderingTables[m_gpu.getParity()].insert(tri, zIndex);
+}
+
+void Renderer::FlushFaces(void) {
+  if (m_sortedFaceCount == 0)
+    return;
+
+  // counting sort by group, so faces that land in the same bucket get linked one group after another
+  uint16_t groupStart[MAX_TEXTURE_GROUPS + 1] = {0};
+  for (uint16_t i = 0; i < m_sortedFaceCount; i++)
+    groupStart[m_sortedFaces[i].group + 1]++;
+
+  for (uint8_t g = 1; g <= MAX_TEXTURE_GROUPS; g++)
+    groupStart[g] += groupStart[g - 1];
+
+  for (uint16_t i = 0; i < m_sortedFaceCount; i++)
+    m_sortedOrder[groupStart[m_sortedFaces[i].group]++] = i;
+
+  auto &ot = m_orderingTables[m_gpu.getParity()];
+  for (uint16_t i = 0; i < m_sortedFaceCount; i++) {
+    const auto &face = m_sortedFaces[m_sortedOrder[i]];
+    CountTPageChange(face.zIndex, face.group);
+
+    if (face.isQuad)
+      ot.insert(*static_cast<psyqo::Fragments::SimpleFragment<psyqo::Prim::GouraudTexturedQuad> *>(face.fragment), face.zIndex);
+    else
+      ot.insert(*static_cast<psyqo::Fragments::SimpleFragment<psyqo::Prim::GouraudTexturedTriangle> *>(face.fragment), face.zIndex);
+  }
+
+  m_sortedFaceCount = 0;
+}
+
+void Renderer::SetCountingTPageChanges(bool isCounting) {
+  if (isCounting && m_bucketFirstGroup == nullptr) {
+    m_bucketFirstGroup = (uint8_t *)psyqo_malloc(ORDERING_TABLE_SIZE * 2);
+    if (m_bucketFirstGroup == nullptr) {
+      printf("RENDERER: Not enough memory to count tpage changes.\n");
+      return;
+    }
+
+    m_bucketLastGroup = m_bucketFirstGroup + ORDERING_TABLE_SIZE;
+    __builtin_memset(m_bucketFirstGroup, 0, ORDERING_TABLE_SIZE * 2);
+  } else if (!isCounting && m_bucketFirstGroup != nullptr) {
+    psyqo_free(m_bucketFirstGroup);
+    m_bucketFirstGroup = m_bucketLastGroup = nullptr;
+    m_tpageChanges = 0;
+  }
+}
+
+void Renderer::CountTPageChange(uint32_t zIndex, uint8_t group) {
+  if (m_bucketFirstGroup == nullptr)
+    return;
+
+  // inserting puts a face at the front of its bucket, so it's drawn right before whatever went in last
+  uint8_t key = group + 1;
+  if (m_bucketFirstGroup[zIndex] == 0)
+    m_bucketLastGroup[zIndex] = key;
+  else if (m_bucketFirstGroup[zIndex] != key)
+    m_tpageChanges++;
+
+  m_bucketFirstGroup[zIndex] = key;
+}
+
+void Renderer::FinishTPageCount(void) {
+  if (m_bucketFirstGroup == nullptr)
+    return;
+
+  // the gpu goes from the far end of the table to the near end, so add the changes from one bucket to the next
+  uint8_t previous = 0;
+  for (int32_t z = ORDERING_TABLE_SIZE - 1; z >= 0; z--) {
+    if (m_bucketFirstGroup[z] == 0)
+      continue;
+
+    if (previous != 0 && previous != m_bucketFirstGroup[z])
+      m_tpageChanges++;
+
+    previous = m_bucketLastGroup[z];
+    m_bucketFirstGroup[z] = m_bucketLastGroup[z] = 0;
+  }
+}
+
 void Renderer::RenderBillboards(uint32_t deltaTime, const psyqo::Matrix33 &cameraRotationMatrix) {
   eastl::array<psyqo::Vertex, 4> projected;
   uint32_t zIndex = 0;
@@ -541,7 +712,7 @@ void Renderer::RenderBillboards(uint32_t deltaTime, const psyqo::Matrix33 &camer
   for (auto const &billboard : billboards) {
     TransformObjectToViewSpace(billboard->pos(), cameraRotationMatrix, finalCameraMatrix);
 
-    const auto texture = billboard->pTexture();
+    const auto texture = TextureManager::Drawable(billboard->pTexture());
     if (texture) {
         tpage = TextureManager::GetTPageAttr(texture);
         offset = TextureManager::GetTPageUVForTim(texture);
@@ -654,11 +825,17 @@ void Renderer::RenderParticles(uint32_t deltaTime, const psyqo::Matrix33 &camera
   psyqo::Matrix33 finalCameraMatrix = {0};
   GTEMath::MultiplyMatrix33(cameraRotationMatrix, m_activeCamera->inverseRotationMatrix(), &finalCameraMatrix);
 
+  // particles live in the pool as separate arrays, each emitter owns a range of it
+  auto const &positions = ParticlePool::Positions();
+  auto const &sizes = ParticlePool::Sizes();
+  auto const &colours = ParticlePool::Colours();
+  eastl::array<psyqo::Vec3, 4> corners;
+
   for (auto const &emitter : emitters) {
-    auto const particles = emitter->particles();
+    auto const &uv = emitter->ParticleUVCoords();
 
     // send tpage info to gpu
-    auto texture = emitter->pParticleTexture();
+    auto texture = TextureManager::Drawable(emitter->pParticleTexture());
     if (texture) {
       auto tpageAttr = TextureManager::GetTPageAttr(texture);
       auto &tpage = allocator.allocateFragment<psyqo::Prim::TPage>();
@@ -666,8 +843,9 @@ void Renderer::RenderParticles(uint32_t deltaTime, const psyqo::Matrix33 &camera
       m_gpu.chain(tpage);
     }
 
-    for (auto const &particle : particles) {
-      auto finalParticlePos = TransformObjectToViewSpace(particle.pos(), cameraRotationMatrix, finalCameraMatrix);
+    auto lastParticle = emitter->FirstParticle() + emitter->LiveParticles();
+    for (uint16_t i = emitter->FirstParticle(); i < lastParticle; i++) {
+      auto finalParticlePos = TransformObjectToViewSpace(positions[i], cameraRotationMatrix, finalCameraMatrix);
 
       if (emitter->AreParticles2D()) {
         if (finalParticlePos.z <= 0)
@@ -693,7 +871,7 @@ void Renderer::RenderParticles(uint32_t deltaTime, const psyqo::Matrix33 &camera
         psyqo::GTE::read<psyqo::GTE::Register::SXY2>(&vertex.packed);
 
         // calculate scaled size and make sure it doesnt go below 1
-        auto projectedSize = particle.size() * (1.0_fp * PROJECTION_DISTANCE) / finalParticlePos.z;
+        auto projectedSize = sizes[i] * (1.0_fp * PROJECTION_DISTANCE) / finalParticlePos.z;
         auto scaledSize = psyqo::Vertex{static_cast<int16_t>(projectedSize.x.integer()), static_cast<int16_t>(projectedSize.y.integer())};
         scaledSize = {eastl::clamp<int16_t>(scaledSize.x, 1, scaledSize.x), eastl::clamp<int16_t>(scaledSize.y, 1, scaledSize.y)};
 
@@ -708,15 +886,15 @@ void Renderer::RenderParticles(uint32_t deltaTime, const psyqo::Matrix33 &camera
           sprite.primitive.texInfo.clut = psyqo::PrimPieces::ClutIndex(texture->clutX, texture->clutY);
           
           // as particles can be quads they have 4 lots of uv data, so just take the first one
-          sprite.primitive.texInfo.u = particle.uv()[0].u;
-          sprite.primitive.texInfo.v = particle.uv()[0].v;
+          sprite.primitive.texInfo.u = uv[0].u;
+          sprite.primitive.texInfo.v = uv[0].v;
         }
         
         sprite.primitive.position = pos;
         sprite.primitive.size = scaledSize;
 
         // handle fog
-        auto colour = particle.colour();
+        auto colour = colours[i];
         ApplyAmbientToColour(&colour);
 
         if (m_lighting->m_isSimpleFogEnabled) {
@@ -735,10 +913,16 @@ void Renderer::RenderParticles(uint32_t deltaTime, const psyqo::Matrix33 &camera
               offset.pos.y += (texture->height - 1);
           }
 
+          // same corners a billboard of this size would have
+          corners[0] = {-sizes[i].x / 2, sizes[i].y / 2, 0};
+          corners[1] = {sizes[i].x / 2, sizes[i].y / 2, 0};
+          corners[2] = {-sizes[i].x / 2, -sizes[i].y / 2, 0};
+          corners[3] = {sizes[i].x / 2, -sizes[i].y / 2, 0};
+
           // load first 3 verts into GTE
-          psyqo::GTE::writeSafe<psyqo::GTE::PseudoRegister::V0>(particle.corners()[0]);
-          psyqo::GTE::writeSafe<psyqo::GTE::PseudoRegister::V1>(particle.corners()[1]);
-          psyqo::GTE::writeSafe<psyqo::GTE::PseudoRegister::V2>(particle.corners()[2]);
+          psyqo::GTE::writeSafe<psyqo::GTE::PseudoRegister::V0>(corners[0]);
+          psyqo::GTE::writeSafe<psyqo::GTE::PseudoRegister::V1>(corners[1]);
+          psyqo::GTE::writeSafe<psyqo::GTE::PseudoRegister::V2>(corners[2]);
           psyqo::GTE::Kernels::rtpt();
           psyqo::GTE::Kernels::nclip();
           if (!psyqo::GTE::readRaw<psyqo::GTE::Register::MAC0>())
@@ -747,7 +931,7 @@ void Renderer::RenderParticles(uint32_t deltaTime, const psyqo::Matrix33 &camera
           // store the first vert so we can read the last one in
           psyqo::GTE::read<psyqo::GTE::Register::SXY0>(&projected[0].packed);
 
-          psyqo::GTE::writeSafe<psyqo::GTE::PseudoRegister::V0>(particle.corners()[3]);
+          psyqo::GTE::writeSafe<psyqo::GTE::PseudoRegister::V0>(corners[3]);
           psyqo::GTE::Kernels::rtps();
           
           psyqo::GTE::Kernels::avsz4();
@@ -766,11 +950,11 @@ void Renderer::RenderParticles(uint32_t deltaTime, const psyqo::Matrix33 &camera
 
           // handle colour + fog — particles use same colour for all verts so one rtps for IR0 is enough
           // re-transform corner 0 to get a representative IR0 for fog
-          psyqo::GTE::writeSafe<psyqo::GTE::PseudoRegister::V0>(particle.corners()[0]);
+          psyqo::GTE::writeSafe<psyqo::GTE::PseudoRegister::V0>(corners[0]);
           psyqo::GTE::Kernels::rtps();
           uint32_t p = psyqo::GTE::readRaw<psyqo::GTE::Register::IR0>();
 
-          auto colour = particle.colour();
+          auto colour = colours[i];
           ApplyAmbientToColour(&colour);
           colour = ApplyFogToColourGTE(colour, p);
 
@@ -816,19 +1000,19 @@ void Renderer::RenderParticles(uint32_t deltaTime, const psyqo::Matrix33 &camera
                   quad.primitive.clutIndex = {texture->clutX, texture->clutY};
 
               // set its uv coords
-              auto uvA = particle.uv()[0];
+              auto uvA = uv[0];
               quad.primitive.uvA.u = offset.pos.x + uvA.u;
               quad.primitive.uvA.v = offset.pos.y - uvA.v;
 
-              auto uvB = particle.uv()[1];
+              auto uvB = uv[1];
               quad.primitive.uvB.u = offset.pos.x + uvB.u;
               quad.primitive.uvB.v = offset.pos.y - uvB.v;
 
-              auto uvC = particle.uv()[2];
+              auto uvC = uv[2];
               quad.primitive.uvC.u = offset.pos.x + uvC.u;
               quad.primitive.uvC.v = offset.pos.y - uvC.v;
 
-              auto uvD = particle.uv()[3];
+              auto uvD = uv[3];
               quad.primitive.uvD.u = offset.pos.x + uvD.u;
               quad.primitive.uvD.v = offset.pos.y - uvD.v;
 
@@ -862,35 +1046,60 @@ void Renderer::Clear(psyqo::Color color) {
 }
 
 void Renderer::RenderSprite(const TimFile *texture, const psyqo::Rect rect, const psyqo::PrimPieces::UVCoords uv) {
-  // get the frame buffer we're currently rendering
-  int frameBuffer = m_gpu.getParity();
+  // nothing to draw until it's all in vram
+  if (!TextureManager::Drawable(texture))
+    return;
 
-  // current ordering tables and fill command
-  auto &clear = m_clear[frameBuffer];
-  auto &tpages = m_tpages[frameBuffer];
-  auto &sprites = m_sprites[frameBuffer];
+  if (m_pendingSpriteCount == MAX_BATCHED_SPRITES)
+    FlushSprites();
 
-  // chain tpage info over
-  auto tpageAttr = TextureManager::GetTPageAttr(texture);
-  auto &tpage = tpages[m_currentSpriteFragment];
-  tpage.primitive.attr = tpageAttr;
-  m_gpu.chain(tpage);
+  // sprites on the same tpage can share one tpage change
+  uint16_t tpageKey = 1 | (texture->x / texturePageWidth) << 1 | (texture->y / texturePageHeight) << 5 | uint16_t(texture->colourMode) << 6;
+  m_pendingSprites[m_pendingSpriteCount++] = {texture, rect, uv, tpageKey};
+}
 
-  // fix this so it actually renders more than one sprite
-  auto &sprite = sprites[m_currentSpriteFragment++];
-  sprite.primitive.position = rect.pos;
-  sprite.primitive.size = rect.size;
+void Renderer::FlushSprites(void) {
+  auto &allocator = m_allocators[m_gpu.getParity()];
 
-  // set its clut if it has one
-  if (texture->hasClut)
-    sprite.primitive.texInfo.clut = psyqo::PrimPieces::ClutIndex(texture->clutX, texture->clutY);
+  // tpages go out in the order they were first used, each followed by every sprite on it
+  for (uint16_t i = 0; i < m_pendingSpriteCount; i++) {
+    const uint16_t tpageKey = m_pendingSprites[i].tpageKey;
+    if (tpageKey == 0)
+      continue;
+
+    if (allocator.remaining() < sizeof(psyqo::Fragments::SimpleFragment<psyqo::Prim::TPage>) + sizeof(psyqo::Fragments::SimpleFragment<psyqo::Prim::Sprite>))
+      break;
+
+    auto &tpage = allocator.allocateFragment<psyqo::Prim::TPage>();
+    tpage.primitive.attr = TextureManager::GetTPageAttr(m_pendingSprites[i].texture);
+    m_gpu.chain(tpage);
+
+    for (uint16_t j = i; j < m_pendingSpriteCount; j++) {
+      auto &pending = m_pendingSprites[j];
+      if (pending.tpageKey != tpageKey)
+        continue;
+
+      if (allocator.remaining() < sizeof(psyqo::Fragments::SimpleFragment<psyqo::Prim::Sprite>))
+        break;
+
+      auto &sprite = allocator.allocateFragment<psyqo::Prim::Sprite>();
+      sprite.primitive.position = pending.rect.pos;
+      sprite.primitive.size = pending.rect.size;
+
+      // set its clut if it has one
+      if (pending.texture->hasClut)
+        sprite.primitive.texInfo.clut = psyqo::PrimPieces::ClutIndex(pending.texture->clutX, pending.texture->clutY);
 
-  // set the uv data
-  psyqo::Rect uvOffset = TextureManager::GetTPageUVForTim(texture);
-  sprite.primitive.texInfo.u = uv.u; // uvOffset.pos.x + uv.u;
-  sprite.primitive.texInfo.v = uv.v; // uvOffset.pos.y + (rect.size.y - 1 - uv.v);
+      // set the uv data
+      sprite.primitive.texInfo.u = pending.uv.u;
+      sprite.primitive.texInfo.v = pending.uv.v;
 
-  m_gpu.chain(sprite);
+      m_gpu.chain(sprite);
+      pending.tpageKey = 0;
+    }
+  }
+
+  m_pendingSpriteCount = 0;
 }
 
 void Renderer::SetActiveCamera(Camera *camera) { m_activeCamera = camera; }
@@ -930,13 +1139,13 @@ void Renderer::SubdivideTexturedQuad(psyqo::Fragments::SimpleFragment<psyqo::Pri
   auto& balloc = m_allocators[m_gpu.getParity()];
 
   if (balloc.remaining() < sizeof(psyqo::Prim::GouraudTexturedQuad) + 20) {
-    ot->insert(*texturedQuad, zIndex);
+    InsertFace(*texturedQuad, zIndex);
     return;
   }
 
   // out of recursion depth, just insert as-is
   if (maxDepth == 0) {
-    ot->insert(*texturedQuad, zIndex);
+    InsertFace(*texturedQuad, zIndex);
     return;
   }
 
@@ -947,7 +1156,7 @@ void Renderer::SubdivideTexturedQuad(psyqo::Fragments::SimpleFragment<psyqo::Pri
                 eastl::min(q.pointA.y, eastl::min(q.pointB.y, eastl::min(q.pointC.y, q.pointD.y)));
 
   if (width < 32 && height < 32) {
-    ot->insert(*texturedQuad, zIndex);
+    InsertFace(*texturedQuad, zIndex);
     return;
   }
 
@@ -957,7 +1166,7 @@ void Renderer::SubdivideTexturedQuad(psyqo::Fragments::SimpleFragment<psyqo::Pri
                     q.pointC.x < -100 || q.pointC.y < -100 ||
                     q.pointD.x < -100 || q.pointD.y < -100 ||
                     width > 420 || height > 356) {
-    ot->insert(*texturedQuad, zIndex);
+    InsertFace(*texturedQuad, zIndex);
     return;
   }
 
@@ -1049,12 +1258,12 @@ void Renderer::SubdivideTexturedTri(psyqo::Fragments::SimpleFragment<psyqo::Prim
   auto& balloc = m_allocators[m_gpu.getParity()];
 
   if (balloc.remaining() < sizeof(psyqo::Prim::GouraudTexturedTriangle) + 20) {
-    ot->insert(*tri, zIndex);
+    InsertFace(*tri, zIndex);
     return;
   }
 
   if (maxDepth == 0) {
-    ot->insert(*tri, zIndex);
+    InsertFace(*tri, zIndex);
     return;
   }
 
@@ -1068,7 +1277,7 @@ void Renderer::SubdivideTexturedTri(psyqo::Fragments::SimpleFragment<psyqo::Prim
   auto height = maxY - minY;
 
   if (width < 32 && height < 32) {
-    ot->insert(*tri, zIndex);
+    InsertFace(*tri, zIndex);
     return;
   }
 
@@ -1077,7 +1286,7 @@ void Renderer::SubdivideTexturedTri(psyqo::Fragments::SimpleFragment<psyqo::Prim
                     t.pointB.x < -100 || t.pointB.y < -100 ||
                     t.pointC.x < -100 || t.pointC.y < -100 ||
                     width > 420 || height > 356) {
-    ot->insert(*tri, zIndex);
+    InsertFace(*tri, zIndex);
     return;
   }  
 
@@ -1217,6 +1426,16 @@ void Renderer::SubdivideTexturedTri(psyqo::Fragments::SimpleFragment<psyqo::Prim
   }
 }
 
+uint8_t Renderer::GetLodLevel(int32_t z) {
+  uint8_t level = 0;
+  for (auto distance : LOD_DISTANCES) {
+    if (z < distance) break;
+    level++;
+  }
+
+  return level;
+}
+
 psyqo::FixedPoint<> Renderer::GetFogFactor(uint32_t z) {
   if (z <= NEAR_FOG_DISTANCE) return 0.0_fp;
   if (z >= FULL_FOG_DISTANCE) return 1.0_fp;
@@ -3,6 +3,7 @@
 
 #include "../textures/texture_manager.hh"
 #include "../core/collision_types.hh"
+#include "../ui/hud/hud_font.hh"
 #include "lighting.hh"
 
 #include "camera.hh"
@@ -19,11 +20,19 @@ static constexpr uint16_t FULL_FOG_DISTANCE = 3'500; // screen z
 static constexpr uint16_t NEAR_FOG_DISTANCE = 2'000; // screen z
 static constexpr uint32_t BUMP_ALLOCATOR_BYTES = 125'000; // this is for each frame, so double what this number is is used up in RAM
 static constexpr uint16_t SUBDIVISION_DISTANCE = 750; // after view space transformation
+static constexpr uint16_t LOD_DISTANCES[] = {1'200, 2'400}; // screen z where an object drops to its next level of detail
+static constexpr uint16_t MAX_SORTED_FACES = 2'048; // faces held back for grouping by texture each frame, the rest go in as they come
+static constexpr uint8_t MAX_TEXTURE_GROUPS = 64; // distinct tpage + clut pairs per frame, past this they share the last group
+static constexpr uint16_t MAX_BATCHED_SPRITES = 256; // sprites waiting to be flushed. a full batch flushes itself
+// the system font is 256x48 4-bit texels with its clut on the line underneath, kept away from the vram packer
+static constexpr psyqo::Vertex SYSTEM_FONT_VRAM_POS = {{.x = 960, .y = 256}};
+static constexpr uint16_t SYSTEM_FONT_VRAM_WIDTH = 64;
+static constexpr uint16_t SYSTEM_FONT_VRAM_HEIGHT = 49;
 static constexpr psyqo::Color c_loadingBackgroundColour = {.r = 0, .g = 0, .b = 0};
 
 class Renderer final {
   static Renderer *m_instance;
-  static psyqo::Font<100> m_systemFont;
+  static HUDFont m_systemFont;
 
   psyqo::GPU &m_gpu;
   uint32_t m_lastFrameCounter = 0;
@@ -39,15 +48,41 @@ class Renderer final {
   // bump allocator so we're not guessing at runtime how many quads/lines/etc/etc/etc we're gonna have
   psyqo::BumpAllocator<BUMP_ALLOCATOR_BYTES> m_allocators[2];
 
-  // texture page + sprite info
-  // TODO: move to bump allocator?
-  eastl::array<psyqo::Fragments::SimpleFragment<psyqo::Prim::TPage>, 40> m_tpages[2];
-  eastl::array<psyqo::Fragments::SimpleFragment<psyqo::Prim::Sprite>, 40> m_sprites[2];
-  uint8_t m_currentSpriteFragment = 0;
+  // sprites wait here until they're flushed, then go out grouped by tpage using fragments from the bump allocator
+  struct PendingSprite {
+    const TimFile *texture;
+    psyqo::Rect rect;
+    psyqo::PrimPieces::UVCoords uv;
+    uint16_t tpageKey; // 0 once it's been drawn
+  };
+  eastl::array<PendingSprite, MAX_BATCHED_SPRITES> m_pendingSprites;
+  uint16_t m_pendingSpriteCount = 0;
 
   // lighting, cached at start of scene
   Lighting* m_lighting = nullptr;
 
+  // game object faces held back so each ot bucket can be linked one texture at a time
+  struct SortedFace {
+    void *fragment;
+    uint16_t zIndex;
+    uint8_t group;
+    bool isQuad;
+  };
+  eastl::array<SortedFace, MAX_SORTED_FACES> m_sortedFaces;
+  eastl::array<uint16_t, MAX_SORTED_FACES> m_sortedOrder;
+  uint16_t m_sortedFaceCount = 0;
+  bool m_isGroupingByTexture = false;
+
+  // tpage + clut of each texture group this frame. group 0 is untextured
+  eastl::array<uint32_t, MAX_TEXTURE_GROUPS> m_textureGroupKeys;
+  uint8_t m_textureGroupCount = 0;
+  uint8_t m_currentGroup = 0;
+
+  // group + 1 of the first and last face linked into each ot bucket, 0 if it's empty. only allocated while counting
+  uint8_t *m_bucketFirstGroup = nullptr;
+  uint8_t *m_bucketLastGroup = nullptr;
+  uint16_t m_tpageChanges = 0;
+
   Renderer(psyqo::GPU &gpuInstance) : m_gpu(gpuInstance){};
   ~Renderer(){};
 
@@ -58,12 +93,21 @@ class Renderer final {
   void SubdivideTexturedQuad(psyqo::Fragments::SimpleFragment<psyqo::Prim::GouraudTexturedQuad>* texturedQuad, uint32_t zIndex, psyqo::OrderingTable<ORDERING_TABLE_SIZE>* ot, uint8_t maxDepth = 1);
   void SubdivideTexturedTri(psyqo::Fragments::SimpleFragment<psyqo::Prim::GouraudTexturedTriangle>* tri, uint32_t zIndex, psyqo::OrderingTable<ORDERING_TABLE_SIZE>* ot, uint8_t maxDepth = 1);
 
+  uint8_t TextureGroup(const TimFile *texture);
+  bool DeferFace(void *fragment, uint32_t zIndex, bool isQuad);
+  void InsertFace(psyqo::Fragments::SimpleFragment<psyqo::Prim::GouraudTexturedQuad> &quad, uint32_t zIndex);
+  void InsertFace(psyqo::Fragments::SimpleFragment<psyqo::Prim::GouraudTexturedTriangle> &tri, uint32_t zIndex);
+  void FlushFaces(void);
+  void CountTPageChange(uint32_t zIndex, uint8_t group);
+  void FinishTPageCount(void);
+
   void RenderBillboards(uint32_t deltaTime, const psyqo::Matrix33 &cameraRotationMatrix);
   void RenderParticles(uint32_t deltaTime, const psyqo::Matrix33 &cameraRotationMatrix);
   
   bool IsGameObjectVisible(const psyqo::Vec3& objectPos, const AABBCollision& collisionBox, const int32_t& boundingSphereRadius);
 
   psyqo::FixedPoint<> GetFogFactor(uint32_t z);
+  uint8_t GetLodLevel(int32_t z);
 
   void ApplyAmbientToColour(psyqo::Color* colA);
   void ApplyAmbientToColours(psyqo::Color* colA, psyqo::Color* colB, psyqo::Color* colC);
@@ -75,6 +119,8 @@ class Renderer final {
   void SetFogNearFar(psyqo::FixedPoint<> near, psyqo::FixedPoint<> far);
 public:
   static void Init(psyqo::GPU &gpuInstance);
+  // tell the vram allocator where the system font is. needs doing again after VRamAllocator::Reset
+  static void ReserveSystemFontVRam(void);
 
   void StartScene(void);
   void VRamUpload(const uint16_t *data, int16_t x, int16_t y, int16_t width, int16_t height);
@@ -87,17 +133,29 @@ public:
   void Render(uint32_t deltaTime);
   void Clear(psyqo::Color clearColour = Lighting::instance().m_fogColour);
   void RenderLoadingScreen(uint16_t loadPercentage);
+  // sprites are batched. nothing is drawn until FlushSprites, then they go out grouped by tpage,
+  // so sprites from different textures that overlap can swap order within a batch
   void RenderSprite(const TimFile *tim, const psyqo::Rect rect, const psyqo::PrimPieces::UVCoords uv);
+  void FlushSprites(void);
   void SetActiveCamera(Camera *camera);
   const Camera* ActiveCamera(void) const { return m_activeCamera; }
   
+  // link game object faces into each ot bucket grouped by tpage + clut rather than in draw order,
+  // so the gpu flips texture less. costs a sort over the frame's faces
+  void SetGroupingByTexture(bool isGrouping) { m_isGroupingByTexture = isGrouping; }
+  bool IsGroupingByTexture(void) const { return m_isGroupingByTexture; }
+
+  // count how often consecutive game object faces change tpage or clut. costs ORDERING_TABLE_SIZE * 2 bytes while on
+  void SetCountingTPageChanges(bool isCounting);
+  uint16_t TPageChanges(void) const { return m_tpageChanges; }
+
   void SetFogColour(const psyqo::Color &colour);
   const bool& IsSimpleFogEnabled(void) const { return m_lighting->m_isSimpleFogEnabled; }
 
 
   static Renderer &Instance() { return *m_instance; }
   psyqo::GPU &GPU() { return m_gpu; }
-  psyqo::Font<100> *SystemFont() { return &m_systemFont; }
+  HUDFont *SystemFont() { return &m_systemFont; }
 };
 
 #endif
@@ -0,0 +1,139 @@
+#include "asset_streamer.hh"
+
+#include "EASTL/heap.h"
+#include "psyqo/xprintf.h"
+
+#include "../render/renderer.hh"
+#include "../textures/texture_manager.hh"
+#include "scene_loader.hh"
+
+eastl::fixed_vector<StreamRequest, MAX_STREAMING_REQUESTS, false> AssetStreamer::m_queue;
+uint32_t AssetStreamer::m_nextSequence = 0;
+StreamRequest AssetStreamer::m_current;
+AssetStreamer::StreamState AssetStreamer::m_state = AssetStreamer::StreamState::IDLE;
+bool AssetStreamer::m_isCancelled = false;
+bool AssetStreamer::m_isCancelling = false;
+psyqo::Buffer<uint8_t> AssetStreamer::m_buffer;
+psyqo::Coroutine<> AssetStreamer::m_readRoutine;
+std::coroutine_handle<> AssetStreamer::m_idleWaiter;
+eastl::vector<LoadQueue> AssetStreamer::m_nested;
+uint8_t AssetStreamer::m_framesToSkip = 0;
+uint32_t AssetStreamer::m_lastParseTime = 0;
+
+// true if a should come out of the queue after b
+static bool IsLowerPriority(const StreamRequest &a, const StreamRequest &b) {
+  if (a.priority != b.priority)
+    return a.priority < b.priority;
+
+  return a.sequence > b.sequence;
+}
+
+bool AssetStreamer::Enqueue(const LoadQueue &file, StreamPriority priority, StreamCallback onComplete) {
+  // callbacks run by Cancel can't refill the queue behind it
+  if (m_isCancelling)
+    return false;
+
+  if (m_queue.full()) {
+    printf("STREAMER: Queue is full, dropping %s.\n", file.name.c_str());
+    return false;
+  }
+
+  m_queue.push_back({file, priority, m_nextSequence++, eastl::move(onComplete)});
+  eastl::push_heap(m_queue.begin(), m_queue.end(), IsLowerPriority);
+  return true;
+}
+
+void AssetStreamer::Process(void) {
+  // big textures trickle into vram a slice a frame, even while a parse is being paid back
+  TextureManager::Process();
+
+  // paying back a parse that went over budget
+  if (m_framesToSkip > 0) {
+    m_framesToSkip--;
+    return;
+  }
+
+  if (m_state == StreamState::READ)
+    ParseCurrent();
+
+  // kick off the next read straight away so the drive is never sat idle while there's work
+  if (m_state != StreamState::IDLE || m_queue.empty())
+    return;
+
+  eastl::pop_heap(m_queue.begin(), m_queue.end(), IsLowerPriority);
+  m_current = eastl::move(m_queue.back());
+  m_queue.pop_back();
+
+  m_state = StreamState::READING;
+  m_isCancelled = false;
+  m_readRoutine = ReadNext();
+  m_readRoutine.resume();
+}
+
+psyqo::Coroutine<> AssetStreamer::ReadNext(void) {
+  m_buffer = co_await ArchiveHelper::LoadFile(m_current.file.name.c_str());
+
+  if (m_isCancelled) {
+    m_buffer.clear();
+    Finish(false);
+  } else
+    m_state = StreamState::READ;
+
+  // the CD is free again, let a waiting hard load carry on
+  if (m_idleWaiter) {
+    auto waiter = m_idleWaiter;
+    m_idleWaiter = nullptr;
+    waiter.resume();
+  }
+}
+
+void AssetStreamer::ParseCurrent(void) {
+  auto &gpu = Renderer::Instance().GPU();
+  auto start = gpu.now();
+
+  TextureManager::SetSlicedUploads(true);
+  bool success = SceneLoader::ParseFile(m_current.file, eastl::move(m_buffer), m_nested);
+  TextureManager::SetSlicedUploads(false);
+
+  // a nested scene's files stream in at the same priority, after whatever's already waiting at that priority
+  for (const auto &file : m_nested)
+    Enqueue(file, m_current.priority);
+  m_nested.clear();
+
+  m_lastParseTime = gpu.now() - start;
+  auto framesOver = m_lastParseTime / STREAMING_PARSE_BUDGET_US;
+  m_framesToSkip = framesOver > MAX_STREAMING_SKIP_FRAMES ? MAX_STREAMING_SKIP_FRAMES : framesOver;
+
+  Finish(success);
+}
+
+void AssetStreamer::Finish(bool success) {
+  m_state = StreamState::IDLE;
+
+  // take the callback out first, it's allowed to queue up more files
+  auto onComplete = eastl::move(m_current.onComplete);
+  m_current.onComplete = nullptr;
+  if (onComplete)
+    onComplete(m_current.file, success);
+}
+
+void AssetStreamer::Cancel(void) {
+  // the read can't be stopped, so it's just ignored when it lands
+  if (m_state == StreamState::READING)
+    m_isCancelled = true;
+
+  if (m_state == StreamState::READ) {
+    m_buffer.clear();
+    Finish(false);
+  }
+
+  m_isCancelling = true;
+  for (const auto &request : m_queue) {
+    if (request.onComplete)
+      request.onComplete(request.file, false);
+  }
+  m_queue.clear();
+  m_isCancelling = false;
+
+  m_framesToSkip = 0;
+}
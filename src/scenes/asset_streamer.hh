@@ -0,0 +1,94 @@
+#ifndef _ASSET_STREAMER_HH
+#define _ASSET_STREAMER_HH
+
+#include <coroutine>
+#include <stdint.h>
+
+#include "EASTL/fixed_vector.h"
+#include "EASTL/functional.h"
+#include "EASTL/vector.h"
+#include "psyqo/buffer.hh"
+#include "psyqo/coroutine.hh"
+
+#include "../helpers/load_queue.hh"
+
+static constexpr uint8_t MAX_STREAMING_REQUESTS = 32;
+
+// roughly how long a parse can take before the streamer starts backing off. ~1/8th of a 60hz frame
+static constexpr uint32_t STREAMING_PARSE_BUDGET_US = 2000;
+
+// a parse that blows well past the budget never stalls streaming for longer than this
+static constexpr uint8_t MAX_STREAMING_SKIP_FRAMES = 8;
+
+enum class StreamPriority : uint8_t { LOW, NORMAL, HIGH, URGENT };
+
+// called once the file has been parsed, or dropped. success is false if it failed to load or was cancelled
+typedef eastl::function<void(const LoadQueue &file, bool success)> StreamCallback;
+
+struct StreamRequest {
+  LoadQueue file;
+  StreamPriority priority;
+  uint32_t sequence; // keeps requests of the same priority first in, first out
+  StreamCallback onComplete;
+};
+
+/*
+ * loads files in the background while a scene keeps rendering.
+ * requests are read off the CD one at a time, highest priority first. the read is a
+ * coroutine so the frame carries on while the drive works, then the finished file
+ * is parsed on a later frame. only one file is parsed per frame, and a parse that
+ * goes over STREAMING_PARSE_BUDGET_US makes the streamer sit out the next few frames
+ * to pay it back.
+ *
+ * call Process once per frame from whatever scene is streaming.
+ * the scene arena is closed during gameplay, so anything streamed in lives on the heap.
+ */
+class AssetStreamer final {
+public:
+  // false if the queue is full
+  static bool Enqueue(const LoadQueue &file, StreamPriority priority = StreamPriority::NORMAL,
+                      StreamCallback onComplete = nullptr);
+  static void Process(void);
+
+  // drops everything queued, plus any read in flight or waiting to be parsed. their callbacks get success = false
+  static void Cancel(void);
+
+  // only one thing can use the CD at a time, so a hard load waits on this before it starts reading
+  struct IdleAwaiter {
+    bool await_ready(void) const { return !AssetStreamer::IsReading(); }
+    void await_suspend(std::coroutine_handle<> handle) const { AssetStreamer::m_idleWaiter = handle; }
+    void await_resume(void) const {}
+  };
+  static IdleAwaiter WaitForIdle(void) { return {}; }
+
+  static bool IsReading(void) { return m_state == StreamState::READING; }
+  static bool IsBusy(void) { return m_state != StreamState::IDLE || !m_queue.empty(); }
+  static uint8_t Pending(void) { return m_queue.size(); }
+  static uint32_t LastParseTime(void) { return m_lastParseTime; }
+
+private:
+  enum class StreamState : uint8_t { IDLE, READING, READ };
+
+  static psyqo::Coroutine<> ReadNext(void);
+  static void ParseCurrent(void);
+  static void Finish(bool success);
+
+  static eastl::fixed_vector<StreamRequest, MAX_STREAMING_REQUESTS, false> m_queue; // a heap, highest priority on top
+  static uint32_t m_nextSequence;
+
+  static StreamRequest m_current;
+  static StreamState m_state;
+  static bool m_isCancelled; // the read in flight is no longer wanted
+  static bool m_isCancelling;
+  static psyqo::Buffer<uint8_t> m_buffer;
+  static psyqo::Coroutine<> m_readRoutine;
+  static std::coroutine_handle<> m_idleWaiter;
+
+  // nested scenes put their files in here before they're queued up
+  static eastl::vector<LoadQueue> m_nested;
+
+  static uint8_t m_framesToSkip;
+  static uint32_t m_lastParseTime;
+};
+
+#endif
@@ -7,6 +7,7 @@
 #include "../render/colour.hh"
 #include "../render/renderer.hh"
 #include "../sound/sound_manager.hh"
+#include "asset_streamer.hh"
 #include "psyqo/alloc.h"
 #include "psyqo/xprintf.h"
 
@@ -39,6 +40,9 @@ void GameplayScene::frame() {
   if (deltaTime == 0)
     return;
 
+  // background loads. reads overlap the frame, at most one file gets parsed
+  AssetStreamer::Process();
+
   // process camera inputs
   m_camera->Process(deltaTime);
 
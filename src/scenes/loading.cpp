@@ -4,13 +4,17 @@
 #include "../mesh/colbin_manager.hh"
 #include "../mesh/mesh_manager.hh"
 #include "../core/object/gameobject_manager.hh"
+#include "../helpers/scene_arena.hh"
 #include "../render/renderer.hh"
 #include "../sound/sound_manager.hh"
-#include "../sound/mod_sound_manager.hh"
 #include "../textures/texture_manager.hh"
+#include "../textures/vram_allocator.hh"
 
 #include "EASTL/vector.h"
 #include "psyqo/fixed-point.hh"
+#include "psyqo/kernel.hh"
+#include "psyqo/xprintf.h"
+#include "asset_streamer.hh"
 #include "scene_loader.hh"
 
 void LoadingScene::start(StartReason reason) { Renderer::Instance().StartScene(); }
@@ -29,76 +33,129 @@ void LoadingScene::frame() {
 }
 
 psyqo::Coroutine<> LoadingScene::LoadFiles(eastl::vector<LoadQueue> &&files, bool dumpExisting) {
+	// background streaming is pointless if everything's about to be dumped
+	if (dumpExisting)
+		AssetStreamer::Cancel();
+
+	// a streamed read could still have the CD, so wait for it to land
+	co_await AssetStreamer::WaitForIdle();
+
 	// most likely we want to do this, but this will dump everything we know
 	// about meshes and textures, ready for a fresh scene
 	if (dumpExisting) {
 		GameObjectManager::Dump();
 		MeshManager::Dump();
+		AnimationManager::Dump();
 		TextureManager::Dump();
 		ColbinManager::Dump();
 		SoundManager::Dump();
+
+		// nothing points into the arena anymore, so it can all go at once
+		SceneArena::Reset();
 	}
 
 	m_queue = eastl::move(files);
+
+	// everything the managers allocate from here goes into the scene arena, sized for this queue
+	SceneArena::Open(SceneLoader::ArenaEstimate(m_queue));
+	SceneLoader::SortBySector(m_queue);
 	m_loadFilesLoadedCount = 0;
+	m_loadFilesReadCount = 0;
 	m_loadFilesCount = m_queue.size();
 
-	if (!m_queue.size())
+	if (!m_queue.size()) {
+		SceneArena::Close();
 		co_return;
+	}
 
-	// FIFO worklist - both the manifest (initial m_queue) and any nested scene's contents load in reverse order
-	// nothing in here should depend on each other existing, or, if they do, then put them backwards in the manifest
-	while (m_loadFilesLoadedCount != m_loadFilesCount) {
-		if (m_loadFilesLoadedCount >= m_queue.size()) {
-			printf("LOADER: index out of range, aborting.\n");
-			break;
-		}
-		
-		auto const &file = m_queue[m_loadFilesLoadedCount];
-
-		switch (file.type) {
-			case LoadFileType::OBJECT: {
-				MeshBin *mesh = nullptr;
-				co_await MeshManager::LoadMesh(file.name.c_str(), &mesh);
-				break;
-			}
-
-			case LoadFileType::TEXTURE: {
-				TimFile *tim = nullptr;
-				co_await TextureManager::LoadTIM(file.name.c_str(), file.x, file.y, file.clutX, file.clutY, &tim);
-				break;
-			}
-
-			case LoadFileType::MOD_FILE: {
-				ModSoundFile *modSound = nullptr;
-				co_await ModSoundManager::LoadMODSound(file.name.c_str(), &modSound);
-				break;
-			}
-
-			case LoadFileType::ANIMATION:
-				co_await AnimationManager::LoadAnimation(file.name.c_str());
-				break;
-
-			case LoadFileType::COLBIN: {
-				ColBin *colbin = nullptr;
-				co_await ColbinManager::LoadColbin(file.name, &colbin);
-				break;
-			}
-
-			case LoadFileType::VAG: {
-				VagEntry* vag = nullptr;
-				co_await SoundManager::LoadVAGFile(file.name, &vag);
-				break;
-			}
-
-			case LoadFileType::SCENE: {
-				auto before = m_queue.size();
-				co_await SceneLoader::LoadScene(file.name, m_queue);
-				m_loadFilesCount += m_queue.size() - before;
-				break;
-			}
+	auto &gpu = Renderer::Instance().GPU();
+	auto loadStart = gpu.now();
+	uint32_t totalReadTime = 0, totalParseTime = 0;
+
+	// the reader works through the queue on its own, this just parses whatever it's finished with
+	m_readRoutine = ReadAhead();
+	m_readRoutine.resume();
+
+	// FIFO worklist - the manifest (initial m_queue) and then any nested scene's contents, each in archive order
+	// nothing in here should depend on each other existing, the order they're listed in isn't the order they load
+	while (m_loadFilesLoadedCount < m_queue.size()) {
+		while (m_loadFilesLoadedCount >= m_loadFilesReadCount)
+			co_await WaitAwaiter{&m_parserWaiter};
+
+		// a copy, a nested scene grows the queue while it's parsed
+		auto &slot = m_readSlots[m_loadFilesLoadedCount % LOADING_READ_AHEAD];
+		auto const file = m_queue[m_loadFilesLoadedCount];
+
+		uint32_t parseTime = 0;
+		if (!slot.isResident) {
+			auto parseStart = gpu.now();
+			SceneLoader::ParseFile(file, eastl::move(slot.buffer), m_queue);
+			parseTime = gpu.now() - parseStart;
 		}
 
+		printf("LOADER: %s read in %dus, parsed in %dus.\n", file.name.c_str(), slot.readTime, parseTime);
+		totalReadTime += slot.readTime;
+		totalParseTime += parseTime;
+
+		m_loadFilesCount = m_queue.size();
 		m_loadFilesLoadedCount++;
+
+		// a buffer just came free, or there's more in the queue
+		if (m_readerWaiter) {
+			auto reader = m_readerWaiter;
+			m_readerWaiter = nullptr;
+			reader.resume();
+		}
 	}
+
+	auto loadTime = gpu.now() - loadStart;
+	auto busyTime = totalReadTime + totalParseTime;
+	printf("LOADER: Loaded %d files in %dms. Reading took %dms and parsing %dms, %dms of that overlapped.\n",
+		m_loadFilesCount, loadTime / 1000, totalReadTime / 1000, totalParseTime / 1000,
+		busyTime > loadTime ? (busyTime - loadTime) / 1000 : 0);
+	VRamAllocator::Report();
+
+	SceneArena::Close();
+}
+
+psyqo::Coroutine<> LoadingScene::ReadAhead(void) {
+	auto &gpu = Renderer::Instance().GPU();
+
+	while (true) {
+		// out of buffers, or caught up while a nested scene could still add more to the queue
+		while (m_loadFilesReadCount - m_loadFilesLoadedCount >= LOADING_READ_AHEAD ||
+			   (m_loadFilesReadCount == m_queue.size() && m_loadFilesLoadedCount < m_loadFilesReadCount))
+			co_await WaitAwaiter{&m_readerWaiter};
+
+		// everything's been read and parsed, nothing else can turn up
+		if (m_loadFilesReadCount == m_queue.size())
+			break;
+
+		auto &slot = m_readSlots[m_loadFilesReadCount % LOADING_READ_AHEAD];
+		const auto &file = m_queue[m_loadFilesReadCount];
+		slot.readTime = 0;
+		slot.isResident = SceneLoader::IsFileLoaded(file);
+
+		if (!slot.isResident) {
+			// a copy, the queue can be reallocated while we wait on the read
+			eastl::fixed_string<char, MAX_ARCHIVE_FILE_NAME_LEN> fileName = file.name;
+
+			auto readStart = gpu.now();
+			slot.buffer = co_await ArchiveHelper::LoadFile(fileName.c_str());
+			slot.readTime = gpu.now() - readStart;
+		}
+
+		m_loadFilesReadCount++;
+		WakeParser();
+	}
+}
+
+void LoadingScene::WakeParser(void) {
+	if (!m_parserWaiter)
+		return;
+
+	// resumed from the main loop rather than from in here, so the reader has its next read going before the parse starts
+	auto parser = m_parserWaiter;
+	m_parserWaiter = nullptr;
+	psyqo::Kernel::queueCallback([parser]() { parser.resume(); });
 }
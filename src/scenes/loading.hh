@@ -1,10 +1,16 @@
 #ifndef _LOADING_SCENE_H
 #define _LOADING_SCENE_H
 
+#include <coroutine>
+
 #include "../helpers/load_queue.hh"
+#include "psyqo/buffer.hh"
 #include "psyqo/coroutine.hh"
 #include "psyqo/scene.hh"
 
+// how many files can be read ahead of the one being parsed. each one holds a whole file in the heap until it's parsed
+static constexpr uint8_t LOADING_READ_AHEAD = 2;
+
 /*
  * this loading scene has been added for convenience.
  * it will automatically be called when you use
@@ -18,9 +24,34 @@ class LoadingScene final : public psyqo::Scene
     void start(StartReason reason) override;
     void frame() override;
 
+    // a file that's been read and is waiting to be parsed
+    struct ReadSlot {
+        psyqo::Buffer<uint8_t> buffer;
+        uint32_t readTime;
+        bool isResident; // already loaded, so it was never read
+    };
+
+    // suspends a coroutine until whoever owns the handle resumes it
+    struct WaitAwaiter {
+        std::coroutine_handle<> *waiter;
+        bool await_ready(void) const { return false; }
+        void await_suspend(std::coroutine_handle<> handle) const { *waiter = handle; }
+        void await_resume(void) const {}
+    };
+
+    psyqo::Coroutine<> ReadAhead(void);
+    void WakeParser(void);
+
     eastl::vector<LoadQueue> m_queue;
     uint16_t m_loadFilesCount = 0;
-    uint16_t m_loadFilesLoadedCount = 0;
+    uint16_t m_loadFilesLoadedCount = 0; // also the next file to parse
+
+    // the reader runs ahead of the parser, so the CD keeps going while a file is decoded or uploaded
+    ReadSlot m_readSlots[LOADING_READ_AHEAD];
+    uint16_t m_loadFilesReadCount = 0;
+    psyqo::Coroutine<> m_readRoutine;
+    std::coroutine_handle<> m_readerWaiter;
+    std::coroutine_handle<> m_parserWaiter;
 
 public:
     psyqo::Coroutine<> LoadFiles(eastl::vector<LoadQueue> &&files, bool dumpExisting);
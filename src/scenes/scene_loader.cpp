@@ -1,4 +1,11 @@
 #include "scene_loader.hh"
+#include "../animation/animation_manager.hh"
+#include "../mesh/colbin_manager.hh"
+#include "../mesh/mesh_manager.hh"
+#include "../sound/mod_sound_manager.hh"
+#include "../sound/sound_manager.hh"
+#include "../textures/texture_manager.hh"
+#include "../textures/vram_allocator.hh"
 #include "EASTL/fixed_string.h"
 #include "psyqo/xprintf.h"
 #include <cstdint>
@@ -6,13 +13,17 @@
 psyqo::Coroutine<> SceneLoader::LoadScene(const eastl::fixed_string<char, MAX_ARCHIVE_FILE_NAME_LEN> &sceneFile, eastl::vector<LoadQueue> &queue) {
     // load the file from the archive
     auto buffer = co_await ArchiveHelper::LoadFile(sceneFile.c_str());
+    ParseScene(eastl::move(buffer), queue);
+}
+
+bool SceneLoader::ParseScene(psyqo::Buffer<uint8_t> &&buffer, eastl::vector<LoadQueue> &queue) {
     uint8_t* data = buffer.data();
     size_t size = buffer.size();
 
     if (!data || !size) {
         buffer.clear();
         printf("SCENE: Failed to load file or it has no file size.\n");
-        co_return;
+        return false;
     }
 
     uint8_t* ptr = data;
@@ -22,8 +33,7 @@ psyqo::Coroutine<> SceneLoader::LoadScene(const eastl::fixed_string<char, MAX_AR
     if (magic.compare("SCENEBIN")) {
         printf("SCENE: Header magic is invalid, aborting.\n");
         buffer.clear();
-
-        co_return;
+        return false;
     }
     ptr += 8;
 
@@ -32,6 +42,7 @@ psyqo::Coroutine<> SceneLoader::LoadScene(const eastl::fixed_string<char, MAX_AR
     __builtin_memcpy(&fileCount, ptr, sizeof(uint8_t));
     ptr += sizeof(uint8_t);
 
+    auto firstFile = queue.size();
     for (int i = 0; i < fileCount; i++) {
         // file type
         uint8_t typeByte = 0;
@@ -47,7 +58,7 @@ psyqo::Coroutine<> SceneLoader::LoadScene(const eastl::fixed_string<char, MAX_AR
         if (nameLen > MAX_ARCHIVE_FILE_NAME_LEN) {
             printf("SCENE: Corrupt entry %d, name too long (%d).\n", i, nameLen);
             buffer.clear();
-            co_return;
+            return false;
         }
 
         // file name
@@ -76,6 +87,244 @@ psyqo::Coroutine<> SceneLoader::LoadScene(const eastl::fixed_string<char, MAX_AR
             queue.push_back({fileName.c_str(), type});
     }
 
+    // read them in the order they sit on the disc, not the order they were listed
+    SortBySector(queue, firstFile);
+
     buffer.clear();
     printf("SCENE: Successfully added %d files to the load queue.\n", queue.size());
+    return true;
+}
+
+bool SceneLoader::ParsePack(psyqo::Buffer<uint8_t> &&buffer, eastl::vector<LoadQueue> &queue) {
+    uint8_t* data = buffer.data();
+    size_t size = buffer.size();
+
+    if (!data || size < SCENEPAK_HEADER_SIZE) {
+        buffer.clear();
+        printf("SCENEPAK: Failed to load file or it's too small.\n");
+        return false;
+    }
+
+    uint8_t* ptr = data;
+
+    // magic check
+    eastl::fixed_string<char, 8> magic(reinterpret_cast<char*>(ptr), 8);
+    if (magic.compare("SCENEPAK")) {
+        printf("SCENEPAK: Header magic is invalid, aborting.\n");
+        buffer.clear();
+        return false;
+    }
+    ptr += 8;
+
+    // version + number of files
+    uint8_t version = *ptr++;
+    uint8_t fileCount = *ptr++;
+    if (version != SCENEPAK_VERSION) {
+        printf("SCENEPAK: Unsupported version %d, aborting.\n", version);
+        buffer.clear();
+        return false;
+    }
+
+    // skip the reserved bytes
+    ptr += sizeof(uint16_t);
+
+    uint8_t loadedCount = 0;
+    const uint8_t* end = data + size;
+    for (int i = 0; i < fileCount; i++) {
+        LoadQueue file = {};
+
+        // type(1) + nameLen(1)
+        if (ptr + 2 > end) {
+            printf("SCENEPAK: Corrupt entry %d, the index is cut short.\n", i);
+            break;
+        }
+
+        file.type = static_cast<LoadFileType>(*ptr++);
+
+        uint8_t nameLen = *ptr++;
+        if (nameLen > MAX_ARCHIVE_FILE_NAME_LEN || ptr + nameLen > end) {
+            printf("SCENEPAK: Corrupt entry %d, bad name length (%d).\n", i, nameLen);
+            break;
+        }
+
+        file.name.assign(reinterpret_cast<char*>(ptr), nameLen);
+        ptr += nameLen;
+
+        // texture placement(8) + offset(4) + size(4)
+        if (ptr + (file.type == TEXTURE ? 8 : 0) + sizeof(uint32_t) * 2 > end) {
+            printf("SCENEPAK: Corrupt entry %d (%s), the index is cut short.\n", i, file.name.c_str());
+            break;
+        }
+
+        // same texture placement as a SCENEBIN entry
+        if (file.type == TEXTURE) {
+            __builtin_memcpy(&file.x, ptr, sizeof(uint16_t));
+            ptr += sizeof(uint16_t);
+
+            __builtin_memcpy(&file.y, ptr, sizeof(uint16_t));
+            ptr += sizeof(uint16_t);
+
+            __builtin_memcpy(&file.clutX, ptr, sizeof(uint16_t));
+            ptr += sizeof(uint16_t);
+
+            __builtin_memcpy(&file.clutY, ptr, sizeof(uint16_t));
+            ptr += sizeof(uint16_t);
+        }
+
+        // where the file's data is in the pack
+        uint32_t offset = 0, fileSize = 0;
+        __builtin_memcpy(&offset, ptr, sizeof(uint32_t));
+        ptr += sizeof(uint32_t);
+
+        __builtin_memcpy(&fileSize, ptr, sizeof(uint32_t));
+        ptr += sizeof(uint32_t);
+
+        if (offset > size || fileSize > size - offset) {
+            printf("SCENEPAK: Corrupt entry %d (%s), data is out of range.\n", i, file.name.c_str());
+            break;
+        }
+
+        if (IsFileLoaded(file)) {
+            loadedCount++;
+            continue;
+        }
+
+        // the managers take ownership of what they're given, so each file gets its own copy
+        psyqo::Buffer<uint8_t> fileBuffer(fileSize);
+        if (fileSize && !fileBuffer.data()) {
+            printf("SCENEPAK: Out of memory copying %s (%d bytes).\n", file.name.c_str(), fileSize);
+            break;
+        }
+
+        __builtin_memcpy(fileBuffer.data(), data + offset, fileSize);
+
+        if (ParseFile(file, eastl::move(fileBuffer), queue))
+            loadedCount++;
+    }
+
+    buffer.clear();
+    printf("SCENEPAK: Loaded %d of %d files from a %d byte pack.\n", loadedCount, fileCount, size);
+    return loadedCount == fileCount;
+}
+
+bool SceneLoader::ParseFile(const LoadQueue &file, psyqo::Buffer<uint8_t> &&buffer, eastl::vector<LoadQueue> &queue) {
+    switch (file.type) {
+        case LoadFileType::OBJECT:
+            return MeshManager::ParseMesh(file.name.c_str(), eastl::move(buffer)) != nullptr;
+
+        case LoadFileType::TEXTURE:
+            return TextureManager::ParseTIM(file.name.c_str(), file.x, file.y, file.clutX, file.clutY, eastl::move(buffer)) != nullptr;
+
+        case LoadFileType::MOD_FILE:
+            return ModSoundManager::ParseMODSound(file.name.c_str(), eastl::move(buffer)) != nullptr;
+
+        case LoadFileType::ANIMATION:
+            return AnimationManager::ParseAnimation(file.name.c_str(), eastl::move(buffer));
+
+        case LoadFileType::COLBIN:
+            return ColbinManager::ParseColbin(eastl::move(buffer)) != nullptr;
+
+        case LoadFileType::VAG:
+            return SoundManager::ParseVAGFile(file.name, eastl::move(buffer)) != nullptr;
+
+        case LoadFileType::SCENE_PACK:
+            return ParsePack(eastl::move(buffer), queue);
+
+        case LoadFileType::SCENE:
+            return ParseScene(eastl::move(buffer), queue);
+    }
+
+    printf("SCENE: Unknown file type %d for %s.\n", file.type, file.name.c_str());
+    buffer.clear();
+    return false;
+}
+
+bool SceneLoader::IsFileLoaded(const LoadQueue &file) {
+    switch (file.type) {
+        case LoadFileType::OBJECT: {
+            MeshBin *mesh = nullptr;
+            MeshManager::GetMeshFromName(file.name.c_str(), &mesh);
+            return mesh != nullptr;
+        }
+
+        case LoadFileType::TEXTURE: {
+            TimFile *tim = nullptr;
+            TextureManager::GetTextureFromName(file.name.c_str(), &tim);
+            return tim != nullptr && tim->isResident;
+        }
+
+        case LoadFileType::VAG:
+            return SoundManager::IsVAGLoaded(file.name) != nullptr;
+
+        // animations take a reference when they're loaded again, and the rest are always replaced
+        default:
+            return false;
+    }
+}
+
+uint32_t SceneLoader::ArenaEstimate(const eastl::vector<LoadQueue> &queue) {
+    uint32_t size = 0;
+    for (const auto &file : queue) {
+        switch (file.type) {
+            // collision is unpacked into arrays about the size of the file
+            case LoadFileType::COLBIN:
+                size += ArchiveHelper::FileSize(file.name.c_str());
+                break;
+
+            // keys are unpacked to a fixed size, which is about twice what the file stores
+            case LoadFileType::ANIMATION:
+                size += ArchiveHelper::FileSize(file.name.c_str()) * 2;
+                break;
+
+            // v4 and later meshes stay in their read buffer, which is everything the exporter writes. only a
+            // skinned one's skeleton goes in the arena, and which ones are skinned isn't known until they're read.
+            // so meshes aren't counted, and skeletons and older meshes go on the heap if the block runs out
+            case LoadFileType::OBJECT:
+                break;
+
+            // textures and sounds go to vram and spu ram. nested scenes and packs aren't known
+            // until they're read, so whatever they hold that doesn't fit goes on the heap
+            default:
+                break;
+        }
+    }
+
+    return size;
+}
+
+void SceneLoader::SortBySector(eastl::vector<LoadQueue> &queue, size_t first) {
+    if (queue.size() - first < 2)
+        return;
+
+    // hand placed textures go first, so their pages are reserved before the vram allocator packs anything.
+    // the rest go in archive order after them
+    eastl::vector<uint64_t> keys;
+    keys.reserve(queue.size() - first);
+    for (size_t i = first; i < queue.size(); i++) {
+        uint64_t isPacked = !IsHandPlaced(queue[i]);
+        keys.push_back(isPacked << 32 | ArchiveHelper::FileSector(queue[i].name.c_str()));
+    }
+
+    // insertion sort. it's stable, so missing files keep their order at the end, and an
+    // archive laid out by archive_layout.py is already in order so this is one pass
+    for (size_t i = 1; i < keys.size(); i++) {
+        if (keys[i - 1] <= keys[i])
+            continue;
+
+        auto key = keys[i];
+        auto file = eastl::move(queue[first + i]);
+
+        size_t j = i;
+        for (; j > 0 && keys[j - 1] > key; j--) {
+            keys[j] = keys[j - 1];
+            queue[first + j] = eastl::move(queue[first + j - 1]);
+        }
+
+        keys[j] = key;
+        queue[first + j] = eastl::move(file);
+    }
+}
+
+bool SceneLoader::IsHandPlaced(const LoadQueue &file) {
+    return file.type == LoadFileType::TEXTURE && file.x != VRAM_AUTO_PLACE && file.y != VRAM_AUTO_PLACE;
 }
@@ -1,11 +1,36 @@
 #pragma once
 #include "../helpers/archive.hh"
 #include "../helpers/load_queue.hh"
+#include "psyqo/buffer.hh"
 #include "psyqo/coroutine.hh"
 #include "EASTL/vector.h"
 
+static constexpr uint8_t SCENEPAK_VERSION = 1;
+static constexpr uint8_t SCENEPAK_HEADER_SIZE = 12;
+
 class SceneLoader final {
 public:
     static psyqo::Coroutine<> LoadScene(const eastl::fixed_string<char, MAX_ARCHIVE_FILE_NAME_LEN>& sceneFile, eastl::vector<LoadQueue> &queue);
+
+    // the synchronous half of LoadScene, for a file that has already been read. takes ownership of the buffer
+    static bool ParseScene(psyqo::Buffer<uint8_t> &&buffer, eastl::vector<LoadQueue> &queue);
+
+    // a SCENEPAK holds every file a scene needs, so the whole scene is one read. each file goes to its manager from memory
+    static bool ParsePack(psyqo::Buffer<uint8_t> &&buffer, eastl::vector<LoadQueue> &queue);
+
+    // hands an already read file to whichever manager owns its type. nested scenes add their files to the queue
+    static bool ParseFile(const LoadQueue &file, psyqo::Buffer<uint8_t> &&buffer, eastl::vector<LoadQueue> &queue);
+
+    // true if there's no point reading the file, because parsing it would just hand back what's already loaded
+    static bool IsFileLoaded(const LoadQueue &file);
+
+    // puts queue[first..] into archive order so the CD head only ever moves forwards, after any hand placed textures
+    static void SortBySector(eastl::vector<LoadQueue> &queue, size_t first = 0);
+
+    // a texture with fixed vram coordinates, which has to be reserved before anything is packed around it
+    static bool IsHandPlaced(const LoadQueue &file);
+
+    // a rough idea of how much of the queue ends up in the scene arena, from the sizes in the archive
+    static uint32_t ArenaEstimate(const eastl::vector<LoadQueue> &queue);
 private:
 };
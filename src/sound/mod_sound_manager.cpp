@@ -13,6 +13,11 @@ psyqo::Coroutine<> ModSoundManager::LoadMODSound(const char *modSoundFileName, M
 
     // ok checks passed, get it off the CD
     auto buffer = co_await ArchiveHelper::LoadFile(modSoundFileName);
+    *modSoundFileOut = ParseMODSound(modSoundFileName, eastl::move(buffer));
+}
+
+ModSoundFile *ModSoundManager::ParseMODSound(const char *modSoundFileName, psyqo::Buffer<uint8_t> &&buffer)
+{
     void *data = buffer.data();
     size_t size = buffer.size();
 
@@ -20,7 +25,7 @@ psyqo::Coroutine<> ModSoundManager::LoadMODSound(const char *modSoundFileName, M
     {
         printf("SOUND: Failed to load MOD file or it has no file size.\n");
         buffer.clear();
-        co_return;
+        return nullptr;
     }
 
     ModSoundFile soundFile = {modSoundFileName, 0, false};
@@ -28,19 +33,22 @@ psyqo::Coroutine<> ModSoundManager::LoadMODSound(const char *modSoundFileName, M
     // load the data into the SPU
     soundFile.size = MOD_Load((MODFileFormat *)data);
     if (soundFile.size == 0)
-        co_return;
+    {
+        buffer.clear();
+        return nullptr;
+    }
 
     // loaded
     soundFile.isLoaded = true;
 
     // put into our array/library/whatever you wanna call it
     m_currentSoundFile = soundFile;
-    *modSoundFileOut = &m_currentSoundFile;
 
     // done with the data, clear it
     buffer.clear();
 
     printf("SOUND: Successfully loaded MOD file of %d bytes into SPU.\n", size);
+    return &m_currentSoundFile;
 }
 
 void ModSoundManager::PlaySoundEffect(uint32_t channel, uint32_t sampleID, int32_t pitch, uint32_t volume)
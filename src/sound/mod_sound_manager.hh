@@ -3,6 +3,7 @@
 
 #include <EASTL/array.h>
 #include "mod_sound.hh"
+#include "psyqo/buffer.hh"
 #include "psyqo/coroutine.hh"
 
 static constexpr uint16_t MAX_MUSIC_VOLUME = 65535;
@@ -23,6 +24,8 @@ public:
     // this will give back some basic info about the loaded file incase you feel it is relevant
     // if it comes back as nullptr then something probably went wrong
     static psyqo::Coroutine<> LoadMODSound(const char *modSoundFileName, ModSoundFile **modSoundFileOut);
+    // the synchronous half of LoadMODSound, for a file that has already been read. takes ownership of the buffer
+    static ModSoundFile *ParseMODSound(const char *modSoundFileName, psyqo::Buffer<uint8_t> &&buffer);
     // not really important but added for convenience
     static const ModSoundFile *CurrentMODSoundFile(void) { return &m_currentSoundFile; }
 
@@ -33,13 +33,28 @@ psyqo::Coroutine<> SoundManager::LoadVAGFile(const eastl::fixed_string<char, MAX
 
     // get the actual data off the cd and make sure its valid
     auto buffer = co_await ArchiveHelper::LoadFile(fileName.c_str());
+    auto vag = ParseVAGFile(fileName, eastl::move(buffer));
+    if (out) *out = vag;
+}
+
+VagEntry* SoundManager::ParseVAGFile(const eastl::fixed_string<char, MAX_ARCHIVE_FILE_NAME_LEN>& fileName, psyqo::Buffer<uint8_t> &&buffer) {
+    if (!m_isInitialized)
+        Init();
+
     void *data = buffer.data();
     size_t size = buffer.size();
 
     if (!data || !size) {
         buffer.clear();
         printf("VAG: Failed to load VAG or it has no file size.\n");
-        co_return;
+        return nullptr;
+    }
+
+    // something else could have uploaded it while we waited on the read
+    auto existingVag = IsVAGLoaded(fileName);
+    if (existingVag) {
+        buffer.clear();
+        return existingVag;
     }
 
     // begin loading data
@@ -54,7 +69,7 @@ psyqo::Coroutine<> SoundManager::LoadVAGFile(const eastl::fixed_string<char, MAX
     if (magic.compare("VAGp")) {
         printf("VAG: Header magic is invalid, aborting.\n");
         buffer.clear();
-        co_return;
+        return nullptr;
     }
     ptr += 4;
 
@@ -64,7 +79,7 @@ psyqo::Coroutine<> SoundManager::LoadVAGFile(const eastl::fixed_string<char, MAX
     if (SWAP32(version) != 0x00000020) {
         printf("VAG: Header version is invalid, aborting.\n");
         buffer.clear();
-        co_return;
+        return nullptr;
     }
     ptr += sizeof(uint32_t);
 
@@ -80,7 +95,7 @@ psyqo::Coroutine<> SoundManager::LoadVAGFile(const eastl::fixed_string<char, MAX
     if (SPU_MEMORY_SIZE - m_spuAllocPtr < vag.size) {
         printf("VAG: Not enough space in SPU, aborting.\n");
         buffer.clear();
-        co_return;
+        return nullptr;
     }
 
     // store the pitch based off of sample rate
@@ -102,11 +117,11 @@ psyqo::Coroutine<> SoundManager::LoadVAGFile(const eastl::fixed_string<char, MAX
 
     // all done?
     m_vagFiles.push_back(vag);
-    if (out) *out = &m_vagFiles.back();
 
     // dump it from memory
     buffer.clear();
     printf("VAG: Successfully uploaded VAG of %d bytes into the SPU.\n", size);
+    return &m_vagFiles.back();
 }
 
 VagEntry* SoundManager::IsVAGLoaded(const eastl::fixed_string<char, MAX_ARCHIVE_FILE_NAME_LEN>& fileName) {
@@ -3,6 +3,7 @@
 #include "EASTL/fixed_string.h"
 #include "../helpers/archive.hh"
 #include "EASTL/fixed_vector.h"
+#include "psyqo/buffer.hh"
 #include "psyqo/coroutine.hh"
 #include "psyqo/spu.hh"
 #include <cstdint>
@@ -32,6 +33,8 @@ public:
     // resets the spuAllocPtr to initial, but doesn't clear anything from spu
     static void Dump(void);
     static psyqo::Coroutine<> LoadVAGFile(const eastl::fixed_string<char, MAX_ARCHIVE_FILE_NAME_LEN>& fileName, VagEntry** out);
+    // the synchronous half of LoadVAGFile, for a file that has already been read. takes ownership of the buffer
+    static VagEntry* ParseVAGFile(const eastl::fixed_string<char, MAX_ARCHIVE_FILE_NAME_LEN>& fileName, psyqo::Buffer<uint8_t> &&buffer);
     static VagEntry* IsVAGLoaded(const eastl::fixed_string<char, MAX_ARCHIVE_FILE_NAME_LEN>& fileName);
     static VagEntry* IsVAGLoaded(const uint8_t& fileName);
     static void SilenceChannels(const uint32_t channels);
@@ -0,0 +1,179 @@
+#include "texture_compression.hh"
+#include "psyqo/xprintf.h"
+
+/*
+ * both formats are byte oriented so the decoders are a handful of loads and stores per byte
+ * with no tables to build, which is about as good as the r3000 gets without a cache to lean on.
+ *
+ * rle: a control byte, then
+ * - 0-127: that many + 1 bytes copied as they are
+ * - 128-255: the next byte repeated (control - 126) times, so 2-129
+ *
+ * lz: sequences of a token, literals, then a match. the token's top 4 bits are the literal
+ * count and the bottom 4 are the match length - 4. either one being 15 means it carries on
+ * in the bytes after it, adding each one until a byte isn't 255. the literals come next, then a
+ * 16-bit little endian offset back into what's been written so far, which the match copies
+ * from. the last sequence stops after its literals.
+ */
+
+bool TextureDecompressor::IsCompressed(const uint8_t *data, uint32_t size)
+{
+    if (data == nullptr || size < TIMZ_HEADER_SIZE)
+        return false;
+
+    return (data[0] | data[1] << 8 | data[2] << 16 | uint32_t(data[3]) << 24) == TIMZ_MAGIC;
+}
+
+psyqo::Buffer<uint8_t> TextureDecompressor::Decompress(psyqo::Buffer<uint8_t> &&buffer)
+{
+    const uint8_t *data = buffer.data();
+    uint32_t size = buffer.size();
+
+    if (!IsCompressed(data, size) || data[4] != TIMZ_VERSION)
+    {
+        printf("TEXTURE: Not a TIMZ file or the wrong version, aborting.\n");
+        buffer.clear();
+        return psyqo::Buffer<uint8_t>{};
+    }
+
+    auto method = TextureCompression(data[5]);
+    uint32_t rawSize = data[8] | data[9] << 8 | data[10] << 16 | uint32_t(data[11]) << 24;
+    const uint8_t *src = data + TIMZ_HEADER_SIZE;
+    uint32_t srcSize = size - TIMZ_HEADER_SIZE;
+
+    // the tim is uploaded straight out of this, so it's the dma staging buffer as well
+    psyqo::Buffer<uint8_t> out(rawSize);
+    if (out.data() == nullptr)
+    {
+        printf("TEXTURE: No memory to unpack a %d byte texture, aborting.\n", rawSize);
+        buffer.clear();
+        return psyqo::Buffer<uint8_t>{};
+    }
+
+    bool isValid = false;
+    switch (method)
+    {
+    case TextureCompression::NONE:
+        isValid = srcSize >= rawSize;
+        if (isValid)
+            __builtin_memcpy(out.data(), src, rawSize);
+        break;
+    case TextureCompression::RLE:
+        isValid = DecompressRLE(src, srcSize, out.data(), rawSize);
+        break;
+    case TextureCompression::LZ:
+        isValid = DecompressLZ(src, srcSize, out.data(), rawSize);
+        break;
+    }
+
+    buffer.clear();
+    if (!isValid)
+    {
+        printf("TEXTURE: Compressed texture data is broken (method %d), aborting.\n", (int)method);
+        out.clear();
+    }
+
+    return out;
+}
+
+bool TextureDecompressor::DecompressRLE(const uint8_t *src, uint32_t srcSize, uint8_t *dst, uint32_t dstSize)
+{
+    const uint8_t *srcEnd = src + srcSize;
+    uint8_t *dstEnd = dst + dstSize;
+
+    while (dst < dstEnd)
+    {
+        if (src >= srcEnd)
+            return false;
+
+        uint8_t control = *src++;
+        if (control < 128)
+        {
+            uint32_t count = control + 1;
+            if (src + count > srcEnd || dst + count > dstEnd)
+                return false;
+
+            while (count--)
+                *dst++ = *src++;
+        }
+        else
+        {
+            uint32_t count = control - 126;
+            if (src >= srcEnd || dst + count > dstEnd)
+                return false;
+
+            uint8_t value = *src++;
+            while (count--)
+                *dst++ = value;
+        }
+    }
+
+    return true;
+}
+
+bool TextureDecompressor::DecompressLZ(const uint8_t *src, uint32_t srcSize, uint8_t *dst, uint32_t dstSize)
+{
+    const uint8_t *srcEnd = src + srcSize;
+    uint8_t *dstStart = dst;
+    uint8_t *dstEnd = dst + dstSize;
+
+    while (dst < dstEnd)
+    {
+        if (src >= srcEnd)
+            return false;
+
+        uint8_t token = *src++;
+
+        uint32_t literals = token >> 4;
+        if (literals == 15)
+        {
+            uint8_t extra;
+            do
+            {
+                if (src >= srcEnd)
+                    return false;
+                extra = *src++;
+                literals += extra;
+            } while (extra == 255);
+        }
+
+        if (src + literals > srcEnd || dst + literals > dstEnd)
+            return false;
+
+        while (literals--)
+            *dst++ = *src++;
+
+        // the last sequence is only literals
+        if (dst == dstEnd)
+            break;
+
+        if (src + 2 > srcEnd)
+            return false;
+
+        uint16_t offset = src[0] | src[1] << 8;
+        src += 2;
+
+        uint32_t length = (token & 0xf) + 4;
+        if ((token & 0xf) == 15)
+        {
+            uint8_t extra;
+            do
+            {
+                if (src >= srcEnd)
+                    return false;
+                extra = *src++;
+                length += extra;
+            } while (extra == 255);
+        }
+
+        if (offset == 0 || offset > dst - dstStart || dst + length > dstEnd)
+            return false;
+
+        // byte at a time, so a match can run into the bytes it's writing (an offset of 1 is a run)
+        const uint8_t *match = dst - offset;
+        while (length--)
+            *dst++ = *match++;
+    }
+
+    return true;
+}
@@ -0,0 +1,33 @@
+#ifndef _TEXTURE_COMPRESSION_H
+#define _TEXTURE_COMPRESSION_H
+
+#include <stdint.h>
+#include "psyqo/buffer.hh"
+
+// a tim wrapped in a "TIMZ" header and compressed on its own. see tools/TIMZ.md
+static constexpr uint32_t TIMZ_MAGIC = 0x5A4D4954; // "TIMZ" read as a little endian word
+static constexpr uint8_t TIMZ_VERSION = 1;
+static constexpr uint8_t TIMZ_HEADER_SIZE = 12;
+
+enum class TextureCompression : uint8_t
+{
+    NONE, // stored as is, for textures that don't get any smaller
+    RLE,  // runs of the same byte. cheap, and good for flat indexed art
+    LZ,   // lz4 style matches. slower than rle but catches repeated patterns too
+};
+
+class TextureDecompressor final
+{
+public:
+    static bool IsCompressed(const uint8_t *data, uint32_t size);
+
+    // unpack a TIMZ into a buffer holding the plain tim, ready to upload to vram straight out of.
+    // gives back an empty buffer if the file is broken
+    static psyqo::Buffer<uint8_t> Decompress(psyqo::Buffer<uint8_t> &&buffer);
+
+private:
+    static bool DecompressRLE(const uint8_t *src, uint32_t srcSize, uint8_t *dst, uint32_t dstSize);
+    static bool DecompressLZ(const uint8_t *src, uint32_t srcSize, uint8_t *dst, uint32_t dstSize);
+};
+
+#endif
@@ -1,8 +1,12 @@
 #include "texture_manager.hh"
-#include "psyqo/alloc.h"
+#include "texture_compression.hh"
+#include "vram_allocator.hh"
+#include <EASTL/algorithm.h>
 #include "psyqo/xprintf.h"
 #include "../helpers/archive.hh"
+#include "../helpers/hash.hh"
 #include "../render/renderer.hh"
+#include "../scenes/asset_streamer.hh"
 
 /*
  * ok so this is confusing as hell and we have to manage VRAM ourself which is wild.
@@ -39,26 +43,34 @@
  */
 
 eastl::array<TimFile, MAX_TEXTURES> TextureManager::m_textures;
+eastl::array<ClutSlot, MAX_CLUTS> TextureManager::m_cluts;
+eastl::fixed_vector<TextureManager::SlicedUpload, MAX_SLICED_UPLOADS, false> TextureManager::m_uploads;
+bool TextureManager::m_isSlicingUploads = false;
+eastl::array<uint32_t, MAX_TEXTURES> TextureManager::m_lastUsed;
+uint32_t TextureManager::m_frame = 0;
 
 psyqo::Coroutine<> TextureManager::LoadTIM(const char *textureName, uint16_t x, uint16_t y, uint16_t clutX, uint16_t clutY, TimFile **timOut)
 {
     *timOut = nullptr;
 
     // is it already loaded?
-    TimFile *texture;
-    if ((texture = IsTextureLoaded(textureName)) != nullptr)
+    TimFile *texture = IsTextureLoaded(textureName);
+    if (texture != nullptr && texture->isResident)
     {
         *timOut = texture;
         co_return;
     }
 
-    // no its not. find space for it
-    int8_t freeIx = GetFreeIndex();
-    if (freeIx == -1)
+    // no its not. find space for it, unless it was evicted and still has its slot
+    if (texture == nullptr && GetFreeIndex() == -1)
         co_return;
 
     auto buffer = co_await ArchiveHelper::LoadFile(textureName);
+    *timOut = ParseTIM(textureName, x, y, clutX, clutY, eastl::move(buffer));
+}
 
+TimFile *TextureManager::ParseTIM(const char *textureName, uint16_t x, uint16_t y, uint16_t clutX, uint16_t clutY, psyqo::Buffer<uint8_t> &&buffer)
+{
     void *data = buffer.data();
     size_t size = buffer.size();
 
@@ -66,11 +78,39 @@ psyqo::Coroutine<> TextureManager::LoadTIM(const char *textureName, uint16_t x,
     {
         printf("TEXTURE: Failed to load texture or it has no file size.\n");
         buffer.clear();
-        co_return;
+        return nullptr;
+    }
+
+    // something else could have loaded it or taken the last slot while we waited on the read
+    TimFile *texture = IsTextureLoaded(textureName);
+    if (texture != nullptr && texture->isResident)
+    {
+        buffer.clear();
+        return texture;
+    }
+
+    // an evicted texture comes back into the slot it had, so anything pointing at it picks it up again
+    int8_t freeIx = texture != nullptr ? texture - m_textures.data() : GetFreeIndex();
+    if (freeIx == -1)
+    {
+        buffer.clear();
+        return nullptr;
+    }
+
+    // compressed textures are unpacked into a buffer of their own, and from then on it's a plain tim
+    if (TextureDecompressor::IsCompressed((const uint8_t *)data, size))
+    {
+        buffer = TextureDecompressor::Decompress(eastl::move(buffer));
+        data = buffer.data();
+        size = buffer.size();
+        if (data == nullptr || size == 0)
+            return nullptr;
     }
 
     TimFile timFile = {"", 0};
     timFile.name = textureName;
+    timFile.isResident = true;
+    timFile.isReloadable = ArchiveHelper::FileSector(textureName) != NO_ARCHIVE_SECTOR;
     uint32_t *ptr = (uint32_t *)data;
 
     // check the header of the tim file
@@ -78,7 +118,7 @@ psyqo::Coroutine<> TextureManager::LoadTIM(const char *textureName, uint16_t x,
     {
         printf("TEXTURE: Invalid TIM file, aborting.\n");
         buffer.clear();
-        co_return;
+        return nullptr;
     }
 
     // read the bpp. flags is bits 0-2 bpp, 3 = has a clut
@@ -105,14 +145,21 @@ psyqo::Coroutine<> TextureManager::LoadTIM(const char *textureName, uint16_t x,
         // mark it as having a clut
         timFile.hasClut = true;
 
+        // the block length, then the clut x/y/w/h rect (3 lots of uint32_t)
+        const uint8_t *fileEnd = (const uint8_t *)data + size;
+        if ((const uint8_t *)(ptr + 3) > fileEnd)
+        {
+            printf("TEXTURE: CLUT is cut short, aborting.\n");
+            buffer.clear();
+            return nullptr;
+        }
+
         // read the clut data
-        uint32_t *clut_end = ptr;
-        clut_end += *(ptr++) / 4;
+        uint32_t clutLength = *(ptr++);
+        uint32_t *clut_end = ptr - 1;
 
         // clut x/y/w/h data
         uint16_t *rect = (uint16_t *)ptr;
-        timFile.clutX = clutX > 0 ? clutX : rect[0];
-        timFile.clutY = clutY >= 0 ? clutY : rect[1];
         timFile.clutWidth = rect[2];
         timFile.clutHeight = rect[3];
 
@@ -120,35 +167,100 @@ psyqo::Coroutine<> TextureManager::LoadTIM(const char *textureName, uint16_t x,
         ptr += 2;
 
         // data of the clut. number of colours (width * height entries, which are 2 bytes each)
-        uint16_t numColours = timFile.clutWidth * timFile.clutHeight;
-        uint16_t clutDataSize = numColours * sizeof(uint16_t);
-
-        // assign the clut data from the ptr
-        uint16_t *clutData = (uint16_t *)psyqo_malloc(clutDataSize);
-        __builtin_memcpy(clutData, ptr, clutDataSize);
+        uint32_t numColours = timFile.clutWidth * timFile.clutHeight;
+        uint32_t clutDataSize = numColours * sizeof(uint16_t);
+
+        // the colours have to be inside the block, and the block inside the file
+        if (numColours == 0 || clutLength < 12 + clutDataSize || clutLength > (uint32_t)(fileEnd - (const uint8_t *)clut_end))
+        {
+            printf("TEXTURE: CLUT is cut short, aborting.\n");
+            buffer.clear();
+            return nullptr;
+        }
+        clut_end += clutLength / 4;
+
+        // textures made from the same palette can all point at one copy of it in vram
+        uint32_t clutHash = HashBytes(ptr, clutDataSize);
+        ClutSlot *clutSlot = FindClut(clutHash, timFile.clutWidth, timFile.clutHeight, (const uint16_t *)ptr);
+        if (clutSlot != nullptr)
+        {
+            timFile.clutX = clutSlot->x;
+            timFile.clutY = clutSlot->y;
+            clutSlot->refCount++;
+            printf("TEXTURE: %s shares the CLUT at %d,%d.\n", textureName, timFile.clutX, timFile.clutY);
+        }
+        else
+        {
+            clutSlot = GetFreeClutSlot();
+            if (clutSlot == nullptr)
+            {
+                printf("TEXTURE: Too many CLUTs loaded, aborting.\n");
+                buffer.clear();
+                return nullptr;
+            }
+
+            // let the allocator find it a slot, or keep it out of the allocator's way
+            psyqo::Vertex clutPos;
+            if (clutX == VRAM_AUTO_PLACE || clutY == VRAM_AUTO_PLACE)
+            {
+                bool isAllocated;
+                while (!(isAllocated = VRamAllocator::AllocateClut(timFile.clutWidth, timFile.clutHeight, &clutPos)) && EvictLeastRecentlyUsed())
+                    ;
+
+                if (!isAllocated)
+                {
+                    printf("TEXTURE: No space for the CLUT, aborting.\n");
+                    buffer.clear();
+                    return nullptr;
+                }
+
+                timFile.clutX = clutPos.x;
+                timFile.clutY = clutPos.y;
+            }
+            else
+            {
+                timFile.clutX = clutX > 0 ? clutX : rect[0];
+                timFile.clutY = clutY >= 0 ? clutY : rect[1];
+                VRamAllocator::ReserveClut(timFile.clutX, timFile.clutY, timFile.clutWidth, timFile.clutHeight);
+
+                for (const auto &slot : m_cluts)
+                {
+                    if (slot.refCount > 0 && slot.x == timFile.clutX && slot.y == timFile.clutY)
+                        printf("TEXTURE: CLUT at %d,%d overwrites one that's still in use.\n", timFile.clutX, timFile.clutY);
+                }
+            }
+
+            *clutSlot = {clutHash, timFile.clutX, timFile.clutY, timFile.clutWidth, timFile.clutHeight, 1};
+
+            // keep the colours to check against before anything else shares it. no copy just means it won't be shared
+            clutSlot->palette = psyqo::Buffer<uint16_t>(static_cast<size_t>(numColours));
+            if (clutSlot->palette.data() != nullptr)
+                __builtin_memcpy(clutSlot->palette.data(), ptr, clutDataSize);
+
+            // upload this to the vram straight out of the file
+            Renderer::Instance().VRamUpload((const uint16_t *)ptr, timFile.clutX, timFile.clutY, timFile.clutWidth, timFile.clutHeight);
+        }
 
         // move pointer to the end of the clut block
         ptr = clut_end;
-
-        // upload this to the vram
-        Renderer::Instance().VRamUpload(clutData, timFile.clutX, timFile.clutY, timFile.clutWidth, timFile.clutHeight);
     }
 
-    uint32_t imageLength = *(ptr++);
     // bnum (4 bytes) + pos(4 bytes) + size(4 bytes)
     // should be more than 12 bytes as image data follows
+    uint32_t imageLength = (uint8_t *)(ptr + 3) <= (uint8_t *)data + size ? *ptr : 0;
+    ptr++;
     if (imageLength <= 12)
     {
         printf("TEXTURE: Image data seems to be missing from TIM, aborting.\n");
+        if (timFile.hasClut)
+            ReleaseClut(timFile.clutX, timFile.clutY);
         buffer.clear();
-        co_return;
+        return nullptr;
     }
 
     // first up is the rect (x, y, width, height)
     // dont forget to override x/y if provided
     uint16_t *rect = (uint16_t *)ptr;
-    timFile.x = x > 0 ? x : rect[0];
-    timFile.y = y >= 0 ? y : rect[1];
     timFile.width = rect[2];
     timFile.height = rect[3];
 
@@ -156,36 +268,91 @@ psyqo::Coroutine<> TextureManager::LoadTIM(const char *textureName, uint16_t x,
     ptr += 2;
 
     // get the image size (width * height pixels, each pixel is 2 bytes)
+    // the image goes to vram straight out of the file. the buffer and every block in a tim are word aligned so dma is happy
     uint32_t imageDataSize = timFile.width * timFile.height * sizeof(uint16_t);
-    uint16_t *imageData = (uint16_t *)psyqo_malloc(imageDataSize);
-    __builtin_memcpy(imageData, ptr, imageDataSize);
-
-    // go to end.. do we really need to do this though
-    ptr += imageDataSize / sizeof(uint32_t);
+    const uint16_t *imageData = (const uint16_t *)ptr;
 
     if (timFile.width == 0 || timFile.height == 0 || timFile.colourMode > psyqo::Prim::TPageAttr::ColorMode::Tex16Bits)
     {
         printf("TEXTURE: Texture has no width (%d)/height (%d)/bpp (%d), aborting.\n", timFile.width, timFile.height, timFile.colourMode);
+        if (timFile.hasClut)
+            ReleaseClut(timFile.clutX, timFile.clutY);
         buffer.clear();
-        co_return;
+        return nullptr;
+    }
+
+    if ((uint8_t *)imageData + imageDataSize > (uint8_t *)data + size)
+    {
+        printf("TEXTURE: Image data is cut short, aborting.\n");
+        if (timFile.hasClut)
+            ReleaseClut(timFile.clutX, timFile.clutY);
+        buffer.clear();
+        return nullptr;
+    }
+
+    // same again for the image itself
+    if (x == VRAM_AUTO_PLACE || y == VRAM_AUTO_PLACE)
+    {
+        // out of room, so make some out of whatever hasn't been drawn for the longest
+        psyqo::Vertex pos;
+        bool isAllocated;
+        while (!(isAllocated = VRamAllocator::AllocateTexture(timFile.colourMode, timFile.width, timFile.height, &pos)) && EvictLeastRecentlyUsed())
+            ;
+
+        if (!isAllocated)
+        {
+            printf("TEXTURE: No space in VRAM for %s, aborting.\n", textureName);
+            if (timFile.hasClut)
+                ReleaseClut(timFile.clutX, timFile.clutY);
+            buffer.clear();
+            return nullptr;
+        }
+
+        timFile.x = pos.x;
+        timFile.y = pos.y;
+    }
+    else
+    {
+        timFile.x = x > 0 ? x : rect[0];
+        timFile.y = y >= 0 ? y : rect[1];
+        if (!VRamAllocator::ReserveTexture(timFile.colourMode, timFile.x, timFile.y, timFile.width, timFile.height))
+        {
+            printf("TEXTURE: %s would overwrite packed textures, aborting.\n", textureName);
+            if (timFile.hasClut)
+                ReleaseClut(timFile.clutX, timFile.clutY);
+            buffer.clear();
+            return nullptr;
+        }
+    }
+
+    // big textures streamed in during gameplay go up a slice a frame, and the buffer has to live until they're done
+    if (m_isSlicingUploads && imageDataSize > TEXTURE_UPLOAD_SLICE_SIZE && !m_uploads.full())
+    {
+        timFile.isUploading = true;
+        m_textures[freeIx] = timFile;
+        m_lastUsed[freeIx] = m_frame;
+        LinkLods(freeIx);
+        m_uploads.push_back({eastl::move(buffer), imageData, &m_textures[freeIx], 0});
+
+        printf("TEXTURE: Uploading texture of %d bytes into VRAM in slices.\n", size);
+        return &m_textures[freeIx];
     }
 
     // upload it to the vram
     Renderer::Instance().VRamUpload(imageData, timFile.x, timFile.y, timFile.width, timFile.height);
 
-    // now its uploaded to ram we can free the image data back up
-    psyqo_free(imageData);
-
     // store this into our pool
     m_textures[freeIx] = timFile;
-
-    // give the ptr out correct data
-    *timOut = &m_textures[freeIx];
+    m_lastUsed[freeIx] = m_frame;
+    LinkLods(freeIx);
 
     // free data now we dont need it
     buffer.clear();
 
     printf("TEXTURE: Successfully loaded texture of %d bytes into VRAM.\n", size);
+
+    // give the ptr out correct data
+    return &m_textures[freeIx];
 }
 
 psyqo::PrimPieces::TPageAttr TextureManager::GetTPageAttr(const TimFile *tim)
@@ -207,14 +374,20 @@ psyqo::PrimPieces::TPageAttr TextureManager::GetTPageAttr(const TimFile &tim)
 psyqo::Rect TextureManager::GetTPageUVForTim(const TimFile &tim)
 {
     uint16_t tpageX = (tim.x / texturePageWidth) * texturePageWidth, tpageY = (tim.y / texturePageHeight) * texturePageHeight;
-    psyqo::Rect rect = {.pos{static_cast<int16_t>((tim.x - tpageX)), static_cast<int16_t>((tim.y - tpageY))}};
+
+    // x is in vram columns but u is in texels, and there's 2 or 4 texels to a column below 16-bit
+    uint8_t texelsPerColumn = tim.colourMode == psyqo::Prim::TPageAttr::ColorMode::Tex4Bits ? 4 : tim.colourMode == psyqo::Prim::TPageAttr::ColorMode::Tex8Bits ? 2 : 1;
+    psyqo::Rect rect = {.pos{static_cast<int16_t>((tim.x - tpageX) * texelsPerColumn), static_cast<int16_t>((tim.y - tpageY))}};
     return rect;
 }
 
 psyqo::Rect TextureManager::GetTPageUVForTim(const TimFile *tim)
 {
     uint16_t tpageX = (tim->x / texturePageWidth) * texturePageWidth, tpageY = (tim->y / texturePageHeight) * texturePageHeight;
-    psyqo::Rect rect = {.pos{static_cast<int16_t>((tim->x - tpageX)), static_cast<int16_t>((tim->y - tpageY))}};
+
+    // x is in vram columns but u is in texels, and there's 2 or 4 texels to a column below 16-bit
+    uint8_t texelsPerColumn = tim->colourMode == psyqo::Prim::TPageAttr::ColorMode::Tex4Bits ? 4 : tim->colourMode == psyqo::Prim::TPageAttr::ColorMode::Tex8Bits ? 2 : 1;
+    psyqo::Rect rect = {.pos{static_cast<int16_t>((tim->x - tpageX) * texelsPerColumn), static_cast<int16_t>((tim->y - tpageY))}};
     return rect;
 }
 
@@ -245,6 +418,252 @@ void TextureManager::GetTextureFromName(const char *textureName, TimFile **timFi
     *timFileOut = IsTextureLoaded(textureName);
 }
 
+void TextureManager::Process(void)
+{
+    m_frame++;
+
+    if (m_uploads.empty())
+        return;
+
+    // one slice of the oldest upload a frame. always an even number of rows so it's whole words
+    auto &upload = m_uploads.front();
+    TimFile *texture = upload.texture;
+
+    uint16_t sliceRows = (TEXTURE_UPLOAD_SLICE_SIZE / (texture->width * sizeof(uint16_t))) & ~1;
+    if (sliceRows == 0)
+        sliceRows = 2;
+
+    uint16_t rows = eastl::min<uint16_t>(sliceRows, texture->height - upload.nextRow);
+    Renderer::Instance().VRamUpload(upload.data + upload.nextRow * texture->width, texture->x, texture->y + upload.nextRow, texture->width, rows);
+    upload.nextRow += rows;
+
+    if (upload.nextRow < texture->height)
+        return;
+
+    texture->isUploading = false;
+    upload.buffer.clear();
+    m_uploads.erase(m_uploads.begin());
+}
+
+ClutSlot *TextureManager::FindClut(uint32_t hash, uint16_t width, uint16_t height, const uint16_t *palette)
+{
+    uint32_t numColours = width * height;
+    for (auto &slot : m_cluts)
+    {
+        if (slot.refCount == 0 || slot.hash != hash || slot.width != width || slot.height != height)
+            continue;
+
+        // same hash isn't the same palette, so check the colours before handing it out
+        if (slot.palette.size() == numColours && __builtin_memcmp(slot.palette.data(), palette, numColours * sizeof(uint16_t)) == 0)
+            return &slot;
+
+        printf("TEXTURE: CLUT hash collision at %d,%d, not sharing it.\n", slot.x, slot.y);
+    }
+
+    return nullptr;
+}
+
+ClutSlot *TextureManager::GetFreeClutSlot(void)
+{
+    for (auto &slot : m_cluts)
+    {
+        if (slot.refCount == 0)
+            return &slot;
+    }
+
+    return nullptr;
+}
+
+void TextureManager::ReleaseClut(uint16_t x, uint16_t y)
+{
+    for (auto &slot : m_cluts)
+    {
+        if (slot.refCount == 0 || slot.x != x || slot.y != y)
+            continue;
+
+        // last texture using it, so the space can go back to the allocator
+        if (--slot.refCount == 0)
+        {
+            VRamAllocator::FreeClut(slot.x, slot.y, slot.width, slot.height);
+            slot.palette.clear();
+        }
+        return;
+    }
+}
+
+void TextureManager::UnloadTIM(const char *textureName)
+{
+    TimFile *texture = IsTextureLoaded(textureName);
+    if (texture == nullptr)
+        return;
+
+    if (texture->isResident)
+        Evict(*texture);
+
+    // nothing can point at the slot as a variant any more, it might be something else next time
+    uint8_t link = texture - m_textures.data() + 1;
+    for (auto &other : m_textures)
+    {
+        for (auto &lod : other.lods)
+        {
+            if (lod == link)
+                lod = 0;
+        }
+    }
+
+    *texture = {"", 0};
+}
+
+const TimFile *TextureManager::DrawableLod(const TimFile *tim, uint8_t lod, uint8_t *shiftOut)
+{
+    *shiftOut = 0;
+    if (tim == nullptr)
+        return nullptr;
+
+    // the smallest variant that's loaded, up to the level asked for. anything that isn't drawable yet falls back to a bigger one
+    for (uint8_t level = eastl::min<uint8_t>(lod, TEXTURE_LOD_LEVELS - 1); level > 0; level--)
+    {
+        uint8_t link = tim->lods[level - 1];
+        if (link == 0)
+            continue;
+
+        const TimFile *variant = Drawable(&m_textures[link - 1]);
+        if (variant != nullptr)
+        {
+            *shiftOut = level;
+            return variant;
+        }
+    }
+
+    return Drawable(tim);
+}
+
+void TextureManager::LinkLods(uint8_t ix)
+{
+    // split the name into the bit before the extension and the extension. MAP.TIM -> MAP and .TIM
+    const auto &name = m_textures[ix].name;
+    auto dot = name.find_last_of('.');
+    if (dot == name.npos)
+        dot = name.size();
+
+    eastl::fixed_string<char, MAX_ARCHIVE_FILE_NAME_LEN> stem(name.substr(0, dot));
+    eastl::fixed_string<char, MAX_ARCHIVE_FILE_NAME_LEN> extension(name.substr(dot));
+
+    // a variant (MAP_L1.TIM) links itself to its full size texture
+    if (stem.size() > 3 && stem[stem.size() - 3] == '_' && stem[stem.size() - 2] == 'L')
+    {
+        uint8_t level = stem[stem.size() - 1] - '0';
+        if (level == 0 || level >= TEXTURE_LOD_LEVELS)
+            return;
+
+        stem.resize(stem.size() - 3);
+        stem += extension;
+
+        TimFile *base = IsTextureLoaded(stem.c_str());
+        if (base != nullptr)
+            base->lods[level - 1] = ix + 1;
+        return;
+    }
+
+    // and a full size texture picks up any variants loaded before it
+    for (uint8_t level = 1; level < TEXTURE_LOD_LEVELS; level++)
+    {
+        eastl::fixed_string<char, MAX_ARCHIVE_FILE_NAME_LEN> variantName(stem);
+        variantName += "_L";
+        variantName += char('0' + level);
+        variantName += extension;
+
+        TimFile *variant = IsTextureLoaded(variantName.c_str());
+        if (variant != nullptr)
+            m_textures[ix].lods[level - 1] = variant - m_textures.data() + 1;
+    }
+}
+
+const TimFile *TextureManager::Drawable(const TimFile *tim)
+{
+    if (tim == nullptr)
+        return nullptr;
+
+    uint8_t ix = tim - m_textures.data();
+    if (!tim->isResident)
+    {
+        Request(m_textures[ix]);
+        return nullptr;
+    }
+
+    m_lastUsed[ix] = m_frame;
+    return tim->isUploading ? nullptr : tim;
+}
+
+void TextureManager::Request(TimFile &texture)
+{
+    // keep asking after a read fails and the streamer fills up with requests that fail too
+    if (texture.isRequested || texture.failedRequests >= TEXTURE_MAX_FAILED_REQUESTS)
+        return;
+
+    // it goes wherever there's room now, where it was before has probably been taken
+    LoadQueue file = {texture.name, LoadFileType::TEXTURE};
+    file.x = file.y = file.clutX = file.clutY = VRAM_AUTO_PLACE;
+
+    texture.isRequested = AssetStreamer::Enqueue(file, StreamPriority::HIGH, [](const LoadQueue &loaded, bool success) {
+        // ask again next time it's drawn if this one didn't work out, up to a point
+        TimFile *texture = IsTextureLoaded(loaded.name.c_str());
+        if (texture == nullptr)
+            return;
+
+        texture->isRequested = false;
+        if (!success && ++texture->failedRequests == TEXTURE_MAX_FAILED_REQUESTS)
+            printf("TEXTURE: Giving up on bringing %s back, it's failed %d times.\n", texture->name.c_str(), texture->failedRequests);
+    });
+}
+
+bool TextureManager::EvictLeastRecentlyUsed(void)
+{
+    int8_t oldest = -1;
+    for (uint8_t i = 0; i < MAX_TEXTURES; i++)
+    {
+        const TimFile &texture = m_textures[i];
+        if (texture.name.empty() || !texture.isResident || texture.isUploading || !texture.isReloadable)
+            continue;
+
+        // anything drawn this frame or the last could still be in an ordering table
+        if (m_frame - m_lastUsed[i] < TEXTURE_EVICT_MIN_AGE)
+            continue;
+
+        if (oldest == -1 || m_lastUsed[i] < m_lastUsed[oldest])
+            oldest = i;
+    }
+
+    if (oldest == -1)
+        return false;
+
+    printf("TEXTURE: Evicting %s, it hasn't been drawn for %d frames.\n", m_textures[oldest].name.c_str(), m_frame - m_lastUsed[oldest]);
+    Evict(m_textures[oldest]);
+    return true;
+}
+
+void TextureManager::Evict(TimFile &texture)
+{
+    // stop uploading it if it's still going
+    for (auto it = m_uploads.begin(); it != m_uploads.end(); it++)
+    {
+        if (it->texture != &texture)
+            continue;
+
+        it->buffer.clear();
+        m_uploads.erase(it);
+        break;
+    }
+
+    VRamAllocator::FreeTexture(texture.x, texture.y, texture.width, texture.height);
+    if (texture.hasClut)
+        ReleaseClut(texture.clutX, texture.clutY);
+
+    // keeps its name and slot so anything pointing at it can ask for it back
+    texture.isResident = false;
+    texture.isUploading = false;
+}
+
 void TextureManager::Dump(void)
 {
     // clear out every instance of loaded_mesh, putting it back to zero
@@ -252,4 +671,18 @@ void TextureManager::Dump(void)
     {
         m_textures[i] = {"", 0};
     }
+
+    for (auto &slot : m_cluts)
+    {
+        slot.refCount = 0;
+        slot.palette.clear();
+    }
+
+    for (auto &upload : m_uploads)
+        upload.buffer.clear();
+    m_uploads.clear();
+
+    // and everything the allocator handed out. the font never gets dumped so it has to be reserved again
+    VRamAllocator::Reset();
+    Renderer::ReserveSystemFontVRam();
 }
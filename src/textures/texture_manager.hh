@@ -4,6 +4,8 @@
 #include <stdint.h>
 #include <EASTL/functional.h>
 #include <EASTL/fixed_string.h>
+#include <EASTL/fixed_vector.h>
+#include "psyqo/buffer.hh"
 #include "psyqo/coroutine.hh"
 #include "psyqo/primitives.hh"
 #include "../helpers/archive.hh"
@@ -12,6 +14,12 @@ static constexpr uint16_t texturePageWidth = 64;
 static constexpr uint16_t texturePageHeight = 256;
 static constexpr uint8_t texturePageColumns = 16;
 static constexpr uint8_t MAX_TEXTURES = 32; // this will need tweaking later
+static constexpr uint8_t MAX_CLUTS = MAX_TEXTURES;
+static constexpr uint32_t TEXTURE_UPLOAD_SLICE_SIZE = 8 * 1024; // bytes of a sliced upload sent to vram each frame
+static constexpr uint8_t MAX_SLICED_UPLOADS = 4;
+static constexpr uint8_t TEXTURE_LOD_LEVELS = 3; // the full size texture, then half and quarter size variants
+static constexpr uint8_t TEXTURE_EVICT_MIN_AGE = 2; // frames since a texture was last drawn before it can be evicted
+static constexpr uint8_t TEXTURE_MAX_FAILED_REQUESTS = 3; // an evicted texture stops asking to come back after this many failed reads
 
 typedef struct _TIM_FILE
 {
@@ -21,19 +29,81 @@ typedef struct _TIM_FILE
 
     bool hasClut;                   // does it need/have a clut?
     uint16_t clutX, clutY;          // clut pos in vram
-    uint16_t clutWidth, clutHeight; // clut width and height (always 1)
+    uint16_t clutWidth, clutHeight; // clut width and height (usually 1 row)
+
+    bool isUploading; // still going up to vram a slice at a time, so don't draw it yet
+    bool isResident;  // false once it's been evicted. it keeps its slot and comes back when it's next drawn
+    bool isRequested; // queued on the streamer to come back
+    bool isReloadable; // has its own entry in the archive. anything only in a SCENEPAK can't be read again, so it's never evicted
+    uint8_t failedRequests;
+
+    // reduced size variants, found by name (MAP.TIM has MAP_L1.TIM and MAP_L2.TIM). slot index + 1, 0 if not loaded
+    uint8_t lods[TEXTURE_LOD_LEVELS - 1];
 } TimFile;
 
+// a clut in vram, shared by every texture that has the same palette
+typedef struct _CLUT_SLOT
+{
+    uint32_t hash; // of the palette data
+    uint16_t x, y, width, height;
+    uint8_t refCount;                // free once this is 0
+    psyqo::Buffer<uint16_t> palette; // copy of the colours, so a hash collision can't share the wrong clut
+} ClutSlot;
+
 class TextureManager final
 {
     static psyqo::Vertex GetTPageIndex(uint16_t x, uint16_t y);
     static eastl::array<TimFile, MAX_TEXTURES> m_textures;
+    static eastl::array<ClutSlot, MAX_CLUTS> m_cluts;
 
     static int8_t GetFreeIndex(void);
     static TimFile *IsTextureLoaded(const char *name);
+    static void LinkLods(uint8_t ix);
+
+    // a texture going up to vram over several frames. holds on to the file it's uploading out of
+    struct SlicedUpload
+    {
+        psyqo::Buffer<uint8_t> buffer;
+        const uint16_t *data;
+        TimFile *texture;
+        uint16_t nextRow;
+    };
+    static eastl::fixed_vector<SlicedUpload, MAX_SLICED_UPLOADS, false> m_uploads;
+    static bool m_isSlicingUploads;
+
+    // the frame each texture was last drawn on, for picking what to evict
+    static eastl::array<uint32_t, MAX_TEXTURES> m_lastUsed;
+    static uint32_t m_frame;
+
+    static bool EvictLeastRecentlyUsed(void);
+    static void Evict(TimFile &texture);
+    static void Request(TimFile &texture);
+
+    static ClutSlot *FindClut(uint32_t hash, uint16_t width, uint16_t height, const uint16_t *palette);
+    static ClutSlot *GetFreeClutSlot(void);
+    static void ReleaseClut(uint16_t x, uint16_t y);
 
 public:
     static psyqo::Coroutine<> LoadTIM(const char *textureName, uint16_t x, uint16_t y, uint16_t clutX, uint16_t clutY, TimFile **timOut);
+
+    // the synchronous half of LoadTIM, for a file that has already been read. takes ownership of the buffer
+    static TimFile *ParseTIM(const char *textureName, uint16_t x, uint16_t y, uint16_t clutX, uint16_t clutY, psyqo::Buffer<uint8_t> &&buffer);
+
+    // textures parsed while this is on go up to vram a slice a frame instead of all at once
+    static void SetSlicedUploads(bool isSliced) { m_isSlicingUploads = isSliced; }
+
+    // call once a frame. ages the textures for eviction and sends the next slice of whatever is uploading
+    static void Process(void);
+    static bool IsUploading(void) { return !m_uploads.empty(); }
+
+    // the texture if it can be drawn, nullptr if it's not all in vram yet. draw untextured instead.
+    // marks it as used this frame, and if it's been evicted asks the streamer to bring it back
+    static const TimFile *Drawable(const TimFile *tim);
+
+    // same again, but swaps in the reduced size variant for a lod level if it's loaded.
+    // shiftOut is how far to shift the full size texture's uvs down to match it
+    static const TimFile *DrawableLod(const TimFile *tim, uint8_t lod, uint8_t *shiftOut);
+
     static psyqo::PrimPieces::TPageAttr GetTPageAttr(const TimFile *tim);
     static psyqo::PrimPieces::TPageAttr GetTPageAttr(const TimFile &tim);
     static psyqo::Rect GetTPageUVForTim(const TimFile &tim);
@@ -41,6 +111,9 @@ public:
 
     static void GetTextureFromName(const char *textureName, TimFile **timOut);
 
+    // forget a texture and give its vram back. its clut stays until nothing else is using it
+    static void UnloadTIM(const char *textureName);
+
     // dump all textures in memory and start fresh
     // this is used when switching to a loading screen for instance.
     // this is a dangerous function as it wont check if anything is used
@@ -0,0 +1,449 @@
+#include "vram_allocator.hh"
+#include <EASTL/algorithm.h>
+#include "psyqo/xprintf.h"
+
+/*
+ * texture pages are handed out as windows, one tpage worth of texels wide:
+ * 4-bit  = 1 page  (64 vram columns)
+ * 8-bit  = 2 pages (128 vram columns)
+ * 16-bit = 4 pages (256 vram columns)
+ *
+ * inside a window textures are put on shelves. a shelf is as tall as the texture that opened it
+ * and anything no taller can go next to it. a texture goes on the shelf it wastes the least height on,
+ * then a new shelf, and only then a new window.
+ *
+ * freeing gives space back when it's the last thing on its shelf, or when the window is empty.
+ * anything else is left as a hole until the window empties, which is what the fragmentation number counts.
+ */
+
+eastl::array<TexturePageWindow, MAX_TEXTURE_WINDOWS> VRamAllocator::m_windows;
+uint8_t VRamAllocator::m_pageOwner[TEXTURE_PAGE_ROWS][texturePageColumns];
+uint32_t VRamAllocator::m_clutRows[CLUT_ROWS];
+
+static constexpr uint8_t CLUT_SLOTS_PER_ROW = CLUT_AREA_WIDTH / CLUT_ALIGNMENT;
+
+bool VRamAllocator::AllocateTexture(psyqo::Prim::TPageAttr::ColorMode colourMode, uint16_t width, uint16_t height, psyqo::Vertex *out)
+{
+    uint8_t pageCount = PagesFor(colourMode);
+    uint16_t windowWidth = pageCount * texturePageWidth;
+
+    if (width == 0 || height == 0 || width > windowWidth || height > texturePageHeight)
+    {
+        printf("VRAM: A %dx%d texture can't fit in a texture page.\n", width, height);
+        return false;
+    }
+
+    // best fit on an existing shelf
+    int8_t bestWindow = -1, bestShelf = -1;
+    uint16_t bestWaste = texturePageHeight;
+    for (uint8_t i = 0; i < MAX_TEXTURE_WINDOWS; i++)
+    {
+        TexturePageWindow &window = m_windows[i];
+        if (!window.isInUse || window.isReserved || window.colourMode != colourMode)
+            continue;
+
+        for (uint8_t s = 0; s < window.shelves.size(); s++)
+        {
+            TexturePageShelf &shelf = window.shelves[s];
+            if (shelf.height < height || window.width - shelf.used < width)
+                continue;
+
+            if (shelf.height - height < bestWaste)
+            {
+                bestWaste = shelf.height - height;
+                bestWindow = i;
+                bestShelf = s;
+            }
+        }
+    }
+
+    // no room on a shelf, open a new one under the others
+    if (bestWindow == -1)
+    {
+        for (uint8_t i = 0; i < MAX_TEXTURE_WINDOWS; i++)
+        {
+            TexturePageWindow &window = m_windows[i];
+            if (!window.isInUse || window.isReserved || window.colourMode != colourMode)
+                continue;
+
+            if (window.shelfTop + height > texturePageHeight || window.shelves.full())
+                continue;
+
+            window.shelves.push_back({window.shelfTop, height, 0});
+            window.shelfTop += height;
+            bestWindow = i;
+            bestShelf = window.shelves.size() - 1;
+            break;
+        }
+    }
+
+    // no room in any window, claim some more pages
+    if (bestWindow == -1)
+    {
+        uint8_t row;
+        int8_t column = FindPages(pageCount, colourMode == psyqo::Prim::TPageAttr::ColorMode::Tex16Bits, &row);
+        if (column == -1)
+        {
+            printf("VRAM: Out of texture pages for a %dx%d texture.\n", width, height);
+            return false;
+        }
+
+        bestWindow = OpenWindow(colourMode, column, row, pageCount, false);
+        if (bestWindow == -1)
+            return false;
+
+        TexturePageWindow &window = m_windows[bestWindow];
+        window.shelves.push_back({0, height, 0});
+        window.shelfTop = height;
+        bestShelf = 0;
+    }
+
+    TexturePageWindow &window = m_windows[bestWindow];
+    TexturePageShelf &shelf = window.shelves[bestShelf];
+
+    out->x = window.x + shelf.used;
+    out->y = window.y + shelf.y;
+
+    shelf.used += width;
+    window.liveCount++;
+    window.usedArea += width * height;
+
+    return true;
+}
+
+void VRamAllocator::FreeTexture(uint16_t x, uint16_t y, uint16_t width, uint16_t height)
+{
+    int8_t windowIx = WindowAt(x, y);
+    if (windowIx == -1)
+        return;
+
+    if (m_windows[windowIx].isReserved)
+    {
+        // a hand placed texture can straddle several reserved pages, take its share off each one
+        for (uint8_t row = y / texturePageHeight; row <= (y + height - 1) / texturePageHeight && row < TEXTURE_PAGE_ROWS; row++)
+        {
+            for (uint8_t column = x / texturePageWidth; column <= (x + width - 1) / texturePageWidth && column < texturePageColumns; column++)
+            {
+                int8_t ix = m_pageOwner[row][column] - 1;
+                if (ix == -1 || !m_windows[ix].isReserved)
+                    continue;
+
+                uint16_t left = eastl::max<uint16_t>(x, column * texturePageWidth);
+                uint16_t right = eastl::min<uint16_t>(x + width, (column + 1) * texturePageWidth);
+                uint16_t top = eastl::max<uint16_t>(y, row * texturePageHeight);
+                uint16_t bottom = eastl::min<uint16_t>(y + height, (row + 1) * texturePageHeight);
+
+                TexturePageWindow &window = m_windows[ix];
+                window.usedArea -= (right - left) * (bottom - top);
+                if (--window.liveCount == 0)
+                    CloseWindow(ix);
+            }
+        }
+
+        return;
+    }
+
+    TexturePageWindow &window = m_windows[windowIx];
+
+    // only something this window handed out sits inside a shelf. anything else isn't counted in it
+    int8_t shelfIx = -1;
+    for (uint8_t s = 0; s < window.shelves.size(); s++)
+    {
+        const TexturePageShelf &shelf = window.shelves[s];
+        if (window.y + shelf.y == y && height <= shelf.height && x >= window.x && x + width <= window.x + shelf.used)
+        {
+            shelfIx = s;
+            break;
+        }
+    }
+
+    if (shelfIx == -1)
+    {
+        printf("VRAM: %dx%d at %d,%d wasn't packed into the window at %d,%d, leaving it alone.\n", width, height, x, y, window.x, window.y);
+        return;
+    }
+
+    // give the space back if it was the last thing put on its shelf
+    TexturePageShelf &shelf = window.shelves[shelfIx];
+    if (window.x + shelf.used == x + width)
+        shelf.used -= width;
+
+    // and the shelf itself if it's the bottom one and it's empty now
+    if (shelf.used == 0 && shelfIx == window.shelves.size() - 1)
+    {
+        window.shelfTop -= shelf.height;
+        window.shelves.pop_back();
+    }
+
+    window.usedArea -= width * height;
+    if (--window.liveCount == 0)
+        CloseWindow(windowIx);
+}
+
+bool VRamAllocator::ReserveTexture(psyqo::Prim::TPageAttr::ColorMode colourMode, uint16_t x, uint16_t y, uint16_t width, uint16_t height)
+{
+    if (width == 0 || height == 0)
+        return true;
+
+    // check every page before taking any, packed textures would just get drawn over
+    for (uint8_t row = y / texturePageHeight; row <= (y + height - 1) / texturePageHeight && row < TEXTURE_PAGE_ROWS; row++)
+    {
+        for (uint8_t column = x / texturePageWidth; column <= (x + width - 1) / texturePageWidth && column < texturePageColumns; column++)
+        {
+            int8_t ix = m_pageOwner[row][column] - 1;
+            if (ix != -1 && !m_windows[ix].isReserved)
+            {
+                printf("VRAM: Texture at %d,%d overlaps the packed textures at %d,%d.\n", x, y, m_windows[ix].x, m_windows[ix].y);
+                return false;
+            }
+        }
+    }
+
+    for (uint8_t row = y / texturePageHeight; row <= (y + height - 1) / texturePageHeight && row < TEXTURE_PAGE_ROWS; row++)
+    {
+        for (uint8_t column = x / texturePageWidth; column <= (x + width - 1) / texturePageWidth && column < texturePageColumns; column++)
+        {
+            // the frame buffers aren't ours to hand out anyway
+            if (column < VRAM_FIRST_TEXTURE_PAGE_COLUMN)
+                continue;
+
+            int8_t ix = m_pageOwner[row][column] - 1;
+            if (ix == -1)
+                ix = OpenWindow(colourMode, column, row, 1, true);
+
+            if (ix == -1)
+                continue;
+
+            uint16_t left = eastl::max<uint16_t>(x, column * texturePageWidth);
+            uint16_t right = eastl::min<uint16_t>(x + width, (column + 1) * texturePageWidth);
+            uint16_t top = eastl::max<uint16_t>(y, row * texturePageHeight);
+            uint16_t bottom = eastl::min<uint16_t>(y + height, (row + 1) * texturePageHeight);
+
+            TexturePageWindow &window = m_windows[ix];
+            window.usedArea += (right - left) * (bottom - top);
+            window.liveCount++;
+        }
+    }
+
+    return true;
+}
+
+bool VRamAllocator::AllocateClut(uint16_t width, uint16_t height, psyqo::Vertex *out)
+{
+    static constexpr uint8_t CLUT_ROWS_PER_STRIP = CLUT_ROWS / 2;
+
+    uint8_t slots = (width + CLUT_ALIGNMENT - 1) / CLUT_ALIGNMENT;
+    if (slots == 0 || slots > CLUT_SLOTS_PER_ROW || height == 0 || height > CLUT_ROWS_PER_STRIP)
+        return false;
+
+    uint32_t mask = (1u << slots) - 1;
+    for (uint8_t row = 0; row + height <= CLUT_ROWS; row++)
+    {
+        // the two strips aren't next to each other in vram
+        if (row / CLUT_ROWS_PER_STRIP != (row + height - 1) / CLUT_ROWS_PER_STRIP)
+            continue;
+
+        for (uint8_t slot = 0; slot + slots <= CLUT_SLOTS_PER_ROW; slot++)
+        {
+            bool isFree = true;
+            for (uint8_t r = 0; r < height && isFree; r++)
+                isFree = !(m_clutRows[row + r] & (mask << slot));
+
+            if (!isFree)
+                continue;
+
+            for (uint8_t r = 0; r < height; r++)
+                m_clutRows[row + r] |= mask << slot;
+
+            out->x = slot * CLUT_ALIGNMENT;
+            out->y = row < CLUT_ROWS_PER_STRIP ? 240 + row : 496 + (row - CLUT_ROWS_PER_STRIP);
+            return true;
+        }
+    }
+
+    printf("VRAM: Out of CLUT space for a %dx%d CLUT.\n", width, height);
+    return false;
+}
+
+void VRamAllocator::FreeClut(uint16_t x, uint16_t y, uint16_t width, uint16_t height)
+{
+    if (x >= CLUT_AREA_WIDTH)
+        return;
+
+    uint8_t slot = x / CLUT_ALIGNMENT;
+    uint8_t slots = eastl::min<uint8_t>((width + CLUT_ALIGNMENT - 1) / CLUT_ALIGNMENT, CLUT_SLOTS_PER_ROW - slot);
+    for (uint16_t r = 0; r < height; r++)
+    {
+        int8_t row = ClutRow(y + r);
+        if (row != -1)
+            m_clutRows[row] &= ~(((1u << slots) - 1) << slot);
+    }
+}
+
+void VRamAllocator::ReserveClut(uint16_t x, uint16_t y, uint16_t width, uint16_t height)
+{
+    // cluts outside the strips under the frame buffers are up to whoever put them there
+    if (x >= CLUT_AREA_WIDTH)
+        return;
+
+    uint8_t slot = x / CLUT_ALIGNMENT;
+    uint8_t slots = eastl::min<uint8_t>((x % CLUT_ALIGNMENT + width + CLUT_ALIGNMENT - 1) / CLUT_ALIGNMENT, CLUT_SLOTS_PER_ROW - slot);
+    for (uint16_t r = 0; r < height; r++)
+    {
+        int8_t row = ClutRow(y + r);
+        if (row != -1)
+            m_clutRows[row] |= ((1u << slots) - 1) << slot;
+    }
+}
+
+void VRamAllocator::Reset(void)
+{
+    for (auto &window : m_windows)
+    {
+        window.isInUse = false;
+        window.shelves.clear();
+    }
+
+    __builtin_memset(m_pageOwner, 0, sizeof(m_pageOwner));
+    __builtin_memset(m_clutRows, 0, sizeof(m_clutRows));
+}
+
+VRamStats VRamAllocator::Stats(void)
+{
+    VRamStats stats = {0};
+
+    for (uint8_t row = 0; row < TEXTURE_PAGE_ROWS; row++)
+    {
+        uint8_t run = 0;
+        for (uint8_t column = VRAM_FIRST_TEXTURE_PAGE_COLUMN; column < texturePageColumns; column++)
+        {
+            if (m_pageOwner[row][column] != 0)
+            {
+                run = 0;
+                continue;
+            }
+
+            stats.freePages++;
+            stats.largestFreeRun = eastl::max(stats.largestFreeRun, ++run);
+        }
+    }
+
+    for (const auto &window : m_windows)
+    {
+        if (!window.isInUse)
+            continue;
+
+        stats.claimedArea += window.width * texturePageHeight;
+        stats.usedArea += window.usedArea;
+    }
+
+    if (stats.claimedArea > 0)
+        stats.fragmentation = (stats.claimedArea - stats.usedArea) * 100 / stats.claimedArea;
+
+    for (uint8_t row = 0; row < CLUT_ROWS; row++)
+        stats.freeClutSlots += CLUT_SLOTS_PER_ROW - __builtin_popcount(m_clutRows[row]);
+
+    return stats;
+}
+
+void VRamAllocator::Report(void)
+{
+    VRamStats stats = Stats();
+    printf("VRAM: %d/%d texture pages free, largest run %d. %d%% of claimed pages unused. %d CLUT slots free.\n",
+           stats.freePages, MAX_TEXTURE_WINDOWS, stats.largestFreeRun, stats.fragmentation, stats.freeClutSlots);
+}
+
+uint8_t VRamAllocator::PagesFor(psyqo::Prim::TPageAttr::ColorMode colourMode)
+{
+    switch (colourMode)
+    {
+    case psyqo::Prim::TPageAttr::ColorMode::Tex4Bits:
+        return 1;
+    case psyqo::Prim::TPageAttr::ColorMode::Tex8Bits:
+        return 2;
+    default:
+        return 4;
+    }
+}
+
+int8_t VRamAllocator::FindPages(uint8_t pageCount, bool fromRight, uint8_t *rowOut)
+{
+    for (uint8_t row = 0; row < TEXTURE_PAGE_ROWS; row++)
+    {
+        for (uint8_t i = 0; i + VRAM_FIRST_TEXTURE_PAGE_COLUMN + pageCount <= texturePageColumns; i++)
+        {
+            uint8_t column = fromRight ? texturePageColumns - pageCount - i : VRAM_FIRST_TEXTURE_PAGE_COLUMN + i;
+
+            bool isFree = true;
+            for (uint8_t page = 0; page < pageCount && isFree; page++)
+                isFree = m_pageOwner[row][column + page] == 0;
+
+            if (isFree)
+            {
+                *rowOut = row;
+                return column;
+            }
+        }
+    }
+
+    return -1;
+}
+
+int8_t VRamAllocator::OpenWindow(psyqo::Prim::TPageAttr::ColorMode colourMode, uint8_t column, uint8_t row, uint8_t pageCount, bool isReserved)
+{
+    for (uint8_t i = 0; i < MAX_TEXTURE_WINDOWS; i++)
+    {
+        TexturePageWindow &window = m_windows[i];
+        if (window.isInUse)
+            continue;
+
+        window.x = column * texturePageWidth;
+        window.y = row * texturePageHeight;
+        window.width = pageCount * texturePageWidth;
+        window.shelfTop = 0;
+        window.liveCount = 0;
+        window.usedArea = 0;
+        window.colourMode = colourMode;
+        window.isInUse = true;
+        window.isReserved = isReserved;
+        window.shelves.clear();
+
+        for (uint8_t page = 0; page < pageCount; page++)
+            m_pageOwner[row][column + page] = i + 1;
+
+        return i;
+    }
+
+    return -1;
+}
+
+void VRamAllocator::CloseWindow(int8_t windowIx)
+{
+    TexturePageWindow &window = m_windows[windowIx];
+    uint8_t row = window.y / texturePageHeight, column = window.x / texturePageWidth;
+
+    for (uint8_t page = 0; page < window.width / texturePageWidth; page++)
+        m_pageOwner[row][column + page] = 0;
+
+    window.isInUse = false;
+    window.shelves.clear();
+}
+
+int8_t VRamAllocator::WindowAt(uint16_t x, uint16_t y)
+{
+    uint8_t row = y / texturePageHeight, column = x / texturePageWidth;
+    if (row >= TEXTURE_PAGE_ROWS || column >= texturePageColumns)
+        return -1;
+
+    return m_pageOwner[row][column] - 1;
+}
+
+int8_t VRamAllocator::ClutRow(uint16_t y)
+{
+    if (y >= 240 && y < 256)
+        return y - 240;
+    if (y >= 496 && y < 512)
+        return CLUT_ROWS / 2 + (y - 496);
+
+    return -1;
+}
@@ -0,0 +1,102 @@
+#ifndef _VRAM_ALLOCATOR_H
+#define _VRAM_ALLOCATOR_H
+
+#include <stdint.h>
+#include <EASTL/array.h>
+#include <EASTL/fixed_vector.h>
+#include "psyqo/primitives.hh"
+#include "texture_manager.hh"
+
+// pass this as a texture or clut x/y to have the allocator place it
+static constexpr uint16_t VRAM_AUTO_PLACE = 0xffff;
+
+// the frame buffers take up 0-319 across both page rows, so textures start at the 6th page column
+static constexpr uint8_t VRAM_FIRST_TEXTURE_PAGE_COLUMN = 320 / texturePageWidth;
+static constexpr uint8_t TEXTURE_PAGE_ROWS = 2;
+static constexpr uint8_t MAX_TEXTURE_WINDOWS = (texturePageColumns - VRAM_FIRST_TEXTURE_PAGE_COLUMN) * TEXTURE_PAGE_ROWS;
+static constexpr uint8_t MAX_WINDOW_SHELVES = 16;
+
+// cluts go in the strips under each frame buffer (y 240-255 and 496-511, x 0-319), on 16 pixel boundaries
+static constexpr uint16_t CLUT_ALIGNMENT = 16;
+static constexpr uint16_t CLUT_AREA_WIDTH = 320;
+static constexpr uint8_t CLUT_ROWS = 32;
+
+// a strip across a window. textures sit side by side along it, left to right
+struct TexturePageShelf
+{
+    uint16_t y, height; // relative to the window
+    uint16_t used;      // vram columns handed out from the left
+};
+
+// the texture pages a colour depth has claimed. always exactly one tpage of texels wide,
+// so anything packed inside it can be drawn from the tpage it starts in
+struct TexturePageWindow
+{
+    uint16_t x, y;
+    uint16_t width; // vram columns. 64 for 4-bit, 128 for 8-bit, 256 for 16-bit
+    uint16_t shelfTop;
+    uint16_t liveCount; // the window gives its pages back once this drops to 0
+    uint32_t usedArea;
+    psyqo::Prim::TPageAttr::ColorMode colourMode;
+    bool isInUse;
+    bool isReserved; // holds hand placed textures, nothing gets packed in around them
+    eastl::fixed_vector<TexturePageShelf, MAX_WINDOW_SHELVES, false> shelves;
+};
+
+struct VRamStats
+{
+    uint8_t freePages;      // texture pages nothing has claimed
+    uint8_t largestFreeRun; // most free pages side by side in one row. a 16-bit texture needs 4
+    uint32_t claimedArea;   // pixels in claimed pages
+    uint32_t usedArea;      // pixels actually covered by textures
+    uint8_t fragmentation;  // % of the claimed area nothing is using
+    uint16_t freeClutSlots; // 16 entry slots
+};
+
+/*
+ * packs textures and cluts into vram so scenes don't have to place them by hand.
+ * the rules from the top of texture_manager.cpp all hold:
+ * - a texture is narrower in vram than it is in texels (4-bit is 1/4, 8-bit is 1/2)
+ * - it has to fit in the 256 texels of the tpage it starts in, and can't cross a page row
+ * - a texture page only ever holds one colour depth
+ *
+ * each colour depth claims whole windows of pages (1 page for 4-bit, 2 for 8-bit, 4 for 16-bit)
+ * and shelf packs textures inside them. 16-bit windows are taken from the right hand side
+ * of vram and the rest from the left, so the big windows have room to fit.
+ */
+class VRamAllocator final
+{
+public:
+    // width is in vram columns, like a TIM's image header
+    static bool AllocateTexture(psyqo::Prim::TPageAttr::ColorMode colourMode, uint16_t width, uint16_t height, psyqo::Vertex *out);
+    static void FreeTexture(uint16_t x, uint16_t y, uint16_t width, uint16_t height);
+
+    // a hand placed texture. the pages it touches are kept away from the packer until it's freed.
+    // false if it lands on pages the packer has already handed out, and then nothing is reserved
+    static bool ReserveTexture(psyqo::Prim::TPageAttr::ColorMode colourMode, uint16_t x, uint16_t y, uint16_t width, uint16_t height);
+
+    // a clut more than one row tall takes the same slots on each row, all in the same strip
+    static bool AllocateClut(uint16_t width, uint16_t height, psyqo::Vertex *out);
+    static void FreeClut(uint16_t x, uint16_t y, uint16_t width, uint16_t height);
+    static void ReserveClut(uint16_t x, uint16_t y, uint16_t width, uint16_t height);
+
+    // forget everything, used alongside TextureManager::Dump
+    static void Reset(void);
+
+    static VRamStats Stats(void);
+    static void Report(void);
+
+private:
+    static int8_t FindPages(uint8_t pageCount, bool fromRight, uint8_t *rowOut);
+    static uint8_t PagesFor(psyqo::Prim::TPageAttr::ColorMode colourMode);
+    static int8_t OpenWindow(psyqo::Prim::TPageAttr::ColorMode colourMode, uint8_t column, uint8_t row, uint8_t pageCount, bool isReserved);
+    static void CloseWindow(int8_t windowIx);
+    static int8_t WindowAt(uint16_t x, uint16_t y);
+    static int8_t ClutRow(uint16_t y);
+
+    static eastl::array<TexturePageWindow, MAX_TEXTURE_WINDOWS> m_windows;
+    static uint8_t m_pageOwner[TEXTURE_PAGE_ROWS][texturePageColumns]; // window index + 1, 0 if free
+    static uint32_t m_clutRows[CLUT_ROWS];                              // a bit per 16 entry slot
+};
+
+#endif
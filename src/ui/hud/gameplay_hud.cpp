@@ -1,4 +1,5 @@
 #include "gameplay_hud.hh"
+#include "../../render/renderer.hh"
 
 void GameplayHUD::Render(void)
 {
@@ -17,4 +18,7 @@ void GameplayHUD::Render(void)
     {
         element.Render(m_rect);
     }
+
+    // sprites are batched by the renderer, so send them out now
+    Renderer::Instance().FlushSprites();
 }
@@ -0,0 +1,27 @@
+#ifndef _UI_HUD_FONT_H
+#define _UI_HUD_FONT_H
+
+#include <EASTL/string_view.h>
+#include "psyqo/font.hh"
+#include "psyqo/gpu.hh"
+
+/*
+ * psyqo's font, with a way to lay text out into glyphs the caller keeps hold of.
+ * chainprint lays the text out again every call and hands out one of the font's own
+ * fragments, so text that doesn't change can be laid out once here and chained each frame instead.
+ * anything that takes a psyqo::Font<100> still takes one of these
+ */
+class HUDFont final : public psyqo::Font<100>
+{
+public:
+    typedef GlyphsFragment Glyphs;
+
+    void Print(Glyphs &glyphs, psyqo::GPU &gpu, eastl::string_view text, psyqo::Vertex pos, psyqo::Color colour)
+    {
+        // start from one of the font's own fragments, so the tpage and clut are already set up
+        glyphs = getGlyphFragment(false);
+        innerprint(glyphs, gpu, text, pos, colour);
+    }
+};
+
+#endif
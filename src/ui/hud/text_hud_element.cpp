@@ -6,16 +6,41 @@ void TextHUDElement::Render(const psyqo::Rect &parentRect)
     Render(parentRect, nullptr);
 }
 
-void TextHUDElement::Render(const psyqo::Rect &parentRect, psyqo::Font<100> *fallbackFont)
+void TextHUDElement::Render(const psyqo::Rect &parentRect, HUDFont *fallbackFont)
 {
     if (!m_isEnabled)
         return;
 
     auto &rendererInstance = Renderer::Instance();
+    auto &gpu = rendererInstance.GPU();
 
     if (m_font == nullptr)
-        m_font = fallbackFont == nullptr ? rendererInstance.SystemFont() : fallbackFont;
+        SetFont(fallbackFont == nullptr ? rendererInstance.SystemFont() : fallbackFont);
 
     psyqo::Vertex posInParent = {static_cast<int16_t>(parentRect.pos.x + m_rect.pos.x), static_cast<int16_t>(parentRect.pos.y + m_rect.pos.y)};
-    m_font->chainprint(rendererInstance.GPU(), m_displayText, posInParent, m_colour);
+
+    if (!m_glyphCache)
+    {
+        m_glyphCache = eastl::make_unique<GlyphCache>();
+        m_glyphCache->pos = posInParent;
+        m_glyphCache->staleMask = 0b11;
+    }
+
+    // the glyphs have their position baked in, so moving the text (or its parent) lays it out again
+    if (m_glyphCache->pos.packed != posInParent.packed)
+    {
+        m_glyphCache->pos = posInParent;
+        m_glyphCache->staleMask = 0b11;
+    }
+
+    // only lay the text out if it's changed since this frame buffer's glyphs were last drawn
+    uint8_t parity = gpu.getParity();
+    auto &glyphs = m_glyphCache->glyphs[parity];
+    if (m_glyphCache->staleMask & (1 << parity))
+    {
+        m_font->Print(glyphs, gpu, {m_displayText.data(), m_displayText.size()}, posInParent, m_colour);
+        m_glyphCache->staleMask &= ~(1 << parity);
+    }
+
+    gpu.chain(glyphs);
 }
@@ -2,8 +2,9 @@
 #define _UI_TEXT_HUD_ELEMENT_H
 
 #include <EASTL/fixed_string.h>
-#include "psyqo/font.hh"
+#include <EASTL/unique_ptr.h>
 #include "hud_element.hh"
+#include "hud_font.hh"
 #include "hud_defines.hh"
 #include "../../render/colour.hh"
 
@@ -11,18 +12,71 @@ class TextHUDElement final : public HUDElement
 {
     eastl::fixed_string<char, GAMEPLAY_HUD_ELEMENT_MAX_STR_LEN> m_displayText;
     psyqo::Color m_colour = COLOUR_WHITE;
-    psyqo::Font<100> *m_font = nullptr;
+    HUDFont *m_font = nullptr;
+
+    // the text laid out once for each frame buffer, since last frame's could still be drawing.
+    // made the first time it's drawn, and laid out again only when something about it changes
+    struct GlyphCache
+    {
+        HUDFont::Glyphs glyphs[2];
+        psyqo::Vertex pos;
+        uint8_t staleMask; // a bit per frame buffer
+    };
+    eastl::unique_ptr<GlyphCache> m_glyphCache;
+
+    void MarkStale(void)
+    {
+        if (m_glyphCache)
+            m_glyphCache->staleMask = 0b11;
+    }
 
 public:
     TextHUDElement() : HUDElement("", {0, 0}) {};
     TextHUDElement(const char *name, psyqo::Rect rect) : HUDElement(name, rect) {};
     TextHUDElement(const char *name, psyqo::Rect rect, psyqo::Color colour) : TextHUDElement(name, rect) { m_colour = colour; }
-    void SetFont(psyqo::Font<100> *font) { m_font = font; }
-    void SetDisplayText(const char *displayText) { m_displayText = displayText; }
-    void SetColour(const psyqo::Color colour) { m_colour = colour; }
+
+    // a copy lays its text out again the first time it's drawn
+    TextHUDElement(const TextHUDElement &other) : HUDElement(other), m_displayText(other.m_displayText), m_colour(other.m_colour), m_font(other.m_font) {}
+    TextHUDElement(TextHUDElement &&other) = default;
+    TextHUDElement &operator=(const TextHUDElement &other)
+    {
+        HUDElement::operator=(other);
+        m_displayText = other.m_displayText;
+        m_colour = other.m_colour;
+        m_font = other.m_font;
+        MarkStale();
+        return *this;
+    }
+    TextHUDElement &operator=(TextHUDElement &&other) = default;
+
+    void SetFont(HUDFont *font)
+    {
+        if (font != m_font)
+            MarkStale();
+        m_font = font;
+    }
+
+    void SetDisplayText(const char *displayText)
+    {
+        if (m_displayText.compare(displayText) == 0)
+            return;
+
+        m_displayText = displayText;
+        MarkStale();
+    }
+
+    void SetColour(const psyqo::Color colour)
+    {
+        if (colour.packed == m_colour.packed)
+            return;
+
+        m_colour = colour;
+        MarkStale();
+    }
+
     void SetPositionSize(psyqo::Rect rect) { m_rect = rect; }
     void Render(const psyqo::Rect &parentRect);
-    void Render(const psyqo::Rect &parentRect, psyqo::Font<100> *defaultFont);
+    void Render(const psyqo::Rect &parentRect, HUDFont *defaultFont);
 };
 
 #endif
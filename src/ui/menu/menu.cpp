@@ -38,6 +38,9 @@ void Menu::frame(void)
     for (auto &sprite : m_spriteElements)
         sprite.Render(m_rect);
 
+    // before the menu items, so their text goes on top
+    Renderer::Instance().FlushSprites();
+
     uint32_t i = 0;
     for (auto &menuItem : m_menuItems)
         menuItem.Render(m_rect, m_currentSelectedMenuItem == i++, m_defaultFont);
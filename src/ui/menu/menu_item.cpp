@@ -1,6 +1,6 @@
 #include "menu_item.hh"
 
-void MenuItem::Render(const psyqo::Rect parentRect, const bool isSelected, psyqo::Font<100> *defaultFont)
+void MenuItem::Render(const psyqo::Rect parentRect, const bool isSelected, HUDFont *defaultFont)
 {
     if (!m_isEnabled)
         return;
@@ -0,0 +1,209 @@
+#!/usr/bin/env python3
+"""
+archive_layout.py
+
+Reorders the files in an authoring tool toc.json so each scene's files sit
+together in the archive, and estimates how much CD seeking a layout costs.
+
+The authoring tool packs files into the archive in the order toc.json lists
+them. At runtime `SceneLoader::SortBySector` loads a scene's files in
+archive order, after any hand placed textures, so once a scene's files are
+contiguous the load is one forward sweep of the disc.
+
+Scenes are given as the human-editable manifest sources that
+scenebin_converter.py reads, in the order the game loads them.
+
+Usage:
+    # print the seek estimate for the current layout and the planned one
+    python archive_layout.py cdrom/toc.json scenes/menu.txt scenes/level01.txt
+
+    # write the planned layout out
+    python archive_layout.py cdrom/toc.json scenes/*.txt -o cdrom/toc.json
+"""
+
+import argparse
+import json
+import math
+import sys
+from pathlib import Path
+
+sys.path.insert(0, str(Path(__file__).resolve().parent))
+from scenebin_converter import VRAM_AUTO_PLACE, SourceError, parse_source  # noqa: E402
+
+CD_SECTOR_SIZE = 2048
+
+# rough numbers for a 2x drive. only meant for comparing layouts against each other
+CD_SECTORS_PER_SECOND = 150 * 2
+CD_DISC_SECTORS = 333000
+SEEK_MIN_MS = 20.0  # any seek at all, mostly waiting on the disc to come round
+SEEK_FULL_MS = 300.0  # edge of the disc to the other
+
+
+def hand_placed(entry):
+    """A texture with fixed vram coordinates. The engine loads these before anything else in the scene."""
+    placement = entry.get("placement")
+    return placement is not None and VRAM_AUTO_PLACE not in placement[:2]
+
+
+def scene_loads(path: Path):
+    """The archive names a manifest loads, hand placed textures first, and the set of those."""
+    entries = parse_source(path)
+    pinned = {entry["name"] for entry in entries if hand_placed(entry)}
+    names = [entry["name"] for entry in entries]
+    return (path.stem, sorted(names, key=lambda name: name not in pinned), pinned)
+
+
+def load_toc(path: Path):
+    with path.open("r", encoding="utf-8") as f:
+        return json.load(f)
+
+
+def file_sectors(toc_dir: Path, files):
+    """Size of every archive file in sectors, keyed by archive name.
+
+    The authoring tool may compress files, so this is an upper bound.
+    """
+    sectors = {}
+    for entry in files:
+        source = toc_dir / entry["path"]
+        if source.exists():
+            sectors[entry["name"]] = max(1, math.ceil(source.stat().st_size / CD_SECTOR_SIZE))
+        else:
+            print(f"archive_layout: warning: {source} not found, counting it as 1 sector", file=sys.stderr)
+            sectors[entry["name"]] = 1
+
+    return sectors
+
+
+def plan_layout(files, scenes):
+    """Group files by the first and last scene that loads them.
+
+    Ordering by (first scene, last scene) keeps each scene's files together
+    and leaves the files two neighbouring scenes share between them. Files no
+    scene loads go at the end in their original order.
+    """
+    order = {entry["name"]: i for i, entry in enumerate(files)}
+    first_use = {}
+    last_use = {}
+    manifest_pos = {}
+
+    for scene_ix, (_, names, _) in enumerate(scenes):
+        for pos, name in enumerate(names):
+            if name not in order:
+                continue
+            if name not in first_use:
+                first_use[name] = scene_ix
+                manifest_pos[name] = pos
+            last_use[name] = scene_ix
+
+    def key(entry):
+        name = entry["name"]
+        if name not in first_use:
+            return (len(scenes), 0, 0, order[name])
+        return (first_use[name], last_use[name], manifest_pos[name], order[name])
+
+    return sorted(files, key=key)
+
+
+def seek_ms(distance):
+    if distance == 0:
+        return 0.0
+    return SEEK_MIN_MS + SEEK_FULL_MS * math.sqrt(min(distance, CD_DISC_SECTORS) / CD_DISC_SECTORS)
+
+
+def simulate(files, sectors, scenes, sort_by_sector=True):
+    """Walk the head through each scene's loads. Returns one row per scene."""
+    start = {}
+    lba = 0
+    for entry in files:
+        start[entry["name"]] = lba
+        lba += sectors[entry["name"]]
+
+    rows = []
+    for scene_name, names, pinned in scenes:
+        loads = [name for name in names if name in start]
+        if sort_by_sector:
+            loads.sort(key=lambda name: (name not in pinned, start[name]))
+
+        # the head could be anywhere when a scene starts loading, so the seek to its first file isn't counted
+        head = start[loads[0]] if loads else 0
+        seeks = 0
+        distance = 0
+        seek_time = 0.0
+        read_sectors = 0
+
+        for name in loads:
+            gap = abs(start[name] - head)
+            if gap:
+                seeks += 1
+                distance += gap
+                seek_time += seek_ms(gap)
+
+            read_sectors += sectors[name]
+            head = start[name] + sectors[name]
+
+        read_time = read_sectors * 1000.0 / CD_SECTORS_PER_SECOND
+        rows.append((scene_name, len(loads), read_sectors, seeks, distance, seek_time, read_time))
+
+    return rows
+
+
+def print_report(title, rows):
+    print(title)
+    print(f"  {'scene':<24} {'files':>5} {'sectors':>8} {'seeks':>5} {'distance':>9} {'seek ms':>8} {'read ms':>8}")
+
+    total_seek = 0.0
+    total_read = 0.0
+    for scene_name, count, read_sectors, seeks, distance, seek_time, read_time in rows:
+        print(f"  {scene_name:<24} {count:>5} {read_sectors:>8} {seeks:>5} {distance:>9} {seek_time:>8.0f} {read_time:>8.0f}")
+        total_seek += seek_time
+        total_read += read_time
+
+    print(f"  {'total':<24} {'':>5} {'':>8} {'':>5} {'':>9} {total_seek:>8.0f} {total_read:>8.0f}")
+    print()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Lay out an archive so each scene loads in one sweep of the disc.")
+    parser.add_argument("toc", type=Path, help="Path to the authoring tool toc.json")
+    parser.add_argument("scenes", type=Path, nargs="+", help="Scene manifest sources, in the order the game loads them")
+    parser.add_argument("-o", "--output", type=Path, default=None, help="Write the reordered toc.json here")
+    parser.add_argument(
+        "--manifest-order",
+        action="store_true",
+        help="Simulate loading in manifest order, like the engine did before it sorted by sector",
+    )
+
+    args = parser.parse_args()
+
+    try:
+        toc = load_toc(args.toc)
+        files = toc.get("files", [])
+        scenes = [scene_loads(path) for path in args.scenes]
+    except (OSError, json.JSONDecodeError, SourceError) as e:
+        print(f"archive_layout: error: {e}", file=sys.stderr)
+        sys.exit(1)
+
+    archive_names = {entry["name"] for entry in files}
+    for scene_name, names, _ in scenes:
+        for name in names:
+            if name not in archive_names:
+                print(f"archive_layout: warning: {scene_name} loads {name}, which isn't in the toc", file=sys.stderr)
+
+    sectors = file_sectors(args.toc.parent, files)
+    planned = plan_layout(files, scenes)
+    sort_by_sector = not args.manifest_order
+
+    print_report("current layout:", simulate(files, sectors, scenes, sort_by_sector))
+    print_report("planned layout:", simulate(planned, sectors, scenes, sort_by_sector))
+
+    if args.output is not None:
+        toc["files"] = planned
+        with args.output.open("w", encoding="utf-8") as f:
+            json.dump(toc, f, indent=4)
+            f.write("\n")
+        print(f"Wrote {len(planned)} files to {args.output}")
+
+
+if __name__ == "__main__":
+    main()
@@ -1,7 +1,7 @@
 bl_info = {
     "name": "Export ANIMBIN (.animbin)",
     "author": "Madnight & ChatGPT",
-    "version": (2, 2),
+    "version": (3, 0),
     "blender": (5, 0, 0),
     "location": "File > Export > ANIMBIN",
     "description": "Exports armature animations with absolute rotations (multi-action support)",
@@ -15,6 +15,8 @@ from bpy_extras.io_utils import ExportHelper, axis_conversion
 from bpy.props import StringProperty, IntProperty, EnumProperty, BoolProperty
 
 FP12_SCALE = 4096
+ONE_ENGINE_METRE = 128
+MAX_KEY_FRAME_GAP = 255  # v2 keys store the gap from the previous key in a byte
 
 # Go from Blender's coordinate system into PS1's coordinate system:
 axis_basis_change = mathutils.Matrix(
@@ -98,41 +100,77 @@ def bake_action(armature, action, start_frame, end_frame):
     )
 
 
+# ------------------------------------------------------------
+# Quantise a rotation to the 3 components ANIMBIN v2 stores.
+# w is rebuilt at load time so it must be kept positive
+# ------------------------------------------------------------
+def quantise_quat_xyz(q):
+    if q.w < 0.0:
+        q = -q
+    return (fp12_16(q.x), fp12_16(q.y), fp12_16(q.z))
+
+
+# ------------------------------------------------------------
+# Drop keys in the middle of a hold. a key is only needed if it
+# differs from the key before or after it
+# ------------------------------------------------------------
+def reduce_keys(keys):
+    if len(keys) <= 2:
+        return keys
+
+    reduced = [keys[0]]
+    for i in range(1, len(keys) - 1):
+        prev_value = keys[i - 1][1]
+        value = keys[i][1]
+        next_value = keys[i + 1][1]
+
+        # frame gaps are stored in a byte, so a long hold still gets a key every MAX_KEY_FRAME_GAP frames
+        too_far = keys[i + 1][0] - reduced[-1][0] > MAX_KEY_FRAME_GAP
+        if value != prev_value or value != next_value or too_far:
+            reduced.append(keys[i])
+    reduced.append(keys[-1])
+
+    return reduced
+
+
+def write_name(f, name):
+    name_bytes = name.encode("ascii", errors="ignore")[:32]
+    f.write(struct.pack("<B", len(name_bytes)))
+    f.write(name_bytes)
+
+
 # ------------------------------------------------------------
 # Write a single animation block into the file
 # ------------------------------------------------------------
 def write_animation(f, arm, action, scene, start_frame, end_frame,
-                    all_deform_bones, bone_index_map):
+                    all_deform_bones, bone_index_map, root_motion):
     frame_count = end_frame - start_frame + 1
 
     bone_names = [b.name for b in all_deform_bones if arm.pose.bones.get(b.name)]
-    num_tracks = len(bone_names)
+    root_name = next((b.name for b in all_deform_bones if b.parent is None), None)
+    root_motion = root_motion and root_name is not None
+    num_tracks = len(bone_names) + (1 if root_motion else 0)
 
     # Animation header
-    name_bytes = action.name.encode("ascii", errors="ignore")[:32]
-    name_bytes = name_bytes.ljust(32, b"\0")
-    f.write(name_bytes)
+    write_name(f, action.name)
 
     flags = 1  # looped
-    f.write(struct.pack("<I", flags))
+    f.write(struct.pack("<B", flags))
     f.write(struct.pack("<H", frame_count))
-    f.write(struct.pack("<H", num_tracks))
-    f.write(struct.pack("<H", 0))       # numMarkers
+    f.write(struct.pack("<B", num_tracks))
+    f.write(struct.pack("<B", 0))       # numMarkers
 
     depsgraph = bpy.context.evaluated_depsgraph_get()
 
-    for bone_name in bone_names:
-        joint_id = bone_index_map[bone_name]
-
-        f.write(struct.pack("<B", 0))            # type = ROTATION
-        f.write(struct.pack("<B", joint_id))
-        f.write(struct.pack("<H", frame_count))
-
-        for i, frame in enumerate(range(start_frame, end_frame + 1)):
-            scene.frame_set(frame)
-            depsgraph.update()
+    # sample every bone on every frame first, one frame_set per frame rather than per bone
+    samples = {bone_name: [] for bone_name in bone_names}
+    root_samples = []
+    for i, frame in enumerate(range(start_frame, end_frame + 1)):
+        scene.frame_set(frame)
+        depsgraph.update()
 
-            arm_eval = arm.evaluated_get(depsgraph)
+        arm_eval = arm.evaluated_get(depsgraph)
+        for bone_name in bone_names:
             pbone = arm_eval.pose.bones[bone_name]
 
             if pbone.parent is None:
@@ -140,30 +178,62 @@ def write_animation(f, arm, action, scene, start_frame, end_frame,
             else:
                 transform = pbone.parent.matrix.inverted_safe() @ pbone.matrix
 
-            _, rotation, _ = transform.decompose()
-            q = rotation
+            translation, rotation, _ = transform.decompose()
+            samples[bone_name].append((i, quantise_quat_xyz(rotation)))
 
-            f.write(struct.pack("<H", i))
-            f.write(struct.pack("<B", 0))
-            f.write(struct.pack(
-                "<hhhh",
-                fp12_16(q.w),
-                fp12_16(q.x),
-                fp12_16(q.y),
-                fp12_16(q.z),
-            ))
+            # root motion is in the same units as MESHBIN positions
+            if root_motion and bone_name == root_name:
+                root_samples.append((i, (int(translation.x * ONE_ENGINE_METRE),
+                                         int(translation.y * ONE_ENGINE_METRE),
+                                         int(translation.z * ONE_ENGINE_METRE))))
 
-            print(f"[{action.name}] {bone_name} frame {frame}: "
-                  f"w={q.w:.4f} x={q.x:.4f} y={q.y:.4f} z={q.z:.4f}")
+    total_keys = 0
+    for bone_name in bone_names:
+        joint_id = bone_index_map[bone_name]
+        keys = reduce_keys(samples[bone_name])
+        total_keys += len(keys)
 
-    print(f"  -> '{action.name}': {frame_count} frames, {num_tracks} tracks")
+        f.write(struct.pack("<B", 0))            # type = ROTATION
+        f.write(struct.pack("<B", joint_id))
+        f.write(struct.pack("<H", len(keys)))
+
+        # frames are written as the gap from the last key
+        last_frame = 0
+        for (frame, (x, y, z)) in keys:
+            delta = frame - last_frame
+            if delta > MAX_KEY_FRAME_GAP:
+                raise RuntimeError(f"'{action.name}' has a {delta} frame gap between keys, max is {MAX_KEY_FRAME_GAP}")
+            f.write(struct.pack("<B", delta))
+            f.write(struct.pack("<hhh", x, y, z))
+            last_frame = frame
+
+    # the engine extracts this as root motion instead of moving the bone
+    if root_motion:
+        keys = reduce_keys(root_samples)
+        total_keys += len(keys)
+
+        f.write(struct.pack("<B", 1))            # type = TRANSLATION
+        f.write(struct.pack("<B", bone_index_map[root_name]))
+        f.write(struct.pack("<H", len(keys)))
+
+        last_frame = 0
+        for (frame, (x, y, z)) in keys:
+            delta = frame - last_frame
+            if delta > MAX_KEY_FRAME_GAP:
+                raise RuntimeError(f"'{action.name}' has a {delta} frame gap between root motion keys, max is {MAX_KEY_FRAME_GAP}")
+            f.write(struct.pack("<B", delta))
+            f.write(struct.pack("<iii", x, y, z))
+            last_frame = frame
+
+    print(f"  -> '{action.name}': {frame_count} frames, {num_tracks} tracks, "
+          f"{total_keys}/{frame_count * num_tracks} keys kept")
 
 
 # ------------------------------------------------------------
 # Main export entry point
 # ------------------------------------------------------------
 def export_animbin(context, filepath, start_frame, end_frame,
-                   export_mode, action_frame_ranges):
+                   export_mode, action_frame_ranges, root_motion=False):
     arm = context.object
     if not arm or arm.type != "ARMATURE":
         raise RuntimeError("Select an armature object")
@@ -191,7 +261,7 @@ def export_animbin(context, filepath, start_frame, end_frame,
         for action in bpy.data.actions:
             if action.frame_range[1] > action.frame_range[0]:
                 s = int(action.frame_range[0])
-                e = min(int(action.frame_range[1]), s + 29)
+                e = int(action.frame_range[1])
             else:
                 s, e = start_frame, end_frame
             actions_to_export.append((action, s, e))
@@ -217,7 +287,7 @@ def export_animbin(context, filepath, start_frame, end_frame,
 
     with open(filepath, "wb") as f:
         f.write(b"ANIMBIN")
-        f.write(struct.pack("<B", 1))
+        f.write(struct.pack("<B", 2))
         f.write(struct.pack("<B", num_animations))
 
         for (action, s, e) in actions_to_export:
@@ -227,7 +297,7 @@ def export_animbin(context, filepath, start_frame, end_frame,
             bpy.context.view_layer.update()
 
             write_animation(f, arm, action, scene, s, e,
-                            all_deform_bones, bone_index_map)
+                            all_deform_bones, bone_index_map, root_motion)
 
     arm.animation_data.action = original_action
     arm.animation_data.use_nla = original_use_nla
@@ -260,12 +330,19 @@ class ExportAnimBin(bpy.types.Operator, ExportHelper):
         default='ACTIVE',
     )
 
+    root_motion: BoolProperty(
+        name="Root Motion",
+        description="Export the root bone's movement as a translation track for the engine to extract",
+        default=False,
+    )
+
     start_frame: IntProperty(name="Start Frame", default=1)
     end_frame:   IntProperty(name="End Frame",   default=30)
 
     def draw(self, context):
         layout = self.layout
         layout.prop(self, "export_mode")
+        layout.prop(self, "root_motion")
         if self.export_mode == 'ACTIVE':
             row = layout.row(align=True)
             row.prop(self, "start_frame")
@@ -281,6 +358,7 @@ class ExportAnimBin(bpy.types.Operator, ExportHelper):
             self.end_frame,
             self.export_mode,
             [],
+            self.root_motion,
         )
         return {'FINISHED'}
 
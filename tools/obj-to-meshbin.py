@@ -1,3 +1,4 @@
+import math
 import struct
 import sys
 import os
@@ -203,11 +204,225 @@ def parse_obj_file_with_collision_data(path,texture_size):
     return verts, norms, uvs, face_indices, uv_indices, normal_indices, num_faces, collision_verts, min_coords, max_coords, has_skeleton, skeleton_bone_count, skeleton_bones, bone_id_for_vert_ix, bsphere_centre, bsphere_radius
 
 
-def write_meshbin(filename, verts, norms, uvs, indices, uv_indices, normal_indices, num_faces, collision_verts, min_coords, max_coords, has_skeleton, skeleton_bone_count, skeleton_bones, bone_id_for_vert_ix, bsphere_centre, bsphere_radius):
+# faces are reordered so neighbouring faces share verts, then every per-vertex array is renumbered in the
+# order the faces first use it. the renderer then walks vertices, colours, uvs and normals front to back
+# instead of jumping around, and a projected-vertex cache this size would get most verts for free
+VERTEX_CACHE_SIZE = 16
+
+# tom forsyth's linear-speed vertex cache optimisation, works on quads as well as tris
+CACHE_DECAY_POWER = 1.5
+LAST_FACE_SCORE = 0.75
+VALENCE_BOOST_SCALE = 2.0
+VALENCE_BOOST_POWER = 0.5
+
+def face_verts(face):
+    return [v for v in face if v != -1]
+
+
+def vertex_score(cache_pos, remaining_faces):
+    # nothing left to draw with it, no point keeping it around
+    if remaining_faces == 0:
+        return -1.0
+
+    score = 0.0
+    if cache_pos >= 0:
+        # the face we just drew has the same score no matter which vert was first
+        if cache_pos < 3:
+            score = LAST_FACE_SCORE
+        else:
+            scaler = 1.0 / (VERTEX_CACHE_SIZE - 3)
+            score = (1.0 - (cache_pos - 3) * scaler) ** CACHE_DECAY_POWER
+
+    # favour verts with few faces left so they get finished off and don't leave lone faces for later
+    return score + VALENCE_BOOST_SCALE * remaining_faces ** -VALENCE_BOOST_POWER
+
+
+def optimise_face_order(face_indices, vertex_count):
+    num_faces = len(face_indices)
+    vertex_faces = [[] for _ in range(vertex_count)]
+    for face_ix, face in enumerate(face_indices):
+        for v in face_verts(face):
+            vertex_faces[v].append(face_ix)
+
+    remaining = [len(faces) for faces in vertex_faces]
+    cache_pos = [-1] * vertex_count
+    scores = [vertex_score(-1, remaining[v]) for v in range(vertex_count)]
+    face_scores = [sum(scores[v] for v in face_verts(face)) for face in face_indices]
+    emitted = [False] * num_faces
+
+    cache = []
+    order = []
+    best_face = max(range(num_faces), key=lambda f: face_scores[f]) if num_faces else -1
+
+    while len(order) < num_faces:
+        # nothing in the cache touches a face that's left, fall back to the best face anywhere
+        if best_face == -1:
+            best_face = max((f for f in range(num_faces) if not emitted[f]), key=lambda f: face_scores[f])
+
+        order.append(best_face)
+        emitted[best_face] = True
+
+        verts = face_verts(face_indices[best_face])
+        for v in verts:
+            remaining[v] -= 1
+
+        # move this face's verts to the front of the cache
+        cache = verts + [v for v in cache if v not in verts]
+        evicted = cache[VERTEX_CACHE_SIZE:]
+        cache = cache[:VERTEX_CACHE_SIZE]
+
+        for v in evicted:
+            cache_pos[v] = -1
+
+        touched = set(evicted)
+        for pos, v in enumerate(cache):
+            cache_pos[v] = pos
+            touched.add(v)
+
+        for v in touched:
+            scores[v] = vertex_score(cache_pos[v], remaining[v])
+
+        # only faces touching a changed vert need rescoring, and the next face comes from those
+        best_face = -1
+        best_score = -1.0
+        for v in touched:
+            for f in vertex_faces[v]:
+                if emitted[f]:
+                    continue
+
+                face_scores[f] = sum(scores[fv] for fv in face_verts(face_indices[f]))
+                if face_scores[f] > best_score:
+                    best_score = face_scores[f]
+                    best_face = f
+
+    return order
+
+
+def average_cache_miss_ratio(face_indices):
+    cache = []
+    misses = 0
+    for face in face_indices:
+        for v in face_verts(face):
+            if v not in cache:
+                misses += 1
+            else:
+                cache.remove(v)
+            cache.insert(0, v)
+        del cache[VERTEX_CACHE_SIZE:]
+
+    return misses / len(face_indices) if face_indices else 0.0
+
+
+# renumbers indices in the order they're first used. anything no face uses is dropped
+def renumber_by_first_use(indices, items):
+    remap = {}
+    new_items = []
+    new_indices = []
+    for face in indices:
+        new_face = []
+        for i in face:
+            if i == -1:
+                new_face.append(-1)
+                continue
+
+            if i not in remap:
+                remap[i] = len(new_items)
+                new_items.append(items[i])
+            new_face.append(remap[i])
+        new_indices.append(new_face)
+
+    return new_indices, new_items, remap
+
+
+def optimise_mesh_layout(verts, norms, uvs, face_indices, uv_indices, normal_indices, bone_id_for_vert_ix, chunks):
+    acmr_before = average_cache_miss_ratio(face_indices)
+
+    # faces are only reordered inside their chunk so each chunk stays contiguous
+    order = []
+    chunk_ranges = []
+    for chunk in chunks:
+        chunk_order = optimise_face_order([face_indices[f] for f in chunk], len(verts))
+        chunk_ranges.append((len(order), len(chunk)))
+        order += [chunk[f] for f in chunk_order]
+
+    # faces keep their winding, only the order they're drawn in changes
+    face_indices = [face_indices[f] for f in order]
+    uv_indices = [uv_indices[f] for f in order]
+    normal_indices = [normal_indices[f] for f in order]
+
+    face_indices, new_verts, vert_remap = renumber_by_first_use(face_indices, verts)
+    uv_indices, uvs, _ = renumber_by_first_use(uv_indices, uvs)
+    normal_indices, norms, _ = renumber_by_first_use(normal_indices, norms)
+
+    # bone weights are per vertex so they follow the verts
+    if bone_id_for_vert_ix:
+        new_bones = [0] * len(new_verts)
+        for old_ix, new_ix in vert_remap.items():
+            new_bones[new_ix] = bone_id_for_vert_ix[old_ix]
+        bone_id_for_vert_ix = new_bones
+
+    print(f"face order: {acmr_before:.2f} -> {average_cache_miss_ratio(face_indices):.2f} vertex misses per face "
+          f"({VERTEX_CACHE_SIZE} entry cache). dropped {len(verts) - len(new_verts)} unused verts")
+
+    return new_verts, norms, uvs, face_indices, uv_indices, normal_indices, bone_id_for_vert_ix, chunk_ranges
+
+
+# big meshes get split into chunks the engine can cull on their own. it has to be below the engine's
+# MAX_FACES_PER_CHUNK (1000), smaller chunks cull tighter but each one costs a sphere test
+CHUNK_MAX_FACES = 256
+
+def face_centroid(verts, face):
+    vs = [verts[v] for v in face_verts(face)]
+    return [sum(v[axis] for v in vs) / len(vs) for axis in range(3)]
+
+
+# splits the faces in half along the longest axis until every chunk is small enough
+def split_into_chunks(verts, face_indices):
+    centroids = [face_centroid(verts, face) for face in face_indices]
+
+    def split(faces):
+        if len(faces) <= CHUNK_MAX_FACES:
+            return [faces]
+
+        extents = [max(centroids[f][axis] for f in faces) - min(centroids[f][axis] for f in faces) for axis in range(3)]
+        axis = extents.index(max(extents))
+        faces = sorted(faces, key=lambda f: centroids[f][axis])
+        half = len(faces) // 2
+        return split(faces[:half]) + split(faces[half:])
+
+    return split(list(range(len(face_indices))))
+
+
+# bounding sphere per chunk, centred on the chunk's aabb
+def generate_chunk_spheres(verts, face_indices, chunk_ranges):
+    chunks = []
+    for first, count in chunk_ranges:
+        used = {v for face in face_indices[first:first + count] for v in face_verts(face)}
+        min_coords, max_coords = generate_aabb_for_verts([verts[v] for v in used])
+        centre = [(min_coords[axis] + max_coords[axis]) // 2 for axis in range(3)]
+        radius = max(math.dist(centre, verts[v][:3]) for v in used)
+        chunks.append((*centre, math.ceil(radius), first, count))
+
+    return chunks
+
+
+MESHBIN_VERSION = 6
+MESHBIN_NUM_SECTIONS = 10
+
+# sections are 4 byte aligned so the engine can point straight at them without copying
+def align_to_4(f):
+    while f.tell() % 4:
+        f.write(b"\x00")
+
+    return f.tell()
+
+
+def write_meshbin(filename, verts, norms, uvs, indices, uv_indices, normal_indices, num_faces, collision_verts, min_coords, max_coords, has_skeleton, skeleton_bone_count, skeleton_bones, bone_id_for_vert_ix, bsphere_centre, bsphere_radius, chunks):
     with open(filename, "wb") as f:
         f.write(b"MESHBIN") # magic
-        f.write(struct.pack("<B", 3)) # version
+        f.write(struct.pack("<B", MESHBIN_VERSION)) # version
         f.write(struct.pack("<B", 1)) # type
+        f.write(b"\x00" * 3) # pad
 
         # subheader
         f.write(struct.pack("<I", len(verts)))
@@ -217,11 +432,31 @@ def write_meshbin(filename, verts, norms, uvs, indices, uv_indices, normal_indic
         f.write(struct.pack("<I", len(uvs)))
         f.write(struct.pack("<B", has_skeleton)) 
         f.write(struct.pack("<B", skeleton_bone_count)) 
+        f.write(struct.pack("<H", len(chunks)))
 
+        # aabb collision box
+        f.write(struct.pack("<hhh", *min_coords))
+        f.write(struct.pack("<hhh", *max_coords))
+
+        # bounding sphere, laid out like a psyqo::Vec3 + int32
+        f.write(struct.pack("<iii", *bsphere_centre))
+        f.write(struct.pack("<i", bsphere_radius))
+
+        # section offsets, filled in once we know where everything landed
+        offsets_pos = f.tell()
+        f.write(struct.pack(f"<{MESHBIN_NUM_SECTIONS}I", *([0] * MESHBIN_NUM_SECTIONS)))
+        offsets = []
+
+        # positions are int16 with a pad, the same layout as the GTE's SVECTOR
+        offsets.append(align_to_4(f))
         for vert in verts:
             x, y, z = vert[:3]
-            f.write(struct.pack("<iii", x, y, z))
+            if not all(-32768 <= c <= 32767 for c in (x, y, z)):
+                raise ValueError(f"Vertex ({x}, {y}, {z}) is out of int16 range, the mesh is too big for the GTE")
 
+            f.write(struct.pack("<hhhh", x, y, z, 0))
+
+        offsets.append(align_to_4(f))
         for vert in verts:
             if len(vert) >= 6:
                 r, g, b = vert[3:6]
@@ -230,37 +465,44 @@ def write_meshbin(filename, verts, norms, uvs, indices, uv_indices, normal_indic
 
             f.write(struct.pack("<BBB", r, g, b))
 
+        offsets.append(align_to_4(f))
         for face in indices:
             f.write(struct.pack("<hhhh", *face))
 
+        offsets.append(align_to_4(f))
         for x, y, z in norms:
-            f.write(struct.pack("<hhh", x, y, z))
+            f.write(struct.pack("<iii", x, y, z))
 
+        offsets.append(align_to_4(f))
         for face in normal_indices:
             f.write(struct.pack("<hhhh", *face))
 
+        offsets.append(align_to_4(f))
         for u, v in uvs:
             f.write(struct.pack("<BB", u, v))
 
+        offsets.append(align_to_4(f))
         for face in uv_indices:
             f.write(struct.pack("<hhhh", *face))
 
-        # aabb collision box
-        f.write(struct.pack("<hhh", *min_coords))
-        f.write(struct.pack("<hhh", *max_coords))
-
-        # bounding sphere
-        f.write(struct.pack("<hhh", *bsphere_centre))
-        f.write(struct.pack("<i", bsphere_radius))
-
-        # skeleton bones
+        # skeleton bones, parent padded out so the rest of the bone is aligned
+        offsets.append(align_to_4(f))
         for bone in skeleton_bones:
-            f.write(struct.pack("<b3i4h", *bone))
+            f.write(struct.pack("<b3x3i4h", *bone))
 
         # skeleton bone id for vert ix
+        offsets.append(align_to_4(f))
         for bone_mapping in bone_id_for_vert_ix:
             f.write(struct.pack("<B", bone_mapping))
 
+        # chunks. centre is packed like the vertices
+        offsets.append(align_to_4(f))
+        for x, y, z, radius, first_face, face_count in chunks:
+            f.write(struct.pack("<hhhhiHH", x, y, z, 0, radius, first_face, face_count))
+
+        f.seek(offsets_pos)
+        f.write(struct.pack(f"<{MESHBIN_NUM_SECTIONS}I", *offsets))
+
 
 if __name__ == "__main__":
     if len(sys.argv) != 4:
@@ -272,6 +514,19 @@ if __name__ == "__main__":
     texture_size = sys.argv[3]
 
     verts, norms, uvs, indices, uv_idx, norm_idx, num_faces, collision_verts, min_coords, max_coords, has_skeleton, skeleton_bone_count, skeleton_bones, bone_id_for_vert_ix, bsphere_centre, bsphere_radius = parse_obj_file_with_collision_data(input_obj, texture_size)
-    write_meshbin(output_bin, verts, norms, uvs, indices, uv_idx, norm_idx, num_faces, collision_verts, min_coords, max_coords, has_skeleton, skeleton_bone_count, skeleton_bones, bone_id_for_vert_ix, bsphere_centre, bsphere_radius)
+
+    # skinned meshes move about at runtime so chunk spheres would be wrong for them
+    chunks = [list(range(len(indices)))]
+    if not has_skeleton and len(indices) > CHUNK_MAX_FACES:
+        chunks = split_into_chunks(verts, indices)
+
+    verts, norms, uvs, indices, uv_idx, norm_idx, bone_id_for_vert_ix, chunk_ranges = optimise_mesh_layout(verts, norms, uvs, indices, uv_idx, norm_idx, bone_id_for_vert_ix, chunks)
+
+    # a single chunk is just the whole mesh, so don't bother writing it
+    chunk_spheres = generate_chunk_spheres(verts, indices, chunk_ranges) if len(chunk_ranges) > 1 else []
+    if not chunk_spheres and num_faces >= 1000:
+        print(f"warning: {num_faces} faces in one chunk, the engine won't load more than 999")
+
+    write_meshbin(output_bin, verts, norms, uvs, indices, uv_idx, norm_idx, num_faces, collision_verts, min_coords, max_coords, has_skeleton, skeleton_bone_count, skeleton_bones, bone_id_for_vert_ix, bsphere_centre, bsphere_radius, chunk_spheres)
     print(f"Successfully wrote mesh binary to {output_bin}\n")
-    print(f"verts: {len(verts)}. indices count: {len(indices)}. faces count: {num_faces}. uv count: {len(uvs)}. bone count: {skeleton_bone_count}")
+    print(f"verts: {len(verts)}. indices count: {len(indices)}. faces count: {num_faces}. uv count: {len(uvs)}. bone count: {skeleton_bone_count}. chunks: {len(chunk_spheres)}")
@@ -11,6 +11,8 @@ Source format (plain text, one entry per line):
     sfx SFX/FCNTNA.VAG
     texture TEXTURES/LOGO.TIM 320 0 0 240
     texture UI/CS_UI.TIM 320 129 0 241
+    texture UI/ICONS.TIM auto
+    texture UI/FONT.TIM 640 0 auto auto
     object MODELS/SBSKT.MB
     object MODELS/SCART.MB
 
@@ -32,11 +34,15 @@ TYPE_MAP = {
     "animation": 3,
     "colbin": 4,
     "vag": 5,
+    "scene_pack": 6,
 }
 
 MAX_ARCHIVE_FILE_NAME_LEN = 255  # keep in sync with the C++ constant
 
 VRAM_WIDTH = 1024
+
+# written in place of a coordinate to have the engine's VRamAllocator place it
+VRAM_AUTO_PLACE = 0xFFFF
 VRAM_HEIGHT = 512
 
 MAGIC = b"SCENEBIN"
@@ -86,16 +92,22 @@ def parse_source(path: Path):
             entry = {"type": type_name, "name": name, "lineno": lineno}
 
             if type_name == "texture":
+                # a lone "auto" places both the image and the clut
+                if extra_fields == ["auto"]:
+                    extra_fields = ["auto"] * 4
+
                 if len(extra_fields) != 4:
                     raise SourceError(
                         f"line {lineno}: texture requires 4 fields "
-                        f"(vramX vramY clutX clutY), got {len(extra_fields)}"
+                        f"(vramX vramY clutX clutY) or 'auto', got {len(extra_fields)}"
                     )
                 try:
-                    vram_x, vram_y, clut_x, clut_y = (int(v) for v in extra_fields)
+                    vram_x, vram_y, clut_x, clut_y = (
+                        VRAM_AUTO_PLACE if v == "auto" else int(v) for v in extra_fields
+                    )
                 except ValueError:
                     raise SourceError(
-                        f"line {lineno}: texture coordinates must be integers"
+                        f"line {lineno}: texture coordinates must be integers or 'auto'"
                     )
 
                 for label, val, limit in (
@@ -104,7 +116,7 @@ def parse_source(path: Path):
                     ("vramY", vram_y, VRAM_HEIGHT),
                     ("clutY", clut_y, VRAM_HEIGHT),
                 ):
-                    if not (0 <= val < limit):
+                    if val != VRAM_AUTO_PLACE and not (0 <= val < limit):
                         raise SourceError(
                             f"line {lineno}: {label}={val} out of range "
                             f"(expected 0..{limit - 1})"
@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""
+scenepack_builder.py
+
+Bundles every file a scene manifest lists into one SCENEPAK file, described
+in SCENEPAK.md, so the engine can load the whole scene with a single read.
+
+The manifest is the same human-editable source scenebin_converter.py reads.
+Names are archive-relative and are looked up under --asset-root.
+
+Usage:
+    python scenepack_builder.py scenes/level01.txt cdrom/assets/level01.sp --asset-root cdrom/
+"""
+
+import argparse
+import struct
+import sys
+from pathlib import Path
+
+sys.path.insert(0, str(Path(__file__).resolve().parent))
+from scenebin_converter import TYPE_MAP, SourceError, parse_source  # noqa: E402
+
+MAGIC = b"SCENEPAK"
+SCENEPAK_VERSION = 1
+SCENEPAK_HEADER_SIZE = 12
+
+# file data starts on this boundary so it copies out a word at a time
+SCENEPAK_DATA_ALIGNMENT = 4
+
+
+def align(value, alignment=SCENEPAK_DATA_ALIGNMENT):
+    return (value + alignment - 1) & ~(alignment - 1)
+
+
+def index_entry(entry, offset, size) -> bytes:
+    name_bytes = entry["name"].encode("ascii")
+
+    out = bytearray()
+    out += struct.pack("<BB", TYPE_MAP[entry["type"]], len(name_bytes))
+    out += name_bytes
+
+    if entry["type"] == "texture":
+        out += struct.pack("<HHHH", *entry["placement"])
+
+    out += struct.pack("<II", offset, size)
+    return bytes(out)
+
+
+def pack_scene(entries, asset_root: Path) -> bytes:
+    for entry in entries:
+        if entry["type"] == "scene_pack":
+            raise SourceError(f"line {entry['lineno']}: a scene pack can't contain another scene pack")
+
+    blobs = []
+    missing = []
+    for entry in entries:
+        path = asset_root / entry["name"]
+        if not path.exists():
+            missing.append(f"line {entry['lineno']}: {path}")
+            continue
+        blobs.append(path.read_bytes())
+
+    if missing:
+        raise SourceError("referenced files not found on disk:\n  " + "\n  ".join(missing))
+
+    # the index size doesn't depend on the offsets, so size it first and lay the data out after it
+    index_size = sum(len(index_entry(entry, 0, 0)) for entry in entries)
+    offset = align(SCENEPAK_HEADER_SIZE + index_size)
+
+    offsets = []
+    for blob in blobs:
+        offsets.append(offset)
+        offset = align(offset + len(blob))
+
+    out = bytearray()
+    out += MAGIC
+    out += struct.pack("<BBH", SCENEPAK_VERSION, len(entries), 0)
+
+    for entry, blob_offset, blob in zip(entries, offsets, blobs):
+        out += index_entry(entry, blob_offset, len(blob))
+
+    for blob_offset, blob in zip(offsets, blobs):
+        out += b"\0" * (blob_offset - len(out))
+        out += blob
+
+    out += b"\0" * (align(len(out)) - len(out))
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Bundle a scene's files into one SCENEPAK.")
+    parser.add_argument("source", type=Path, help="Path to the human-editable scene manifest")
+    parser.add_argument("output", type=Path, help="Path to write the SCENEPAK file")
+    parser.add_argument(
+        "--asset-root",
+        type=Path,
+        default=Path("."),
+        help="Root directory the manifest's archive names are found under",
+    )
+
+    args = parser.parse_args()
+
+    try:
+        entries = parse_source(args.source)
+        binary = pack_scene(entries, args.asset_root)
+        args.output.write_bytes(binary)
+
+    except (OSError, SourceError) as e:
+        print(f"scenepack_builder: error: {e}", file=sys.stderr)
+        sys.exit(1)
+
+    print(f"Wrote {len(entries)} files to {args.output} ({len(binary)} bytes)")
+
+
+if __name__ == "__main__":
+    main()
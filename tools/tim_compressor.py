@@ -0,0 +1,258 @@
+#!/usr/bin/env python3
+"""
+tim_compressor.py
+
+Compresses TIM files into TIMZ files, described in TIMZ.md, so they take
+less time to read off the CD. Each texture gets whichever method makes it
+smallest unless one is forced with --method. The engine tells a TIMZ apart
+from a TIM by its magic, so a scene manifest can list either.
+
+Usage:
+    python tim_compressor.py cdrom/assets/textures/map.tim -o cdrom/assets/textures/map.tz
+    python tim_compressor.py cdrom/assets/textures/*.tim --out-dir cdrom/assets/textures/ --method lz
+"""
+
+import argparse
+import struct
+import sys
+from pathlib import Path
+
+MAGIC = b"TIMZ"
+TIMZ_VERSION = 1
+TIMZ_HEADER_SIZE = 12
+
+METHODS = {"none": 0, "rle": 1, "lz": 2}
+
+# the engine's RLE control byte: 0-127 copy that many + 1 bytes, 128-255 repeat the next byte (control - 126) times
+RLE_MAX_LITERALS = 128
+RLE_MIN_RUN = 2
+RLE_MAX_RUN = 129
+
+# the engine's LZ: 16-bit offsets and matches of at least 4 bytes
+LZ_MIN_MATCH = 4
+LZ_MAX_OFFSET = 0xFFFF
+LZ_CHAIN_DEPTH = 32
+
+
+class CompressError(Exception):
+    pass
+
+
+def compress_rle(data: bytes) -> bytes:
+    out = bytearray()
+    literals = bytearray()
+
+    def flush_literals():
+        for start in range(0, len(literals), RLE_MAX_LITERALS):
+            chunk = literals[start:start + RLE_MAX_LITERALS]
+            out.append(len(chunk) - 1)
+            out.extend(chunk)
+        literals.clear()
+
+    i = 0
+    while i < len(data):
+        run = 1
+        while i + run < len(data) and run < RLE_MAX_RUN and data[i + run] == data[i]:
+            run += 1
+
+        # a run of 2 only breaks even, so leave it with the literals around it
+        if run > RLE_MIN_RUN:
+            flush_literals()
+            out.append(run + 126)
+            out.append(data[i])
+            i += run
+        else:
+            literals.append(data[i])
+            i += 1
+
+    flush_literals()
+    return bytes(out)
+
+
+def lz_length(out: bytearray, value: int):
+    while value >= 255:
+        out.append(255)
+        value -= 255
+    out.append(value)
+
+
+def lz_sequence(out: bytearray, literals: bytes, offset: int, match_length: int):
+    literal_nibble = min(len(literals), 15)
+    match_nibble = min(match_length - LZ_MIN_MATCH, 15) if match_length else 0
+
+    out.append(literal_nibble << 4 | match_nibble)
+    if literal_nibble == 15:
+        lz_length(out, len(literals) - 15)
+    out.extend(literals)
+
+    if match_length:
+        out.extend(struct.pack("<H", offset))
+        if match_nibble == 15:
+            lz_length(out, match_length - LZ_MIN_MATCH - 15)
+
+
+def compress_lz(data: bytes) -> bytes:
+    out = bytearray()
+    chains = {}
+    literal_start = 0
+
+    i = 0
+    while i < len(data):
+        best_length = 0
+        best_offset = 0
+
+        key = data[i:i + LZ_MIN_MATCH]
+        if len(key) == LZ_MIN_MATCH:
+            candidates = chains.setdefault(key, [])
+            for candidate in reversed(candidates[-LZ_CHAIN_DEPTH:]):
+                if i - candidate > LZ_MAX_OFFSET:
+                    break
+
+                length = 0
+                while i + length < len(data) and data[candidate + length] == data[i + length]:
+                    length += 1
+
+                if length > best_length:
+                    best_length = length
+                    best_offset = i - candidate
+
+            candidates.append(i)
+
+        if best_length < LZ_MIN_MATCH:
+            i += 1
+            continue
+
+        lz_sequence(out, data[literal_start:i], best_offset, best_length)
+
+        # the positions inside the match can be matched against later on too
+        for j in range(i + 1, min(i + best_length, len(data) - LZ_MIN_MATCH + 1)):
+            chains.setdefault(data[j:j + LZ_MIN_MATCH], []).append(j)
+
+        i += best_length
+        literal_start = i
+
+    # the decoder stops once it has every byte, so the last sequence is only literals
+    if literal_start < len(data) or not out:
+        lz_sequence(out, data[literal_start:], 0, 0)
+
+    return bytes(out)
+
+
+def compress_tim(data: bytes, method: str = "auto"):
+    if len(data) < 8 or data[0] != 0x10:
+        raise CompressError("not a TIM file")
+
+    if method == "auto":
+        candidates = {"rle": compress_rle(data), "lz": compress_lz(data), "none": data}
+        method = min(candidates, key=lambda name: len(candidates[name]))
+        payload = candidates[method]
+    elif method == "rle":
+        payload = compress_rle(data)
+    elif method == "lz":
+        payload = compress_lz(data)
+    else:
+        payload = data
+
+    header = MAGIC + struct.pack("<BBHI", TIMZ_VERSION, METHODS[method], 0, len(data))
+
+    # the engine copies files around a word at a time
+    padding = b"\0" * (-(TIMZ_HEADER_SIZE + len(payload)) % 4)
+    return header + payload + padding, method
+
+
+def lz_read_length(data: bytes, pos: int, value: int):
+    if value != 15:
+        return value, pos
+
+    while True:
+        extra = data[pos]
+        pos += 1
+        value += extra
+        if extra != 255:
+            return value, pos
+
+
+def decompress_timz(data: bytes) -> bytes:
+    """Unpack a TIMZ the same way the engine does, for tools that need to read the TIM inside."""
+    if data[:4] != MAGIC or len(data) < TIMZ_HEADER_SIZE:
+        raise CompressError("not a TIMZ file")
+
+    version, method, _, raw_size = struct.unpack_from("<BBHI", data, 4)
+    if version != TIMZ_VERSION:
+        raise CompressError(f"unsupported TIMZ version {version}")
+
+    src = data[TIMZ_HEADER_SIZE:]
+    out = bytearray()
+    pos = 0
+
+    try:
+        if method == METHODS["none"]:
+            out = bytearray(src[:raw_size])
+
+        elif method == METHODS["rle"]:
+            while len(out) < raw_size:
+                control = src[pos]
+                if control < 128:
+                    out += src[pos + 1:pos + control + 2]
+                    pos += control + 2
+                else:
+                    out += bytes([src[pos + 1]]) * (control - 126)
+                    pos += 2
+
+        elif method == METHODS["lz"]:
+            while len(out) < raw_size:
+                token = src[pos]
+                literals, pos = lz_read_length(src, pos + 1, token >> 4)
+                out += src[pos:pos + literals]
+                pos += literals
+                if len(out) >= raw_size:
+                    break
+
+                offset = src[pos] | src[pos + 1] << 8
+                length, pos = lz_read_length(src, pos + 2, token & 0xF)
+                if offset == 0 or offset > len(out):
+                    raise CompressError("match starts before the data")
+
+                for _ in range(length + LZ_MIN_MATCH):
+                    out.append(out[-offset])
+
+        else:
+            raise CompressError(f"unknown compression method {method}")
+
+    except IndexError:
+        raise CompressError("compressed data is cut short") from None
+
+    if len(out) != raw_size:
+        raise CompressError("compressed data doesn't unpack to the size in the header")
+
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compress TIM files into TIMZ files.")
+    parser.add_argument("inputs", type=Path, nargs="+", help="TIM files to compress")
+    parser.add_argument("-o", "--output", type=Path, help="Path to write the TIMZ to, when there's only one input")
+    parser.add_argument("--out-dir", type=Path, help="Write each input to this directory as <name>.tz")
+    parser.add_argument("--method", choices=["auto", *METHODS], default="auto", help="Compression to use (default: the smallest)")
+
+    args = parser.parse_args()
+
+    if args.out_dir is None and (args.output is None or len(args.inputs) != 1):
+        parser.error("give one input and -o, or use --out-dir")
+
+    try:
+        for path in args.inputs:
+            data = path.read_bytes()
+            binary, method = compress_tim(data, args.method)
+
+            output = args.out_dir / (path.stem + ".tz") if args.out_dir else args.output
+            output.write_bytes(binary)
+            print(f"{path} -> {output}: {len(data)} -> {len(binary)} bytes ({method})")
+
+    except (OSError, CompressError) as e:
+        print(f"tim_compressor: error: {e}", file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -44,6 +44,61 @@ def toIndexedImage(imageObj: Image.Image, numColors: int) -> Image.Image:
 	newImageObj.putpalette(clut, imageObj.mode)
 	return newImageObj
 
+## Shared palettes
+
+# Textures quantised to the same palette end up with byte-identical CLUTs, and
+# TextureManager only uploads one copy of a CLUT no matter how many textures
+# use it.
+def buildSharedPalette(imageObjs: Sequence[Image.Image], numColors: int) -> ndarray:
+	pixels: ndarray = numpy.concatenate([
+		numpy.asarray(imageObj.convert("RGBA"), "B").reshape(( -1, 4 ))
+		for imageObj in imageObjs
+	])
+	palette: ndarray = numpy.unique(pixels, axis = 0)
+
+	if palette.shape[0] > numColors:
+		# too many colours between them, so let Pillow pick the palette from
+		# all of the images at once. fast octree is the method that copes with alpha
+		combined: Image.Image = Image.fromarray(pixels.reshape(( 1, -1, 4 )), "RGBA")
+		reduced:  Image.Image = combined.quantize(numColors, method = Image.Quantize.FASTOCTREE)
+
+		depth:   int     = len(reduced.palette.mode)
+		palette          = numpy.frombuffer(reduced.palette.palette, "B").reshape(( -1, depth ))[:numColors]
+		if depth == 3:
+			palette = numpy.c_[ palette, numpy.full(( palette.shape[0], 1 ), 0xff, "B") ]
+
+	return palette
+
+def applySharedPalette(imageObj: Image.Image, palette: ndarray) -> Image.Image:
+	image:   ndarray = numpy.asarray(imageObj.convert("RGBA"), "B").astype("i4")
+	colours: ndarray = palette.astype("i4")
+	indices: ndarray = numpy.empty(image.shape[:2], "B")
+
+	# nearest colour, a row at a time to keep the distance table small
+	for row in range(image.shape[0]):
+		distance: ndarray = ((image[row, :, None, :] - colours[None, :, :]) ** 2).sum(axis = 2)
+		indices[row] = distance.argmin(axis = 1)
+
+	newImageObj: Image.Image = Image.fromarray(indices, "P")
+	newImageObj.putpalette(palette.astype("B").flatten().tobytes(), "RGBA")
+	return newImageObj
+
+## Level of detail variants
+
+# Each level is half the size of the one before, which is a shift of the UVs
+# the engine already has for the full size texture. Indexed images are
+# resized without filtering so they keep their palette indices, and with it a
+# CLUT identical to the full size texture's.
+def generateLods(imageObj: Image.Image, levels: int) -> list[Image.Image]:
+	lods: list[Image.Image] = []
+
+	for level in range(1, levels + 1):
+		size = ( max(1, imageObj.width >> level), max(1, imageObj.height >> level) )
+		resample = Image.Resampling.NEAREST if imageObj.mode == "P" else Image.Resampling.BOX
+		lods.append(imageObj.resize(size, resample))
+
+	return lods
+
 ## .TIM image converter
 
 class TIMHeaderFlag(IntFlag):
@@ -253,12 +308,283 @@ def generateIndexedTIM(
 
 	return data
 
+## Offline VRAM planner
+
+# Mirrors VRamAllocator in src/textures/vram_allocator.cpp so a scene's
+# placements can be worked out (and checked) before it ever runs.
+_VRAM_AUTO_PLACE:           int = 0xffff
+_TEXTURE_PAGE_WIDTH:        int = 64
+_TEXTURE_PAGE_HEIGHT:       int = 256
+_TEXTURE_PAGE_COLUMNS:      int = 16
+_TEXTURE_PAGE_ROWS:         int = 2
+_FIRST_TEXTURE_PAGE_COLUMN: int = 320 // _TEXTURE_PAGE_WIDTH
+_MAX_WINDOW_SHELVES:        int = 16
+# the engine keeps the system font here, 4-bit with its clut on the line underneath (x, y, width, height)
+_SYSTEM_FONT_VRAM:          tuple[int, int, int, int] = ( 960, 256, 64, 49 )
+_CLUT_ALIGNMENT:            int = 16
+_CLUT_SLOTS_PER_ROW:        int = 320 // _CLUT_ALIGNMENT
+_CLUT_ROW_YS:               list[int] = list(range(240, 256)) + list(range(496, 512))
+
+# pages per window for each colour depth (flags & 3)
+_PAGES_FOR_DEPTH: dict[int, int] = { 0: 1, 1: 2, 2: 4 }
+
+@dataclass
+class TIMInfo:
+	depth:     int
+	width:     int
+	height:    int
+	clutWidth: int
+
+def readTIMInfo(path: str) -> TIMInfo:
+	with open(path, "rb") as f:
+		data: bytes = f.read()
+
+	# compressed textures are planned from the tim inside them
+	if data[:4] == b"TIMZ":
+		from pathlib import Path
+		sys.path.insert(0, str(Path(__file__).resolve().parent))
+		from tim_compressor import decompress_timz
+
+		data = decompress_timz(data)
+
+	version, flags = _TIM_HEADER_STRUCT.unpack_from(data, 0)
+	if (version & 0xff) != _TIM_HEADER_VERSION:
+		raise ValueError(f"{path} is not a TIM file")
+
+	offset:    int = _TIM_HEADER_STRUCT.size
+	clutWidth: int = 0
+
+	if flags & TIMHeaderFlag.HAS_PALETTE:
+		length, _, _, clutWidth, _ = _TIM_SECTION_STRUCT.unpack_from(data, offset)
+		offset += length
+
+	_, _, _, width, height = _TIM_SECTION_STRUCT.unpack_from(data, offset)
+	return TIMInfo(flags & TIMHeaderFlag.COLOR_BITMASK, width, height, clutWidth)
+
+class VRAMPlanner:
+	def __init__(self):
+		# window: dict(x, y, width, depth, reserved, shelves=[[y, height, used]], top, area)
+		self.windows:   list[dict]      = []
+		self.pageOwner: list[list[Any]] = [ [ None ] * _TEXTURE_PAGE_COLUMNS for _ in range(_TEXTURE_PAGE_ROWS) ]
+		self.clutRows:  list[int]       = [ 0 ] * len(_CLUT_ROW_YS)
+
+	def _openWindow(self, depth: int, column: int, row: int, pages: int, reserved: bool) -> dict:
+		window: dict = {
+			"x": column * _TEXTURE_PAGE_WIDTH, "y": row * _TEXTURE_PAGE_HEIGHT,
+			"width": pages * _TEXTURE_PAGE_WIDTH, "depth": depth, "reserved": reserved,
+			"shelves": [], "top": 0, "area": 0
+		}
+		self.windows.append(window)
+
+		for page in range(pages):
+			self.pageOwner[row][column + page] = window
+		return window
+
+	def _findPages(self, pages: int, fromRight: bool) -> tuple[int, int] | None:
+		for row in range(_TEXTURE_PAGE_ROWS):
+			columns = range(_FIRST_TEXTURE_PAGE_COLUMN, _TEXTURE_PAGE_COLUMNS - pages + 1)
+			for column in (reversed(columns) if fromRight else columns):
+				if all(self.pageOwner[row][column + page] is None for page in range(pages)):
+					return column, row
+		return None
+
+	def reserveTexture(self, depth: int, x: int, y: int, width: int, height: int):
+		for row in range(y // _TEXTURE_PAGE_HEIGHT, min((y + height - 1) // _TEXTURE_PAGE_HEIGHT + 1, _TEXTURE_PAGE_ROWS)):
+			for column in range(x // _TEXTURE_PAGE_WIDTH, min((x + width - 1) // _TEXTURE_PAGE_WIDTH + 1, _TEXTURE_PAGE_COLUMNS)):
+				if column < _FIRST_TEXTURE_PAGE_COLUMN:
+					continue
+
+				window = self.pageOwner[row][column] or self._openWindow(depth, column, row, 1, True)
+				left   = max(x, column * _TEXTURE_PAGE_WIDTH)
+				right  = min(x + width, (column + 1) * _TEXTURE_PAGE_WIDTH)
+				top    = max(y, row * _TEXTURE_PAGE_HEIGHT)
+				bottom = min(y + height, (row + 1) * _TEXTURE_PAGE_HEIGHT)
+				window["area"] += (right - left) * (bottom - top)
+
+	def allocateTexture(self, depth: int, width: int, height: int) -> tuple[int, int]:
+		pages: int = _PAGES_FOR_DEPTH[depth]
+		if width > pages * _TEXTURE_PAGE_WIDTH or height > _TEXTURE_PAGE_HEIGHT:
+			raise ValueError(f"a {width}x{height} texture can't fit in a texture page")
+
+		candidates = [ w for w in self.windows if not w["reserved"] and w["depth"] == depth ]
+
+		# best fit on an existing shelf
+		best = None
+		for window in candidates:
+			for shelf in window["shelves"]:
+				if shelf[1] >= height and window["width"] - shelf[2] >= width:
+					if best is None or shelf[1] - height < best[1][1] - height:
+						best = ( window, shelf )
+
+		# then a new shelf
+		if best is None:
+			for window in candidates:
+				if window["top"] + height <= _TEXTURE_PAGE_HEIGHT and len(window["shelves"]) < _MAX_WINDOW_SHELVES:
+					shelf = [ window["top"], height, 0 ]
+					window["shelves"].append(shelf)
+					window["top"] += height
+					best = ( window, shelf )
+					break
+
+		# then new pages
+		if best is None:
+			found = self._findPages(pages, depth == TIMHeaderFlag.COLOR_16BPP)
+			if found is None:
+				raise ValueError(f"out of texture pages for a {width}x{height} texture")
+
+			window = self._openWindow(depth, found[0], found[1], pages, False)
+			shelf  = [ 0, height, 0 ]
+			window["shelves"].append(shelf)
+			window["top"] = height
+			best = ( window, shelf )
+
+		window, shelf = best
+		position      = ( window["x"] + shelf[2], window["y"] + shelf[0] )
+		shelf[2]       += width
+		window["area"] += width * height
+		return position
+
+	def reserveClut(self, x: int, y: int, width: int):
+		if y not in _CLUT_ROW_YS or x >= 320:
+			return
+
+		slot:  int = x // _CLUT_ALIGNMENT
+		slots: int = min((x % _CLUT_ALIGNMENT + width + _CLUT_ALIGNMENT - 1) // _CLUT_ALIGNMENT, _CLUT_SLOTS_PER_ROW - slot)
+		self.clutRows[_CLUT_ROW_YS.index(y)] |= ((1 << slots) - 1) << slot
+
+	def allocateClut(self, width: int) -> tuple[int, int]:
+		slots: int = (width + _CLUT_ALIGNMENT - 1) // _CLUT_ALIGNMENT
+		mask:  int = (1 << slots) - 1
+
+		for row, y in enumerate(_CLUT_ROW_YS):
+			for slot in range(_CLUT_SLOTS_PER_ROW - slots + 1):
+				if not self.clutRows[row] & (mask << slot):
+					self.clutRows[row] |= mask << slot
+					return slot * _CLUT_ALIGNMENT, y
+
+		raise ValueError(f"out of CLUT space for a {width} colour CLUT")
+
+	def report(self):
+		freePages:  int = 0
+		largestRun: int = 0
+		for row in self.pageOwner:
+			run = 0
+			for owner in row[_FIRST_TEXTURE_PAGE_COLUMN:]:
+				run        = run + 1 if owner is None else 0
+				freePages += owner is None
+				largestRun = max(largestRun, run)
+
+		claimed:   int = sum(w["width"] * _TEXTURE_PAGE_HEIGHT for w in self.windows)
+		used:      int = sum(w["area"] for w in self.windows)
+		freeSlots: int = sum(_CLUT_SLOTS_PER_ROW - bin(row).count("1") for row in self.clutRows)
+		totalPages: int = (_TEXTURE_PAGE_COLUMNS - _FIRST_TEXTURE_PAGE_COLUMN) * _TEXTURE_PAGE_ROWS
+
+		print(f"{freePages}/{totalPages} texture pages free, largest run {largestRun}.")
+		print(f"{(claimed - used) * 100 // claimed if claimed else 0}% of claimed pages unused.")
+		print(f"{freeSlots} CLUT slots free.")
+
+def planScene(sourcePath: str, assetRoot: str, outputPath: str | None):
+	"""Fill in every "auto" texture coordinate in a scene manifest source.
+
+	Hand placed textures are reserved first, like they are when the engine
+	loads them, so the packed ones go around them.
+	"""
+	from pathlib import Path
+	sys.path.insert(0, str(Path(__file__).resolve().parent))
+	from scenebin_converter import VRAM_AUTO_PLACE, parse_source
+
+	entries  = [ e for e in parse_source(Path(sourcePath)) if e["type"] == "texture" ]
+	infos    = { e["name"]: readTIMInfo(str(Path(assetRoot) / e["name"])) for e in entries }
+	planner  = VRAMPlanner()
+	placed: dict[int, tuple[int, int, int, int]] = {}
+
+	# the renderer reserves the system font before anything loads
+	planner.reserveTexture(0, *_SYSTEM_FONT_VRAM)
+
+	for entry in entries:
+		x, y, clutX, clutY = entry["placement"]
+		info = infos[entry["name"]]
+
+		if VRAM_AUTO_PLACE not in ( x, y ):
+			planner.reserveTexture(info.depth, x, y, info.width, info.height)
+		if info.clutWidth and VRAM_AUTO_PLACE not in ( clutX, clutY ):
+			planner.reserveClut(clutX, clutY, info.clutWidth)
+
+	for entry in entries:
+		x, y, clutX, clutY = entry["placement"]
+		info = infos[entry["name"]]
+
+		if VRAM_AUTO_PLACE in ( x, y ):
+			x, y = planner.allocateTexture(info.depth, info.width, info.height)
+		if VRAM_AUTO_PLACE in ( clutX, clutY ):
+			clutX, clutY = planner.allocateClut(info.clutWidth) if info.clutWidth else ( 0, 0 )
+
+		placed[entry["lineno"]] = ( x, y, clutX, clutY )
+		print(f"{entry['name']}: image {x},{y} ({info.width}x{info.height}), clut {clutX},{clutY}")
+
+	planner.report()
+
+	if outputPath is None:
+		return
+
+	with open(sourcePath, "r", encoding="utf-8") as f:
+		lines = f.read().splitlines()
+
+	for lineno, coords in placed.items():
+		fields = lines[lineno - 1].split()
+		lines[lineno - 1] = " ".join(fields[:2] + [ str(v) for v in coords ])
+
+	with open(outputPath, "w", encoding="utf-8") as f:
+		f.write("\n".join(lines) + "\n")
+	print(f"Planned manifest saved to {outputPath}")
+
+def writeSharedPaletteTIMs(args, transparent_rgb: tuple[int, int, int] | None, fast_convert: bool):
+	from pathlib import Path
+
+	num_colors: int = args.quantize or 256
+	if num_colors > 256:
+		print("Error: a shared palette can have at most 256 colours")
+		sys.exit(1)
+
+	try:
+		image_objs = [ Image.open(path) for path in args.shared_palette ]
+	except Exception as e:
+		print(f"Error opening image: {e}")
+		sys.exit(1)
+
+	if transparent_rgb is not None:
+		print("Applying transparent color...")
+		image_objs = [ applyTransparentColor(image_obj, transparent_rgb) for image_obj in image_objs ]
+
+	print(f"Building a shared {num_colors} colour palette from {len(image_objs)} images...")
+	palette = buildSharedPalette(image_objs, num_colors)
+
+	output_dir = Path(args.output) if args.output else None
+	if output_dir is not None:
+		output_dir.mkdir(parents = True, exist_ok = True)
+
+	for path, image_obj in zip(args.shared_palette, image_objs):
+		tim_data = generateIndexedTIM(
+			applySharedPalette(image_obj, palette), args.xcoord, args.ycoord, args.clut_x, args.clut_y, args.force_stp, fast_convert
+		)
+
+		stem        = Path(path).with_suffix(".tim")
+		output_file = output_dir / stem.name if output_dir is not None else stem
+
+		try:
+			with open(output_file, "wb") as f:
+				f.write(tim_data)
+			print(f"TIM file successfully saved to {output_file}")
+		except Exception as e:
+			print(f"Error saving TIM file: {e}")
+			sys.exit(1)
+
 # Argument parsing function
 def parse_args():
 	parser = argparse.ArgumentParser(description="Convert images to TIM format for PS1.")
 
 	# Required arguments
-	parser.add_argument("input_image", help="Path to the input image file")
+	parser.add_argument("input_image", nargs="?", help="Path to the input image file")
 
 	# Optional arguments
 	parser.add_argument("-o", "--output", help="Output TIM file name (default: input_image.tim)", default=None)
@@ -279,6 +605,39 @@ def parse_args():
 		),
 		default=None
 	)
+	parser.add_argument(
+		"--plan-scene",
+		metavar="SOURCE",
+		help=(
+			"Instead of converting an image, plan VRAM for a scene manifest source. "
+			"Every 'auto' texture coordinate is packed the way the engine would, "
+			"and a fragmentation report is printed. Use -o to write the planned manifest."
+		),
+		default=None
+	)
+	parser.add_argument(
+		"--shared-palette",
+		metavar="IMAGE",
+		nargs="+",
+		help=(
+			"Quantize these images together to one palette of --quantize colours (256 if not given) "
+			"and write a TIM for each. They all end up with the same CLUT, so the engine only uploads it once. "
+			"-o is the output directory."
+		),
+		default=None
+	)
+	parser.add_argument(
+		"--lods",
+		type=int,
+		choices=(1, 2),
+		help=(
+			"Also write this many reduced size variants, each half the size of the last, "
+			"next to the output as NAME_L1.TIM and NAME_L2.TIM. They keep the palette, so they share its CLUT. "
+			"The engine draws far away objects with them once they're loaded alongside the full size texture."
+		),
+		default=0
+	)
+	parser.add_argument("--asset-root", help="Directory the manifest's TIM files are found under (with --plan-scene)", default=".")
 	parser.add_argument(
 		"--fast-convert",
 		action="store_true",
@@ -290,11 +649,23 @@ def parse_args():
 		)
 	)
 
-	return parser.parse_args()
+	args = parser.parse_args()
+	if args.plan_scene is None and args.shared_palette is None and args.input_image is None:
+		parser.error("an input image is required unless --plan-scene or --shared-palette is given")
+
+	return args
 
 def main():
 	args = parse_args()
 
+	if args.plan_scene is not None:
+		try:
+			planScene(args.plan_scene, args.asset_root, args.output)
+		except Exception as e:
+			print(f"Error planning scene: {e}")
+			sys.exit(1)
+		return
+
 	# Parse transparent color early so bad input fails before any file I/O
 	transparent_rgb: tuple[int, int, int] | None = None
 	if args.transparent:
@@ -306,6 +677,10 @@ def main():
 			print(f"Error: {e}")
 			sys.exit(1)
 
+	if args.shared_palette is not None:
+		writeSharedPaletteTIMs(args, transparent_rgb, args.fast_convert)
+		return
+
 	try:
 		image_obj = Image.open(args.input_image)
 	except Exception as e:
@@ -351,5 +726,22 @@ def main():
 		print(f"Error saving TIM file: {e}")
 		sys.exit(1)
 
+	for level, lod_obj in enumerate(generateLods(image_obj, args.lods), 1):
+		if lod_obj.mode == "P":
+			lod_data = generateIndexedTIM(lod_obj, args.xcoord, args.ycoord, args.clut_x, args.clut_y, args.force_stp, fast_convert)
+		else:
+			lod_data = generateRawTIM(lod_obj, args.xcoord, args.ycoord, args.force_stp, fast_convert)
+
+		stem, dot, extension = output_file.rpartition(".")
+		lod_file = f"{stem}_L{level}.{extension}" if dot else f"{output_file}_L{level}"
+
+		try:
+			with open(lod_file, "wb") as f:
+				f.write(lod_data)
+			print(f"LOD {level} ({lod_obj.width}x{lod_obj.height}) saved to {lod_file}")
+		except Exception as e:
+			print(f"Error saving TIM file: {e}")
+			sys.exit(1)
+
 if __name__ == "__main__":
 	main()
\ No newline at end of file